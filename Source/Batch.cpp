@@ -0,0 +1,171 @@
+/*
+	Copyright Myles Trevino
+	Licensed under the Apache License, Version 2.0
+	https://www.apache.org/licenses/LICENSE-2.0
+*/
+
+
+#include "Batch.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+#include "Utilities.hpp"
+#include "Frustum.hpp"
+#include "Memory.hpp"
+
+
+namespace
+{
+	struct Job
+	{
+		std::string name;
+		std::string dataset;
+		float top;
+		float left;
+		float bottom;
+		float right;
+
+		bool succeeded;
+		std::string error;
+		double seconds;
+	};
+
+
+	std::vector<Job> parse_manifest(const std::string& manifest_path)
+	{
+		std::ifstream file{manifest_path};
+		if(!file) throw std::runtime_error{"Failed to open the manifest."};
+
+		std::vector<Job> jobs;
+		std::string line;
+		int line_number{};
+
+		while(std::getline(file, line))
+		{
+			++line_number;
+			const std::vector<std::string> tokens{LV::Utilities::split(line)};
+			if(tokens.empty() || tokens[0][0] == '#') continue;
+
+			try
+			{
+				if(tokens.size() != 6) throw std::runtime_error{"Expected 6 values but "+
+					std::to_string(tokens.size())+" were given."};
+
+				LV::Utilities::validate_name(tokens[0]);
+
+				Job job{tokens[0], tokens[1], std::stof(tokens[2]),
+					std::stof(tokens[3]), std::stof(tokens[4]), std::stof(tokens[5])};
+
+				for(const Job& other : jobs) if(other.name == job.name)
+					throw std::runtime_error{"Duplicate name \""+job.name+"\"."};
+
+				jobs.emplace_back(job);
+			}
+			catch(std::exception& error){ throw std::runtime_error{"Invalid manifest line "+
+				std::to_string(line_number)+": "+error.what()}; }
+		}
+
+		if(jobs.empty()) throw std::runtime_error{"The manifest contains no entries."};
+		return jobs;
+	}
+
+
+	double get_seconds_since(std::chrono::steady_clock::time_point start)
+	{ return std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count(); }
+}
+
+
+void LV::Batch::generate(const std::string& manifest_path, const std::string& api_key,
+	const LV::Frustum::Save_options& options)
+{
+	std::vector<Job> jobs{parse_manifest(manifest_path)};
+
+	// Use one worker per hardware thread, since each job already retrieves its terrain
+	// and buildings concurrently and its loops share the thread pool with the others.
+	const unsigned worker_count{std::clamp(std::thread::hardware_concurrency(),
+		1u, static_cast<unsigned>(jobs.size()))};
+
+	std::cout<<"Generating "<<jobs.size()<<" Frustums using "<<worker_count<<" workers...\n";
+	const std::chrono::steady_clock::time_point batch_start{std::chrono::steady_clock::now()};
+	std::atomic<size_t> next_job{};
+	std::mutex output_mutex;
+
+	// Run the jobs.
+	const auto work{[&]
+	{
+		for(size_t index{next_job++}; index < jobs.size(); index = next_job++)
+		{
+			Job& job{jobs[index]};
+			const std::chrono::steady_clock::time_point start{std::chrono::steady_clock::now()};
+			LV::Utilities::Output output;
+
+			try
+			{
+				const LV::Utilities::Output_scope output_scope{&output};
+				LV::Frustum::generate(job.name, job.dataset, job.top,
+					job.left, job.bottom, job.right, api_key, options);
+
+				job.succeeded = true;
+			}
+
+			// Report the job even if it failed by exceeding the memory budget.
+			catch(std::exception& error)
+			{
+				const LV::Memory::Unbudgeted unbudgeted;
+				job.error = error.what();
+			}
+
+			catch(...)
+			{
+				const LV::Memory::Unbudgeted unbudgeted;
+				job.error = "Unhandled exception.";
+			}
+
+			const LV::Memory::Unbudgeted unbudgeted;
+			job.seconds = get_seconds_since(start);
+
+			// Print the job's progress together, since the jobs run concurrently.
+			std::lock_guard<std::mutex> lock{output_mutex};
+			std::cout<<"\n"<<output.text<<(job.succeeded ? "Finished" : "Failed")<<" \""<<
+				job.name<<"\" ("<<index+1<<"/"<<jobs.size()<<")"<<
+				(job.succeeded ? "." : ": "+job.error)<<'\n';
+		}
+	}};
+
+	std::vector<std::thread> workers;
+	try{ for(unsigned worker{}; worker < worker_count; ++worker) workers.emplace_back(work); }
+	catch(...)
+	{
+		// Join the started workers before rethrowing, since destroying them would terminate.
+		next_job = jobs.size();
+		for(std::thread& worker : workers) worker.join();
+		throw;
+	}
+
+	for(std::thread& worker : workers) worker.join();
+
+	// Report the timings.
+	size_t failed_count{};
+	std::cout<<"\nBatch report:\n";
+
+	for(const Job& job : jobs)
+	{
+		if(!job.succeeded) ++failed_count;
+
+		std::cout<<std::left<<std::setw(24)<<job.name<<std::right<<std::fixed<<
+			std::setprecision(2)<<std::setw(10)<<job.seconds<<" s  "<<
+			(job.succeeded ? "OK" : "Failed: "+job.error)<<'\n';
+	}
+
+	std::cout<<std::defaultfloat<<jobs.size()-failed_count<<" of "<<jobs.size()<<
+		" Frustums generated in "<<std::fixed<<std::setprecision(2)<<
+		get_seconds_since(batch_start)<<" s.\n"<<std::defaultfloat;
+}
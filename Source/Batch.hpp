@@ -0,0 +1,19 @@
+/*
+	Copyright Myles Trevino
+	Licensed under the Apache License, Version 2.0
+	https://www.apache.org/licenses/LICENSE-2.0
+*/
+
+
+#pragma once
+
+#include <string>
+
+#include "Frustum.hpp"
+
+
+namespace LV::Batch
+{
+	void generate(const std::string& manifest_path, const std::string& api_key,
+		const LV::Frustum::Save_options& options = {});
+}
@@ -0,0 +1,318 @@
+/*
+	Copyright Myles Trevino
+	Licensed under the Apache License, Version 2.0
+	https://www.apache.org/licenses/LICENSE-2.0
+*/
+
+
+#include "Benchmark.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <functional>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <nlohmann/json.hpp>
+
+#include "Constants.hpp"
+#include "Utilities.hpp"
+#include "Frustum.hpp"
+#include "Dem.hpp"
+#include "Osm.hpp"
+#include "Exporter.hpp"
+#include "Request.hpp"
+#include "Loopback.hpp"
+
+
+namespace
+{
+	constexpr double synthetic_left{9.};
+	constexpr double synthetic_bottom{47.};
+	constexpr double synthetic_cell_size{1./3600.}; // About 30 meters.
+
+
+	struct Result
+	{
+		std::string name;
+		int size;
+		double seconds;
+	};
+
+
+	LV::Bounds get_synthetic_bounds(int size)
+	{
+		return {static_cast<float>(synthetic_bottom+size*synthetic_cell_size),
+			static_cast<float>(synthetic_left), static_cast<float>(synthetic_bottom),
+			static_cast<float>(synthetic_left+size*synthetic_cell_size)};
+	}
+
+
+	LV::Frustum::Data generate_data(const LV::Dem::Grid& grid, int building_count)
+	{
+		const int size{grid.size.x};
+
+		LV::Frustum::Data data;
+		// Saved and exported, then removed, under a name which validate_name rejects, so
+		// that it cannot be a user's Frustum.
+		data.name = "_benchmark-"+std::to_string(size);
+		data.dataset = "synthetic";
+		data.size = grid.size;
+		data.cell_size = 1.;
+		data.bounds = get_synthetic_bounds(size);
+
+		data.terrain.resize(size, std::vector<float>(size));
+		for(int z{}; z < size; ++z) for(int x{}; x < size; ++x) data.terrain[z][x] =
+			grid.elevations[static_cast<size_t>(z)*size+x]/LV::Constants::meters_per_frustum_base_unit;
+
+		// Square buildings spread evenly over the grid, with closed outlines.
+		for(int index{}; index < building_count; ++index)
+		{
+			const glm::fvec2 start{glm::fvec2{std::fmod(index*.618034f, 1.f),
+				std::fmod(index*.754878f, 1.f)}*(size-3.f)};
+
+			const float width{.5f+(index%10)/10.f};
+
+			data.buildings.push_back({(10.f+index%30)/LV::Constants::meters_per_frustum_base_unit,
+				{start, start+glm::fvec2{width, 0.f}, start+width, start+glm::fvec2{0.f, width}, start}});
+		}
+
+		return data;
+	}
+
+
+	// Times requests to the stand-in server under various network conditions.
+	void add_network_cases(const std::function<void(const std::string& name, int size,
+		const std::function<void()>& function)>& add)
+	{
+		const std::string payload_url{LV::Loopback::get_url()+"/payload?bytes="};
+		const auto request_payloads{[&](int count, size_t bytes)
+			{ for(int index{}; index < count; ++index) LV::Request::request(payload_url+std::to_string(bytes)); }};
+
+		// Sizes are megabytes transferred, or request counts.
+		constexpr int megabytes{64};
+		add("Request throughput", megabytes, [&]{ request_payloads(megabytes/8, 8*1024*1024); });
+
+		LV::Loopback::set_conditions({.chunk_size = 64*1024});
+		add("Chunked throughput", megabytes, [&]{ request_payloads(megabytes/8, 8*1024*1024); });
+
+		// Each response is delayed by 20 milliseconds, so 0.4 seconds are unavoidable.
+		LV::Loopback::set_conditions({.latency = .02});
+		add("First byte latency", 20, [&]{ request_payloads(20, 1024); });
+
+		LV::Loopback::set_conditions({});
+		add("Reused connections", 200, [&]{ request_payloads(200, 1024); });
+
+		LV::Loopback::set_conditions({.close = true});
+		add("New connections", 200, [&]{ request_payloads(200, 1024); });
+
+		// Tiles of elevation are parsed as each arrives, overlapping the other downloads
+		// when retrieved in parallel.
+		constexpr int tile_count{8};
+		std::vector<std::string> tile_urls;
+
+		for(int tile{}; tile < tile_count; ++tile)
+		{
+			std::ostringstream url;
+			url<<std::setprecision(10)<<"https://"<<LV::Constants::opentopography_host<<
+				"/API/globaldem?demtype=SRTMGL1&south="<<synthetic_bottom<<"&north="<<
+				synthetic_bottom+.125<<"&west="<<synthetic_left+tile*.125<<"&east="<<
+				synthetic_left+(tile+1)*.125<<"&outputFormat=AAIGrid";
+
+			tile_urls.emplace_back(url.str());
+		}
+
+		LV::Loopback::set_conditions({.bandwidth = 16.*1024*1024});
+		add("Serial tile retrieval", tile_count, [&]{ for(const std::string& url : tile_urls)
+			LV::Dem::parse_grid(LV::Request::request(url)); });
+
+		add("Parallel tile retrieval", tile_count, [&]{ LV::Utilities::parallel_for(tile_count,
+			[&](size_t tile){ LV::Dem::parse_grid(LV::Request::request(tile_urls[tile])); }); });
+
+		LV::Loopback::set_conditions({});
+	}
+
+
+	// Returns the fastest of the repetitions in seconds.
+	double time(int repetitions, const std::function<void()>& function)
+	{
+		double fastest{std::numeric_limits<double>::max()};
+
+		for(int repetition{}; repetition < repetitions; ++repetition)
+		{
+			const std::chrono::steady_clock::time_point start{std::chrono::steady_clock::now()};
+			function();
+			fastest = std::min(fastest, std::chrono::duration<double>(
+				std::chrono::steady_clock::now()-start).count());
+		}
+
+		return fastest;
+	}
+
+
+	std::map<std::pair<std::string, int>, double> load_baseline(const std::string& path)
+	{
+		std::ifstream file{path};
+		if(!file) throw std::runtime_error{"Failed to open the baseline \""+path+"\"."};
+
+		std::map<std::pair<std::string, int>, double> baseline;
+		for(const nlohmann::json& result : nlohmann::json::parse(file).at("results"))
+			baseline[{result.at("name").get<std::string>(), result.at("size").get<int>()}] =
+				result.at("seconds").get<double>();
+
+		return baseline;
+	}
+}
+
+
+LV::Benchmark::Options LV::Benchmark::parse_options(
+	const std::map<std::string, std::string>& options)
+{
+	Options result;
+
+	for(const auto& [key, value] : options)
+	{
+		if(key == "sizes")
+		{
+			std::string sizes{value};
+			std::replace(sizes.begin(), sizes.end(), ',', ' ');
+			result.sizes.clear();
+
+			for(const std::string& size : LV::Utilities::split(sizes))
+			{
+				result.sizes.emplace_back(std::stoi(size));
+				if(result.sizes.back() < 4) throw std::runtime_error{
+					"Each of the 'sizes' must be at least 4."};
+			}
+		}
+
+		else if(key == "buildings")
+		{
+			result.building_count = std::stoi(value);
+			if(result.building_count < 0) throw std::runtime_error{
+				"'buildings' must not be negative."};
+		}
+
+		else if(key == "repetitions")
+		{
+			result.repetitions = std::stoi(value);
+			if(result.repetitions < 1) throw std::runtime_error{
+				"'repetitions' must be at least 1."};
+		}
+
+		else if(key == "network")
+		{
+			if(value == "false") result.network = false;
+			else if(value != "true") throw std::runtime_error{
+				"'network' must be either 'true' or 'false'."};
+		}
+
+		else if(key == "baseline") result.baseline = value;
+		else throw std::runtime_error{"Unrecognized benchmark option '"+key+"'."};
+	}
+
+	return result;
+}
+
+
+void LV::Benchmark::run(const Options& options)
+{
+	const std::map<std::pair<std::string, int>, double> baseline{
+		options.baseline.empty() ? decltype(baseline){} : load_baseline(options.baseline)};
+
+	std::vector<Result> results;
+	const auto add{[&](const std::string& name, int size, const std::function<void()>& function)
+	{
+		std::cout<<"Benchmarking "<<name<<" ("<<size<<")...\n";
+		results.push_back({name, size, time(options.repetitions, function)});
+	}};
+
+	// Building parsing depends only on the building count.
+	{
+		const std::string text{LV::Loopback::generate_buildings(get_synthetic_bounds(
+			options.sizes.empty() ? 1024 : options.sizes.back()), options.building_count)};
+
+		add("Overpass parsing", options.building_count, [&]{ LV::Osm::parse_overpass(text); });
+	}
+
+	for(const int size : options.sizes)
+	{
+		const std::string grid_text{LV::Loopback::generate_grid(
+			synthetic_left, synthetic_bottom, size, size, synthetic_cell_size)};
+
+		add("AAIGrid parsing", size, [&]{ LV::Dem::parse_grid(grid_text); });
+
+		const LV::Frustum::Data data{generate_data(LV::Dem::parse_grid(grid_text),
+			options.building_count)};
+		add("Terrain mesh", size, [&]{ LV::Frustum::generate_terrain_mesh(data); });
+		add("Buildings mesh", size, [&]{ LV::Frustum::generate_buildings_mesh(data); });
+
+		const std::string directory{LV::Constants::frustum_directory_name+"/"+data.name};
+		add("Save", size, [&]{ LV::Frustum::save(data); });
+		add("Load", size, [&]{ LV::Frustum::load(data.name); });
+		std::filesystem::remove_all(directory);
+
+		std::vector<uint8_t> compressed;
+		add("Compression", size, [&]{ compressed = LV::Utilities::compress(grid_text); });
+		add("Decompression", size, [&]{ LV::Utilities::decompress(compressed); });
+
+		const LV::Frustum::Meshes meshes{LV::Frustum::generate_meshes(data)};
+		for(const std::string format : {"ply", "obj", "stl", "glb"})
+			add(LV::Utilities::to_uppercase(format)+" export", size, [&]
+				{ std::filesystem::remove_all(LV::Exporter::export_frustum(data, meshes, format, "z-up")); });
+	}
+
+	// Without the network, against a stand-in server.
+	if(options.network)
+	{
+		LV::Loopback::start();
+
+		try{ add_network_cases(add); }
+		catch(...)
+		{
+			LV::Loopback::stop();
+			throw;
+		}
+
+		LV::Loopback::stop();
+	}
+
+	// Save the results.
+	nlohmann::json json;
+	json["program_version"] = LV::Constants::program_version;
+	json["repetitions"] = options.repetitions;
+	json["results"] = nlohmann::json::array();
+
+	for(const Result& result : results)
+		json["results"].push_back({{"name", result.name}, {"size", result.size}, {"seconds", result.seconds}});
+
+	std::filesystem::create_directories(LV::Constants::benchmark_directory_name);
+	const std::string path{LV::Constants::benchmark_directory_name+"/benchmark-"+std::to_string(
+		std::chrono::system_clock::now().time_since_epoch()/std::chrono::seconds{1})+".json"};
+
+	std::ofstream file{path};
+	file<<json.dump(1, '\t')<<'\n';
+	if(!file) throw std::runtime_error{"Failed to write the benchmark results."};
+
+	// Report the results, and their change from the baseline.
+	std::cout<<"\nBenchmark results (seconds):\n"<<std::fixed;
+	for(const Result& result : results)
+	{
+		std::cout<<"  "<<std::left<<std::setw(20)<<result.name<<std::right<<std::setw(8)<<
+			result.size<<std::setw(12)<<std::setprecision(4)<<result.seconds;
+
+		const auto match{baseline.find({result.name, result.size})};
+		if(match != baseline.end() && match->second > 0.) std::cout<<std::setw(9)<<
+			std::setprecision(1)<<std::showpos<<(result.seconds/match->second-1.)*100.<<
+			std::noshowpos<<'%';
+
+		std::cout<<'\n';
+	}
+
+	std::cout<<std::defaultfloat<<"The results were saved to \""<<path<<"\".\n";
+}
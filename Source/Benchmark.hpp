@@ -0,0 +1,36 @@
+/*
+	Copyright Myles Trevino
+	Licensed under the Apache License, Version 2.0
+	https://www.apache.org/licenses/LICENSE-2.0
+*/
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+
+
+namespace LV::Benchmark
+{
+	struct Options
+	{
+		std::vector<int> sizes{256, 1024, 2048}; // Terrain points per side.
+		int building_count{5000};
+		int repetitions{3}; // The fastest is kept.
+		bool network{true}; // Also times requests to a local stand-in server.
+		std::string baseline; // Results of an earlier run to compare against.
+	};
+
+
+	// Parses 'key=value' benchmark options.
+	Options parse_options(const std::map<std::string, std::string>& options);
+
+	// Times parsing, mesh generation, saving, loading, compression, and exporting on
+	// deterministic synthetic Frustums of each size, and requests made to a local
+	// stand-in server under simulated network conditions, without the network or a
+	// GPU. The results are written as JSON within the Benchmarks folder, and compared
+	// with the baseline's if given.
+	void run(const Options& options);
+}
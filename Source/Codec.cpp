@@ -0,0 +1,482 @@
+/*
+	Copyright Myles Trevino
+	Licensed under the Apache License, Version 2.0
+	https://www.apache.org/licenses/LICENSE-2.0
+*/
+
+
+#include "Codec.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+#include <algorithm>
+#include <fstream>
+#include <span>
+
+#include "Constants.hpp"
+#include "Utilities.hpp"
+#include "Trace.hpp"
+
+
+namespace
+{
+	constexpr std::string_view magic{"LVTC"};
+	constexpr std::string_view tiled_magic{"LVTS"};
+	constexpr uint8_t version{1};
+	constexpr int64_t maximum_quantized_height{1 << 28};
+
+
+	struct Tiled_header
+	{
+		glm::ivec2 size;
+		int tile_size;
+		glm::ivec2 tile_count;
+		std::vector<uint64_t> offsets; // One more than the tiles, ending at the file end.
+	};
+
+
+	struct Header
+	{
+		uint32_t width;
+		uint32_t height;
+		float precision;
+		uint32_t band_rows;
+		std::vector<std::string_view> bands;
+	};
+
+
+	void write_uint32(std::string* output, uint32_t value)
+	{ for(int byte{}; byte < 4; ++byte) output->push_back(static_cast<char>(value >> (byte*8))); }
+
+
+	uint32_t read_uint32(std::string_view* input)
+	{
+		if(input->size() < 4) throw std::runtime_error{"The terrain data is truncated."};
+
+		uint32_t value{};
+		for(int byte{}; byte < 4; ++byte)
+			value |= static_cast<uint32_t>(static_cast<uint8_t>((*input)[byte])) << (byte*8);
+
+		input->remove_prefix(4);
+		return value;
+	}
+
+
+	void write_uint64(std::string* output, uint64_t value)
+	{
+		write_uint32(output, static_cast<uint32_t>(value));
+		write_uint32(output, static_cast<uint32_t>(value >> 32));
+	}
+
+
+	uint64_t read_uint64(std::string_view* input)
+	{
+		const uint64_t low{read_uint32(input)};
+		return low|(static_cast<uint64_t>(read_uint32(input)) << 32);
+	}
+
+
+	std::string read_bytes(std::ifstream* file, uint64_t offset, size_t size)
+	{
+		std::string bytes(size, '\0');
+		file->seekg(offset);
+
+		if(!file->read(bytes.data(), size))
+			throw std::runtime_error{"The terrain data is truncated."};
+
+		return bytes;
+	}
+
+
+	// Returns the tile's compressed bytes within the mapped file.
+	std::span<const uint8_t> get_tile_bytes(const LV::Mapped_file& file,
+		const Tiled_header& header, size_t tile)
+	{
+		const uint64_t offset{header.offsets[tile]};
+		const uint64_t end{header.offsets[tile+1]};
+		if(end < offset) throw std::runtime_error{"The terrain data is corrupt."};
+		if(end > file.size) throw std::runtime_error{"The terrain data is truncated."};
+		return {file.data+offset, static_cast<size_t>(end-offset)};
+	}
+
+
+	Tiled_header read_tiled_header(std::ifstream* file)
+	{
+		constexpr size_t header_size{tiled_magic.size()+1+3*4};
+		const std::string header_bytes{read_bytes(file, 0, header_size)};
+		std::string_view input{header_bytes};
+
+		if(input.substr(0, tiled_magic.size()) != tiled_magic ||
+			input[tiled_magic.size()] != version) throw std::runtime_error{
+			"Unsupported terrain data version."};
+
+		input.remove_prefix(tiled_magic.size()+1);
+
+		Tiled_header header;
+		header.size.x = static_cast<int>(read_uint32(&input));
+		header.size.y = static_cast<int>(read_uint32(&input));
+		header.tile_size = static_cast<int>(read_uint32(&input));
+
+		if(header.size.x <= 0 || header.size.y <= 0 || header.tile_size <= 0)
+			throw std::runtime_error{"The terrain data is corrupt."};
+
+		header.tile_count = (header.size+header.tile_size-1)/header.tile_size;
+
+		// Read the index.
+		const size_t offset_count{static_cast<size_t>(header.tile_count.x*header.tile_count.y)+1};
+		const std::string index_bytes{read_bytes(file, header_size, offset_count*8)};
+		std::string_view index{index_bytes};
+
+		for(size_t offset{}; offset < offset_count; ++offset)
+			header.offsets.emplace_back(read_uint64(&index));
+
+		return header;
+	}
+
+
+	void write_varint(std::string* output, uint32_t value)
+	{
+		while(value >= 0x80)
+		{
+			output->push_back(static_cast<char>((value & 0x7f) | 0x80));
+			value >>= 7;
+		}
+
+		output->push_back(static_cast<char>(value));
+	}
+
+
+	uint32_t read_varint(const uint8_t** input, const uint8_t* end)
+	{
+		uint32_t value{};
+
+		for(int shift{}; shift < 35; shift += 7)
+		{
+			if(*input == end) throw std::runtime_error{"The terrain data is truncated."};
+
+			const uint8_t byte{*(*input)++};
+			value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+			if(!(byte & 0x80)) return value;
+		}
+
+		throw std::runtime_error{"The terrain data is corrupt."};
+	}
+
+
+	uint32_t zigzag(int32_t value)
+	{ return (static_cast<uint32_t>(value) << 1)^static_cast<uint32_t>(value >> 31); }
+
+
+	int32_t unzigzag(uint32_t value)
+	{ return static_cast<int32_t>(value >> 1)^-static_cast<int32_t>(value & 1); }
+
+
+	void quantize_row(const std::vector<float>& row, float precision, int32_t* output)
+	{
+		for(size_t x{}; x < row.size(); ++x)
+		{
+			const int64_t value{std::llround(row[x]/static_cast<double>(precision))};
+
+			if(std::abs(value) > maximum_quantized_height) throw std::runtime_error{
+				"The terrain heights exceed the range of the precision."};
+
+			output[x] = static_cast<int32_t>(value);
+		}
+	}
+
+
+	// Predicts each height from its left, upper, and upper left neighbors (a + b - c).
+	// The first row of a band only uses the left neighbor so that bands are independent.
+	std::string encode_band(const std::vector<std::vector<float>>& terrain,
+		float precision, size_t start, size_t end)
+	{
+		const size_t width{terrain[0].size()};
+		std::vector<int32_t> above(width);
+		std::vector<int32_t> current(width);
+		std::vector<int32_t> residuals(width);
+		std::string output;
+		output.reserve((end-start)*width);
+
+		for(size_t row{start}; row < end; ++row)
+		{
+			quantize_row(terrain[row], precision, current.data());
+
+			if(row == start)
+			{
+				residuals[0] = current[0];
+				for(size_t x{1}; x < width; ++x) residuals[x] = current[x]-current[x-1];
+			}
+
+			else
+			{
+				residuals[0] = current[0]-above[0];
+				for(size_t x{1}; x < width; ++x)
+					residuals[x] = current[x]-current[x-1]-above[x]+above[x-1];
+			}
+
+			for(int32_t residual : residuals) write_varint(&output, zigzag(residual));
+			std::swap(above, current);
+		}
+
+		return output;
+	}
+
+
+	void decode_band(std::string_view band, float precision, size_t start,
+		size_t end, std::vector<std::vector<float>>* terrain)
+	{
+		const size_t width{(*terrain)[0].size()};
+		std::vector<int32_t> above(width);
+		std::vector<int32_t> current(width);
+		const uint8_t* input{reinterpret_cast<const uint8_t*>(band.data())};
+		const uint8_t* const input_end{input+band.size()};
+
+		for(size_t row{start}; row < end; ++row)
+		{
+			for(size_t x{}; x < width; ++x) current[x] = unzigzag(read_varint(&input, input_end));
+
+			// Undo the prediction. Adding the upper row's gradient first leaves only a
+			// running sum along the row.
+			if(row != start)
+			{
+				for(size_t x{1}; x < width; ++x) current[x] += above[x]-above[x-1];
+				current[0] += above[0];
+			}
+
+			for(size_t x{1}; x < width; ++x) current[x] += current[x-1];
+
+			std::vector<float>& output{(*terrain)[row]};
+			for(size_t x{}; x < width; ++x)
+				output[x] = static_cast<float>(current[x]*static_cast<double>(precision));
+
+			std::swap(above, current);
+		}
+
+		if(input != input_end) throw std::runtime_error{"The terrain data is corrupt."};
+	}
+
+
+	Header read_header(std::string_view encoded)
+	{
+		if(!LV::Codec::is_encoded_terrain(encoded) || encoded[magic.size()] != version)
+			throw std::runtime_error{"Unsupported terrain data version."};
+
+		encoded.remove_prefix(magic.size()+1);
+
+		Header header;
+		header.width = read_uint32(&encoded);
+		header.height = read_uint32(&encoded);
+
+		const uint32_t precision{read_uint32(&encoded)};
+		std::memcpy(&header.precision, &precision, sizeof(float));
+
+		header.band_rows = read_uint32(&encoded);
+		if(header.band_rows == 0) throw std::runtime_error{"The terrain data is corrupt."};
+
+		// Split the payload into the bands.
+		const size_t band_count{(header.height+header.band_rows-1)/header.band_rows};
+		std::vector<uint32_t> band_sizes(band_count);
+		for(uint32_t& band_size : band_sizes) band_size = read_uint32(&encoded);
+
+		for(uint32_t band_size : band_sizes)
+		{
+			if(band_size > encoded.size()) throw std::runtime_error{"The terrain data is truncated."};
+			header.bands.emplace_back(encoded.substr(0, band_size));
+			encoded.remove_prefix(band_size);
+		}
+
+		return header;
+	}
+}
+
+
+std::string LV::Codec::encode_terrain(const std::vector<std::vector<float>>& terrain,
+	float precision)
+{
+	const LV::Trace::Span span{"Terrain encoding"};
+
+	if(terrain.empty() || terrain[0].empty())
+		throw std::runtime_error{"The terrain is empty."};
+
+	if(!(precision > 0.f)) throw std::runtime_error{"The precision must be positive."};
+
+	// Encode the bands in parallel.
+	const size_t band_rows{LV::Constants::terrain_band_rows};
+	std::vector<std::string> bands((terrain.size()+band_rows-1)/band_rows);
+
+	LV::Utilities::parallel_for(bands.size(), [&](size_t band)
+	{
+		bands[band] = encode_band(terrain, precision, band*band_rows,
+			std::min(terrain.size(), (band+1)*band_rows));
+	});
+
+	// Write the header.
+	std::string output{magic};
+	output.push_back(static_cast<char>(version));
+	write_uint32(&output, static_cast<uint32_t>(terrain[0].size()));
+	write_uint32(&output, static_cast<uint32_t>(terrain.size()));
+
+	uint32_t precision_bits;
+	std::memcpy(&precision_bits, &precision, sizeof(float));
+	write_uint32(&output, precision_bits);
+	write_uint32(&output, static_cast<uint32_t>(band_rows));
+
+	for(const std::string& band : bands) write_uint32(&output, static_cast<uint32_t>(band.size()));
+	for(const std::string& band : bands) output += band;
+
+	return output;
+}
+
+
+std::vector<std::vector<float>> LV::Codec::decode_terrain(std::string_view encoded)
+{
+	const LV::Trace::Span span{"Terrain decoding"};
+
+	const Header header{read_header(encoded)};
+	if(header.width == 0) throw std::runtime_error{"The terrain data is corrupt."};
+	std::vector<std::vector<float>> terrain(header.height, std::vector<float>(header.width));
+
+	LV::Utilities::parallel_for(header.bands.size(), [&](size_t band)
+	{
+		decode_band(header.bands[band], header.precision, band*header.band_rows,
+			std::min<size_t>(header.height, (band+1)*header.band_rows), &terrain);
+	});
+
+	return terrain;
+}
+
+
+bool LV::Codec::is_encoded_terrain(std::string_view data)
+{ return data.size() > magic.size() && data.substr(0, magic.size()) == magic; }
+
+
+void LV::Codec::save_tiled_terrain(const std::string& path,
+	const std::vector<std::vector<float>>& terrain, float precision,
+	LV::Utilities::Compression_profile profile)
+{
+	const LV::Trace::Span span{"Terrain saving"};
+
+	if(terrain.empty() || terrain[0].empty())
+		throw std::runtime_error{"The terrain is empty."};
+
+	const glm::ivec2 size{terrain[0].size(), terrain.size()};
+	const int tile_size{LV::Constants::terrain_tile_size};
+	const glm::ivec2 tile_count{(size+tile_size-1)/tile_size};
+
+	// Encode and compress the tiles in parallel.
+	std::vector<std::vector<uint8_t>> tiles(static_cast<size_t>(tile_count.x*tile_count.y));
+
+	LV::Utilities::parallel_for(tiles.size(), [&](size_t tile)
+	{
+		const glm::ivec2 start{glm::ivec2{tile%tile_count.x, tile/tile_count.x}*tile_size};
+		const glm::ivec2 end{glm::min(start+tile_size, size)};
+
+		std::vector<std::vector<float>> tile_terrain;
+		for(int z{start.y}; z < end.y; ++z) tile_terrain.emplace_back(
+			terrain[z].begin()+start.x, terrain[z].begin()+end.x);
+
+		tiles[tile] = LV::Utilities::compress(encode_terrain(tile_terrain, precision),
+			profile, LV::Constants::terrain_dictionary_name);
+	});
+
+	// Write the header and the index.
+	std::string header{tiled_magic};
+	header.push_back(static_cast<char>(version));
+	write_uint32(&header, static_cast<uint32_t>(size.x));
+	write_uint32(&header, static_cast<uint32_t>(size.y));
+	write_uint32(&header, static_cast<uint32_t>(tile_size));
+
+	uint64_t offset{header.size()+(tiles.size()+1)*8};
+	for(const std::vector<uint8_t>& tile : tiles)
+	{
+		write_uint64(&header, offset);
+		offset += tile.size();
+	}
+
+	write_uint64(&header, offset);
+
+	// Write the tiles.
+	std::ofstream file{path, std::ios::binary};
+	if(!file) throw std::runtime_error{"Failed to save the Frustum."};
+	file.write(header.data(), header.size());
+
+	for(const std::vector<uint8_t>& tile : tiles)
+		file.write(reinterpret_cast<const char*>(tile.data()), tile.size());
+
+	if(!file) throw std::runtime_error{"Failed to save the Frustum."};
+}
+
+
+bool LV::Codec::is_tiled_terrain(const std::string& path)
+{
+	std::ifstream file{path, std::ios::binary};
+	std::string bytes(tiled_magic.size(), '\0');
+	return file.read(bytes.data(), bytes.size()) && bytes == tiled_magic;
+}
+
+
+glm::ivec2 LV::Codec::get_tiled_terrain_size(const std::string& path)
+{
+	std::ifstream file{path, std::ios::binary};
+	if(!file) throw std::runtime_error{"Failed to load the Frustum."};
+	return read_tiled_header(&file).size;
+}
+
+
+std::vector<std::string> LV::Codec::load_tile_payloads(const std::string& path)
+{
+	std::ifstream file{path, std::ios::binary};
+	if(!file) throw std::runtime_error{"Failed to load the Frustum."};
+	const Tiled_header header{read_tiled_header(&file)};
+	const LV::Mapped_file mapped_file{path};
+
+	std::vector<std::string> payloads;
+	for(size_t tile{}; tile+1 < header.offsets.size(); ++tile)
+		payloads.emplace_back(LV::Utilities::decompress(get_tile_bytes(mapped_file, header, tile)));
+
+	return payloads;
+}
+
+
+std::vector<std::vector<float>> LV::Codec::load_tiled_terrain(const std::string& path,
+	const glm::ivec2& start, const glm::ivec2& size)
+{
+	const LV::Trace::Span span{"Terrain loading"};
+
+	std::ifstream index_file{path, std::ios::binary};
+	if(!index_file) throw std::runtime_error{"Failed to load the Frustum."};
+	const Tiled_header header{read_tiled_header(&index_file)};
+
+	if(start.x < 0 || start.y < 0 || size.x < 1 || size.y < 1 ||
+		start.x+size.x > header.size.x || start.y+size.y > header.size.y)
+		throw std::runtime_error{"The region is outside of the terrain."};
+
+	// Find the tiles covering the region.
+	const glm::ivec2 first_tile{start/header.tile_size};
+	const glm::ivec2 tile_range{(start+size-1)/header.tile_size-first_tile+1};
+	std::vector<std::vector<float>> terrain(size.y, std::vector<float>(size.x));
+	const LV::Mapped_file file{path};
+
+	// Load them in parallel, copying the overlapping part of each.
+	LV::Utilities::parallel_for(static_cast<size_t>(tile_range.x*tile_range.y), [&](size_t index)
+	{
+		const glm::ivec2 tile{first_tile+glm::ivec2{index%tile_range.x, index/tile_range.x}};
+		const size_t tile_index{static_cast<size_t>(tile.y*header.tile_count.x+tile.x)};
+		const std::vector<std::vector<float>> tile_terrain{decode_terrain(LV::Utilities::
+			decompress(get_tile_bytes(file, header, tile_index)))};
+
+		const glm::ivec2 tile_start{tile*header.tile_size};
+		const glm::ivec2 copy_start{glm::max(start, tile_start)};
+		const glm::ivec2 copy_end{glm::min(start+size, tile_start+
+			glm::ivec2{tile_terrain[0].size(), tile_terrain.size()})};
+
+		for(int z{copy_start.y}; z < copy_end.y; ++z)
+			std::copy(tile_terrain[z-tile_start.y].begin()+(copy_start.x-tile_start.x),
+				tile_terrain[z-tile_start.y].begin()+(copy_end.x-tile_start.x),
+				terrain[z-start.y].begin()+(copy_start.x-start.x));
+	});
+
+	return terrain;
+}
@@ -0,0 +1,46 @@
+/*
+	Copyright Myles Trevino
+	Licensed under the Apache License, Version 2.0
+	https://www.apache.org/licenses/LICENSE-2.0
+*/
+
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Utilities.hpp"
+
+
+namespace LV::Codec
+{
+	// Quantizes the heights to the precision and stores the zigzag encoded residuals
+	// of a planar predictor as varints. The rows are split into independent bands
+	// which are encoded and decoded in parallel. The result is meant to be compressed.
+	std::string encode_terrain(const std::vector<std::vector<float>>& terrain, float precision);
+
+	std::vector<std::vector<float>> decode_terrain(std::string_view encoded);
+
+	bool is_encoded_terrain(std::string_view data);
+
+	// Saves the terrain as independently encoded and compressed square tiles preceded
+	// by an index, so that a region can be loaded without reading the other tiles.
+	void save_tiled_terrain(const std::string& path,
+		const std::vector<std::vector<float>>& terrain, float precision,
+		LV::Utilities::Compression_profile profile);
+
+	// Older files store the terrain as a single compressed stream instead.
+	bool is_tiled_terrain(const std::string& path);
+
+	glm::ivec2 get_tiled_terrain_size(const std::string& path);
+
+	// Returns each tile decompressed but still encoded, for example to train dictionaries.
+	std::vector<std::string> load_tile_payloads(const std::string& path);
+
+	// Only reads and decompresses the tiles covering the region.
+	std::vector<std::vector<float>> load_tiled_terrain(const std::string& path,
+		const glm::ivec2& start, const glm::ivec2& size);
+}
@@ -10,6 +10,8 @@
 #include <string>
 #include <vector>
 #include <set>
+#include <map>
+#include <cstdint>
 #include <string_view>
 #include <glm/glm.hpp>
 #include <boost/algorithm/string.hpp>
@@ -29,6 +31,11 @@ namespace LV::Constants
 	const std::string metadata_file_name{"metadata.lfm"};
 	const std::string terrain_file_name{"terrain.lft"};
 	const std::string buildings_file_name{"buildings.lfb"};
+	const std::string terrain_dictionary_name{"terrain"};
+	const std::string buildings_dictionary_name{"buildings"};
+	const std::string opentopography_host{"portal.opentopography.org"};
+	const std::string overpass_host{"lz4.overpass-api.de"};
+	const std::string osm_directory_name{"OSM"};
 	static auto case_insensitive_string_comparitor{[](std::string_view const& a, std::string_view const& b){ return boost::ilexicographical_compare(a, b); }};
 	const std::set<std::string, decltype(case_insensitive_string_comparitor)> supported_global_datasets{"AW3D30", "SRTMGL1"};
 	const std::set<std::string, decltype(case_insensitive_string_comparitor)> supported_usgs_datasets{"USGS30m", "USGS10m", "USGS1m"};
@@ -39,6 +46,34 @@ namespace LV::Constants
 	constexpr float building_depth{20.f};
 	constexpr float bottom{-33.f};
 
+	// Elevation data.
+	const std::string local_dataset_name{"local"};
+	const std::string local_dem_directory_name{"DEM"};
+	const std::string dem_cache_directory_name{"Cache"};
+	constexpr uintmax_t dem_cache_budget{2048ull*1024*1024};
+	constexpr double dem_tile_margin_cells{2}; // Downloaded past each tile edge.
+	const std::map<std::string, double, decltype(case_insensitive_string_comparitor)> dem_tile_degrees{
+		{"SRTMGL1", .125}, {"AW3D30", .125}, {"USGS30m", .125}, {"USGS10m", .04}, {"USGS1m", .025}};
+	const std::map<std::string, double, decltype(case_insensitive_string_comparitor)> dem_cell_degrees{
+		{"SRTMGL1", 1./3600.}, {"AW3D30", 1./3600.}, {"USGS30m", 1./3600.}, {"USGS10m", 1./10800.},
+		{"USGS1m", 1./108000.}};
+
+	// Requests.
+	constexpr unsigned opentopography_concurrency{4};
+	constexpr unsigned overpass_concurrency{2};
+
+	// Compression.
+	constexpr int fast_compression_level{3};
+	constexpr int balanced_compression_level{12};
+	constexpr int long_distance_window_log{27};
+	const std::string dictionary_directory_name{"Dictionaries"};
+	constexpr size_t dictionary_size{112*1024};
+	constexpr size_t dictionary_sample_size{128*1024};
+	constexpr size_t terrain_band_rows{64};
+	constexpr int terrain_tile_size{256};
+	constexpr size_t multithreaded_compression_size{4*1024*1024};
+	constexpr float default_terrain_precision{.001f};
+
 	// Viewer.
 	constexpr int samples{4};
 	constexpr glm::fvec3 clear_color{.9f, .9f, .9f};
@@ -56,7 +91,29 @@ namespace LV::Constants
 	constexpr glm::fvec3 buildings_wireframe_color{1.f, 0.f, .2f};
 
 	// Exporter.
-	const std::vector<std::string> supported_formats{"ply", "obj", "stl"};
+	const std::vector<std::string> supported_formats{"ply", "obj", "stl", "glb"};
+	const std::vector<std::string> native_formats{"ply", "obj", "stl"};
 	const std::string material_name{"Material"};
 	constexpr glm::fvec3 material_color{.5f, .5f, .5f};
+	constexpr float weld_tolerance{.001f};
+	constexpr int export_band_rows{256}; // Matches the terrain tiles, so each is decoded once.
+
+	// Sampling.
+	constexpr size_t sample_block_size{4096}; // Points per parallel task.
+
+	// Visibility.
+	constexpr float default_observer_height{1.7f}; // Meters above the surface.
+
+	// Tracing.
+	const std::string trace_directory_name{"Traces"};
+	constexpr size_t trace_buffer_events{1 << 16}; // Per thread.
+
+	// Benchmark.
+	const std::string benchmark_directory_name{"Benchmarks"};
+	const std::string recording_directory_name{"Recordings"};
+	constexpr unsigned short loopback_port{47613};
+	constexpr unsigned loopback_workers{16}; // At least the benchmarks' concurrent requests.
+
+	// Memory accounting.
+	constexpr size_t memory_stage_limit{64}; // Further stages are counted as "Other".
 }
@@ -0,0 +1,812 @@
+/*
+	Copyright Myles Trevino
+	Licensed under the Apache License, Version 2.0
+	https://www.apache.org/licenses/LICENSE-2.0
+*/
+
+
+#include "Dem.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <filesystem>
+#include <charconv>
+#include <string_view>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <future>
+#include <atomic>
+#include <algorithm>
+#include <regex>
+#include <cstdlib>
+
+#include "Constants.hpp"
+#include "Utilities.hpp"
+#include "Request.hpp"
+#include "Trace.hpp"
+#include "Memory.hpp"
+
+
+namespace
+{
+	// Tiles being downloaded, so that concurrent generations wait instead of downloading twice.
+	std::mutex downloads_mutex;
+	std::map<std::string, std::shared_future<void>> downloads;
+
+	// Held shared while tiles are used and exclusively while evicting.
+	std::shared_mutex cache_mutex;
+
+	// About the length of each value within OpenTopography's Arc ASCII grids.
+	constexpr double global_response_bytes_per_value{5.};
+	constexpr double usgs_response_bytes_per_value{10.};
+
+
+	// Tiles are kept by their number per degree, so that resizing them does not reuse
+	// tiles covering a different area.
+	std::string get_tile_path(const std::string& dataset, const glm::ivec2& tile)
+	{
+		const long tiles_per_degree{std::lround(1./LV::Constants::dem_tile_degrees.at(dataset))};
+		return LV::Constants::dem_cache_directory_name+"/"+dataset+"/"+std::to_string(
+			tiles_per_degree)+"/"+std::to_string(tile.y)+"_"+std::to_string(tile.x)+".ldt";
+	}
+
+
+	// A couple of cells, so that the tiles overlap without downloading much extra.
+	double get_tile_margin(const std::string& dataset)
+	{ return LV::Constants::dem_tile_margin_cells*LV::Constants::dem_cell_degrees.at(dataset); }
+
+
+	LV::Dem::Grid download_tile(const std::string& dataset, bool is_usgs,
+		const glm::ivec2& tile, double tile_degrees, const std::string& api_key)
+	{
+		const double margin{get_tile_margin(dataset)};
+
+		std::stringstream coordinates;
+		coordinates<<std::setprecision(10)<<
+			"&south="<<tile.y*tile_degrees-margin<<"&north="<<(tile.y+1)*tile_degrees+margin<<
+			"&west="<<tile.x*tile_degrees-margin<<"&east="<<(tile.x+1)*tile_degrees+margin;
+
+		const std::string request{"https://"+LV::Constants::opentopography_host+"/API/"+
+			std::string(is_usgs ? "usgsdem" : "globaldem")+std::string(is_usgs ?
+			"?datasetName=" : "?demtype=")+dataset+coordinates.str()+
+			"&outputFormat=AAIGrid&API_Key="+api_key};
+
+		const std::string response{LV::Request::request(request)};
+
+		if(response.find("Error") != std::string::npos) throw std::runtime_error{
+			"Failed to retrieve the topography data. Response: \""+response+"\"."};
+
+		return LV::Dem::parse_grid(response);
+	}
+
+
+	void save_tile(const std::string& path, const LV::Dem::Grid& grid)
+	{
+		std::ostringstream header;
+		header<<grid.size.x<<' '<<grid.size.y<<' '<<std::setprecision(17)<<
+			grid.left<<' '<<grid.top<<' '<<grid.cell_size<<'\n';
+
+		std::string data{header.str()};
+		const size_t header_size{data.size()};
+		data.resize(header_size+grid.elevations.size()*sizeof(float));
+		std::memcpy(data.data()+header_size, grid.elevations.data(),
+			grid.elevations.size()*sizeof(float));
+
+		const std::vector<uint8_t> compressed{LV::Utilities::compress(
+			data, LV::Utilities::Compression_profile::fast)};
+
+		// Write to a temporary file first so that partial tiles are never read.
+		std::filesystem::create_directories(std::filesystem::path{path}.parent_path());
+		const std::string temporary_path{path+".tmp"};
+
+		{
+			std::ofstream file{temporary_path, std::ios::binary};
+			file.write(reinterpret_cast<const char*>(compressed.data()), compressed.size());
+			if(!file) throw std::runtime_error{"Failed to cache the topography data."};
+		}
+
+		std::filesystem::rename(temporary_path, path);
+	}
+
+
+	LV::Dem::Grid load_tile(const std::string& path)
+	{
+		const std::string data{LV::Utilities::decompress_file(path)};
+		const size_t header_end{data.find('\n')};
+		if(header_end == std::string::npos)
+			throw std::runtime_error{"The cached tile \""+path+"\" is corrupt."};
+
+		LV::Dem::Grid grid;
+		std::istringstream header{data.substr(0, header_end)};
+		header>>grid.size.x>>grid.size.y>>grid.left>>grid.top>>grid.cell_size;
+
+		const size_t count{static_cast<size_t>(grid.size.x)*grid.size.y};
+		if(!header || data.size()-header_end-1 != count*sizeof(float))
+			throw std::runtime_error{"The cached tile \""+path+"\" is corrupt."};
+
+		grid.elevations.resize(count);
+		std::memcpy(grid.elevations.data(), data.data()+header_end+1, count*sizeof(float));
+
+		// Mark the tile as recently used.
+		std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now());
+		return grid;
+	}
+
+
+	// Downloads the tile unless it is cached. Returns whether it was downloaded.
+	bool cache_tile(const std::string& dataset, bool is_usgs, const glm::ivec2& tile,
+		double tile_degrees, const std::string& api_key)
+	{
+		const std::string path{get_tile_path(dataset, tile)};
+		std::promise<void> promise;
+		std::shared_future<void> download;
+		bool downloading{};
+
+		{
+			std::lock_guard<std::mutex> lock{downloads_mutex};
+			if(std::filesystem::exists(path)) return false;
+
+			const std::map<std::string, std::shared_future<void>>::iterator
+				iterator{downloads.find(path)};
+
+			if(iterator != downloads.end()) download = iterator->second;
+			else
+			{
+				download = promise.get_future().share();
+				downloads[path] = download;
+				downloading = true;
+			}
+		}
+
+		// Wait for the download started by another generation.
+		if(!downloading)
+		{
+			download.get();
+			return false;
+		}
+
+		try
+		{
+			save_tile(path, download_tile(dataset, is_usgs, tile, tile_degrees, api_key));
+			promise.set_value();
+		}
+		catch(...){ promise.set_exception(std::current_exception()); }
+
+		{
+			std::lock_guard<std::mutex> lock{downloads_mutex};
+			downloads.erase(path);
+		}
+
+		download.get();
+		return true;
+	}
+
+
+	// Deletes the least recently used tiles until the cache fits its budget.
+	void evict()
+	{
+		std::unique_lock<std::shared_mutex> lock{cache_mutex};
+
+		struct Cached_tile
+		{
+			std::filesystem::path path;
+			std::filesystem::file_time_type time;
+			uintmax_t bytes;
+		};
+
+		std::vector<Cached_tile> tiles;
+		uintmax_t total_bytes{};
+
+		for(const std::filesystem::directory_entry& entry : std::filesystem::
+			recursive_directory_iterator{LV::Constants::dem_cache_directory_name})
+		{
+			if(!entry.is_regular_file() || entry.path().extension() != ".ldt") continue;
+			tiles.push_back({entry.path(), entry.last_write_time(), entry.file_size()});
+			total_bytes += tiles.back().bytes;
+		}
+
+		if(total_bytes <= LV::Constants::dem_cache_budget) return;
+
+		std::sort(tiles.begin(), tiles.end(), [](const Cached_tile& a, const Cached_tile& b)
+			{ return a.time < b.time; });
+
+		for(const Cached_tile& tile : tiles)
+		{
+			if(total_bytes <= LV::Constants::dem_cache_budget) break;
+			std::filesystem::remove(tile.path);
+			total_bytes -= tile.bytes;
+		}
+	}
+
+
+	glm::ivec2 get_grid_size(const LV::Bounds& bounds, double cell_size)
+	{
+		const glm::ivec2 size{static_cast<int>(std::round((bounds.right-bounds.left)/cell_size)),
+			static_cast<int>(std::round((bounds.top-bounds.bottom)/cell_size))};
+
+		if(size.x < 2 || size.y < 2)
+			throw std::runtime_error{"The bounds are smaller than the dataset's resolution."};
+
+		return size;
+	}
+
+
+	float sample(const LV::Dem::Grid& grid, double longitude, double latitude)
+	{
+		const int x{std::clamp(static_cast<int>(std::floor(
+			(longitude-grid.left)/grid.cell_size)), 0, grid.size.x-1)};
+
+		const int z{std::clamp(static_cast<int>(std::floor(
+			(grid.top-latitude)/grid.cell_size)), 0, grid.size.y-1)};
+
+		return grid.elevations[static_cast<size_t>(z)*grid.size.x+x];
+	}
+
+
+	// Samples the tiles at the centers of the cells covering the bounds. Where tiles
+	// overlap the first one is used, and points outside of every tile are NaN.
+	LV::Dem::Grid assemble(const std::vector<LV::Dem::Grid>& tiles,
+		const LV::Bounds& bounds, double cell_size)
+	{
+		const LV::Trace::Span span{"Elevation assembly"};
+		const LV::Memory::Scope memory{"Elevation assembly"};
+
+		LV::Dem::Grid grid;
+		grid.cell_size = cell_size;
+		grid.left = bounds.left;
+		grid.top = bounds.top;
+		grid.size = get_grid_size(bounds, cell_size);
+		grid.elevations.resize(static_cast<size_t>(grid.size.x)*grid.size.y);
+
+		const auto contains{[](const LV::Dem::Grid& tile, double longitude, double latitude)
+		{
+			return longitude >= tile.left && longitude < tile.left+tile.size.x*tile.cell_size &&
+				latitude <= tile.top && latitude > tile.top-tile.size.y*tile.cell_size;
+		}};
+
+		LV::Utilities::parallel_for(grid.size.y, [&](size_t z)
+		{
+			const double latitude{grid.top-(z+.5)*grid.cell_size};
+			size_t tile{};
+
+			for(int x{}; x < grid.size.x; ++x)
+			{
+				const double longitude{grid.left+(x+.5)*grid.cell_size};
+				float& elevation{grid.elevations[z*grid.size.x+x]};
+
+				// Neighboring cells are usually within the same tile.
+				if(tile >= tiles.size() || !contains(tiles[tile], longitude, latitude))
+					for(tile = 0; tile < tiles.size(); ++tile)
+						if(contains(tiles[tile], longitude, latitude)) break;
+
+				elevation = (tile < tiles.size()) ? sample(tiles[tile], longitude,
+					latitude) : std::numeric_limits<float>::quiet_NaN();
+			}
+		});
+
+		return grid;
+	}
+
+
+	// Finds the first tile covering the bounds, and the number of tiles across and down.
+	void get_tile_range(const LV::Bounds& bounds, double tile_degrees,
+		glm::ivec2* first_tile, glm::ivec2* tile_count)
+	{
+		*first_tile = {static_cast<int>(std::floor(bounds.left/tile_degrees)),
+			static_cast<int>(std::floor(bounds.bottom/tile_degrees))};
+
+		*tile_count = {static_cast<int>(std::floor(bounds.right/tile_degrees))-
+			first_tile->x+1, static_cast<int>(std::floor(bounds.top/tile_degrees))-first_tile->y+1};
+	}
+
+
+	LV::Dem::Grid retrieve_opentopography(const std::string& dataset, bool is_usgs,
+		const LV::Bounds& bounds, const std::string& api_key)
+	{
+		// Find the tiles covering the bounds.
+		const double tile_degrees{LV::Constants::dem_tile_degrees.at(dataset)};
+		glm::ivec2 first_tile, tile_count;
+		get_tile_range(bounds, tile_degrees, &first_tile, &tile_count);
+
+		// Download the missing tiles and load them.
+		std::vector<LV::Dem::Grid> tiles(static_cast<size_t>(tile_count.x*tile_count.y));
+		std::atomic<size_t> downloaded{};
+
+		{
+			std::shared_lock<std::shared_mutex> lock{cache_mutex};
+
+			LV::Utilities::parallel_for(tiles.size(), [&](size_t index)
+			{
+				const glm::ivec2 tile{first_tile.x+static_cast<int>(index%tile_count.x),
+					first_tile.y+static_cast<int>(index/tile_count.x)};
+
+				if(cache_tile(dataset, is_usgs, tile, tile_degrees, api_key)) ++downloaded;
+				tiles[index] = load_tile(get_tile_path(dataset, tile));
+			});
+		}
+
+		LV::Utilities::print("Used "+std::to_string(tiles.size()-downloaded)+" cached and "+
+			std::to_string(downloaded)+" downloaded topography tiles.\n");
+
+		if(downloaded > 0) evict();
+		return assemble(tiles, bounds, tiles[0].cell_size);
+	}
+
+
+	enum class Sample_format{int16, uint16, int32, float32};
+
+
+	// Where the samples of a local elevation file are and what area they cover.
+	struct Local_tile
+	{
+		std::string path;
+		bool big_endian;
+		Sample_format format;
+		glm::ivec2 size;
+		glm::ivec2 block_size; // The tile size, or the width and the rows per strip.
+		std::vector<uint64_t> block_offsets;
+		double left;
+		double top;
+		double cell_size;
+		double no_data;
+	};
+
+
+	uint64_t read_unsigned(const LV::Mapped_file& file, uint64_t offset, int bytes, bool big_endian)
+	{
+		if(offset+bytes > file.size) throw std::runtime_error{"The elevation file is truncated."};
+
+		uint64_t value{};
+		for(int byte{}; byte < bytes; ++byte)
+			value |= static_cast<uint64_t>(file.data[offset+byte]) <<
+				((big_endian ? bytes-1-byte : byte)*8);
+
+		return value;
+	}
+
+
+	double read_double(const LV::Mapped_file& file, uint64_t offset, bool big_endian)
+	{
+		const uint64_t bits{read_unsigned(file, offset, 8, big_endian)};
+		double value;
+		std::memcpy(&value, &bits, sizeof(double));
+		return value;
+	}
+
+
+	// Reads the extent of an SRTM tile from its name, such as 'N47E009.hgt', which
+	// gives the center of its lower left sample. Neighboring tiles share their edges.
+	Local_tile read_hgt_layout(const std::filesystem::path& path, const LV::Mapped_file& file)
+	{
+		const std::string name{LV::Utilities::to_uppercase(path.stem().string())};
+		std::smatch match;
+
+		if(!std::regex_match(name, match, std::regex{"([NS])(\\d{2})([EW])(\\d{3})"}))
+			throw std::runtime_error{"Unrecognized SRTM tile name \""+path.string()+"\"."};
+
+		Local_tile tile{path.string(), true, Sample_format::int16};
+		const int samples{static_cast<int>(std::lround(std::sqrt(file.size/2.)))};
+		if(static_cast<size_t>(samples)*samples*2 != file.size || samples < 2)
+			throw std::runtime_error{"Unrecognized SRTM tile size \""+path.string()+"\"."};
+
+		const int latitude{std::stoi(match[2])*(match[1] == "S" ? -1 : 1)};
+		const int longitude{std::stoi(match[4])*(match[3] == "W" ? -1 : 1)};
+
+		tile.size = {samples, samples};
+		tile.block_size = tile.size;
+		tile.block_offsets = {0};
+		tile.cell_size = 1./(samples-1);
+		tile.left = longitude-tile.cell_size/2.;
+		tile.top = latitude+1+tile.cell_size/2.;
+		tile.no_data = -32768.;
+		return tile;
+	}
+
+
+	// Reads the layout of an uncompressed, single band, geographic GeoTIFF.
+	Local_tile read_tiff_layout(const std::filesystem::path& path, const LV::Mapped_file& file)
+	{
+		const auto fail{[&](const std::string& reason)
+			{ return std::runtime_error{"Unsupported GeoTIFF \""+path.string()+"\": "+reason}; }};
+
+		if(file.size < 8 || !((file.data[0] == 'I' && file.data[1] == 'I') ||
+			(file.data[0] == 'M' && file.data[1] == 'M'))) throw fail("Not a TIFF file.");
+
+		const bool big_endian{file.data[0] == 'M'};
+		if(read_unsigned(file, 2, 2, big_endian) != 42) throw fail("BigTIFF is not supported.");
+
+		// Read the tags of the first image.
+		std::map<unsigned, std::vector<double>> tags;
+		std::string no_data_text;
+		const uint64_t directory{read_unsigned(file, 4, 4, big_endian)};
+		const uint64_t entry_count{read_unsigned(file, directory, 2, big_endian)};
+
+		for(uint64_t entry{}; entry < entry_count; ++entry)
+		{
+			const uint64_t offset{directory+2+entry*12};
+			const unsigned tag{static_cast<unsigned>(read_unsigned(file, offset, 2, big_endian))};
+			const unsigned type{static_cast<unsigned>(read_unsigned(file, offset+2, 2, big_endian))};
+			const uint64_t count{read_unsigned(file, offset+4, 4, big_endian)};
+
+			const std::map<unsigned, int> type_sizes{{1, 1}, {2, 1}, {3, 2}, {4, 4}, {12, 8}};
+			const std::map<unsigned, int>::const_iterator type_size{type_sizes.find(type)};
+			if(type_size == type_sizes.end()) continue;
+
+			const uint64_t values{(count*type_size->second <= 4) ?
+				offset+8 : read_unsigned(file, offset+8, 4, big_endian)};
+
+			// The no data value is stored as text.
+			if(type == 2)
+			{
+				if(values+count > file.size) throw fail("The file is truncated.");
+				if(tag == 42113) no_data_text.assign(
+					reinterpret_cast<const char*>(file.data+values), count);
+
+				continue;
+			}
+
+			std::vector<double>& tag_values{tags[tag]};
+			for(uint64_t index{}; index < count; ++index) tag_values.emplace_back((type == 12) ?
+				read_double(file, values+index*8, big_endian) : static_cast<double>(
+				read_unsigned(file, values+index*type_size->second, type_size->second, big_endian)));
+		}
+
+		const auto get_tag{[&](unsigned tag, double fallback)
+			{ return tags.count(tag) ? tags[tag][0] : fallback; }};
+
+		// Validate the format.
+		if(get_tag(259, 1) != 1) throw fail("Only uncompressed files are supported.");
+		if(get_tag(277, 1) != 1) throw fail("Only single band files are supported.");
+
+		const int bits{static_cast<int>(get_tag(258, 1))};
+		const int sample_format{static_cast<int>(get_tag(339, 1))};
+
+		Local_tile tile{path.string(), big_endian};
+		if(bits == 16 && sample_format == 2) tile.format = Sample_format::int16;
+		else if(bits == 16 && sample_format == 1) tile.format = Sample_format::uint16;
+		else if(bits == 32 && sample_format == 2) tile.format = Sample_format::int32;
+		else if(bits == 32 && sample_format == 3) tile.format = Sample_format::float32;
+		else throw fail("Only 16 and 32 bit integer and 32 bit float samples are supported.");
+
+		// Find the blocks.
+		tile.size = {static_cast<int>(get_tag(256, 0)), static_cast<int>(get_tag(257, 0))};
+
+		if(tags.count(322))
+		{
+			tile.block_size = {static_cast<int>(get_tag(322, 0)), static_cast<int>(get_tag(323, 0))};
+			for(double offset : tags[324]) tile.block_offsets.emplace_back(static_cast<uint64_t>(offset));
+		}
+
+		else
+		{
+			tile.block_size = {tile.size.x, static_cast<int>(get_tag(278, tile.size.y))};
+			for(double offset : tags[273]) tile.block_offsets.emplace_back(static_cast<uint64_t>(offset));
+		}
+
+		if(tile.size.x < 2 || tile.size.y < 2 || tile.block_size.x < 1 || tile.block_size.y < 1 ||
+			tile.block_offsets.size() < static_cast<size_t>(((tile.size.x+tile.block_size.x-1)/
+			tile.block_size.x)*((tile.size.y+tile.block_size.y-1)/tile.block_size.y)))
+			throw fail("The image layout is invalid.");
+
+		// Read the georeferencing.
+		const std::vector<double>& geo_keys{tags[34735]};
+		bool point_samples{};
+
+		for(size_t key{4}; key+3 < geo_keys.size(); key += 4)
+		{
+			// The model type must be geographic, and samples may be points or areas.
+			if(geo_keys[key] == 1024 && geo_keys[key+3] != 2)
+				throw fail("Only geographic coordinates are supported.");
+
+			if(geo_keys[key] == 1025) point_samples = (geo_keys[key+3] == 2);
+		}
+
+		const std::vector<double>& scale{tags[33550]};
+		const std::vector<double>& tie_point{tags[33922]};
+		if(scale.size() < 2 || tie_point.size() < 6) throw fail("The georeferencing is missing.");
+
+		if(std::abs(scale[0]-scale[1]) > scale[0]*1e-6)
+			throw fail("Only square samples are supported.");
+
+		tile.cell_size = scale[0];
+		tile.left = tie_point[3]-tie_point[0]*tile.cell_size;
+		tile.top = tie_point[4]+tie_point[1]*tile.cell_size;
+
+		if(point_samples)
+		{
+			tile.left -= tile.cell_size/2.;
+			tile.top += tile.cell_size/2.;
+		}
+
+		tile.no_data = no_data_text.empty() ? std::numeric_limits<double>::quiet_NaN() :
+			std::atof(no_data_text.c_str());
+
+		return tile;
+	}
+
+
+	float read_sample(const LV::Mapped_file& file, const Local_tile& tile, int x, int z)
+	{
+		const int blocks_across{(tile.size.x+tile.block_size.x-1)/tile.block_size.x};
+		const size_t block{static_cast<size_t>((z/tile.block_size.y)*blocks_across+x/tile.block_size.x)};
+		const uint64_t index{static_cast<uint64_t>(z%tile.block_size.y)*tile.block_size.x+x%tile.block_size.x};
+		const int bytes{(tile.format == Sample_format::int16 || tile.format == Sample_format::uint16) ? 2 : 4};
+		const uint64_t bits{read_unsigned(file, tile.block_offsets[block]+index*bytes, bytes, tile.big_endian)};
+
+		double value;
+		switch(tile.format)
+		{
+			case Sample_format::int16: value = static_cast<int16_t>(bits); break;
+			case Sample_format::uint16: value = static_cast<uint16_t>(bits); break;
+			case Sample_format::int32: value = static_cast<int32_t>(bits); break;
+
+			default:
+			{
+				const uint32_t float_bits{static_cast<uint32_t>(bits)};
+				float float_value;
+				std::memcpy(&float_value, &float_bits, sizeof(float));
+				value = float_value;
+			}
+		}
+
+		return (value == tile.no_data) ?
+			std::numeric_limits<float>::quiet_NaN() : static_cast<float>(value);
+	}
+
+
+	// Finds the SRTM tiles and GeoTIFFs within the local DEM folder.
+	std::vector<Local_tile> find_local_tiles()
+	{
+		const std::string& directory{LV::Constants::local_dem_directory_name};
+		if(!std::filesystem::is_directory(directory)) throw std::runtime_error{
+			"The local dataset requires elevation files within the '"+directory+"' folder."};
+
+		std::vector<Local_tile> tiles;
+		for(const std::filesystem::directory_entry& entry :
+			std::filesystem::recursive_directory_iterator{directory})
+		{
+			const std::string extension{LV::Utilities::to_uppercase(entry.path().extension().string())};
+			if(!entry.is_regular_file()) continue;
+
+			if(extension == ".HGT")
+				tiles.emplace_back(read_hgt_layout(entry.path(), LV::Mapped_file{entry.path().string()}));
+
+			else if(extension == ".TIF" || extension == ".TIFF")
+				tiles.emplace_back(read_tiff_layout(entry.path(), LV::Mapped_file{entry.path().string()}));
+		}
+
+		return tiles;
+	}
+
+
+	// Copies the samples of the tile covering the bounds, plus a sample of margin.
+	LV::Dem::Grid read_local_tile(const Local_tile& tile, const LV::Bounds& bounds)
+	{
+		const LV::Trace::Span span{"Local elevation reading"};
+
+		const auto to_sample{[&](double offset, int maximum, bool end)
+		{
+			const double position{offset/tile.cell_size};
+			return std::clamp(static_cast<int>(end ? std::ceil(position)+1 :
+				std::floor(position)-1), 0, maximum);
+		}};
+
+		const glm::ivec2 start{to_sample(bounds.left-tile.left, tile.size.x, false),
+			to_sample(tile.top-bounds.top, tile.size.y, false)};
+
+		const glm::ivec2 end{to_sample(bounds.right-tile.left, tile.size.x, true),
+			to_sample(tile.top-bounds.bottom, tile.size.y, true)};
+
+		LV::Dem::Grid grid;
+		grid.size = glm::max(end-start, glm::ivec2{0});
+		grid.cell_size = tile.cell_size;
+		grid.left = tile.left+start.x*tile.cell_size;
+		grid.top = tile.top-start.y*tile.cell_size;
+		grid.elevations.resize(static_cast<size_t>(grid.size.x)*grid.size.y);
+		if(grid.elevations.empty()) return grid;
+
+		const LV::Mapped_file file{tile.path};
+		for(int z{}; z < grid.size.y; ++z)
+			for(int x{}; x < grid.size.x; ++x)
+				grid.elevations[static_cast<size_t>(z)*grid.size.x+x] =
+					read_sample(file, tile, start.x+x, start.y+z);
+
+		return grid;
+	}
+
+
+	// Finds the local files overlapping the bounds.
+	std::vector<Local_tile> find_covering_local_tiles(const LV::Bounds& bounds)
+	{
+		std::vector<Local_tile> tiles;
+		for(Local_tile& tile : find_local_tiles())
+			if(tile.left < bounds.right && tile.left+tile.size.x*tile.cell_size > bounds.left &&
+				tile.top > bounds.bottom && tile.top-tile.size.y*tile.cell_size < bounds.top)
+				tiles.emplace_back(std::move(tile));
+
+		if(tiles.empty()) throw std::runtime_error{
+			"No local elevation files cover the requested area."};
+
+		return tiles;
+	}
+
+
+	LV::Dem::Grid retrieve_local(const LV::Bounds& bounds)
+	{
+		const std::vector<Local_tile> tiles{find_covering_local_tiles(bounds)};
+
+		// Read the covered samples in parallel, using the finest resolution available.
+		std::vector<LV::Dem::Grid> grids(tiles.size());
+		LV::Utilities::parallel_for(tiles.size(), [&](size_t tile)
+			{ grids[tile] = read_local_tile(tiles[tile], bounds); });
+
+		double cell_size{tiles[0].cell_size};
+		for(const Local_tile& tile : tiles) cell_size = std::min(cell_size, tile.cell_size);
+
+		LV::Utilities::print("Read "+std::to_string(tiles.size())+" local elevation files.\n");
+		return assemble(grids, bounds, cell_size);
+	}
+
+
+	bool is_local(const std::string& dataset)
+	{
+		return LV::Utilities::to_uppercase(dataset) ==
+			LV::Utilities::to_uppercase(LV::Constants::local_dataset_name);
+	}
+
+
+	// Returns the supported OpenTopography dataset's name as spelled by OpenTopography.
+	std::string match_dataset(const std::string& dataset, bool* is_usgs)
+	{
+		const std::set<std::string>::iterator usgs_iterator{LV::Constants::supported_usgs_datasets.find(dataset)};
+		const std::set<std::string>::iterator global_iterator{LV::Constants::supported_global_datasets.find(dataset)};
+		*is_usgs = usgs_iterator != LV::Constants::supported_usgs_datasets.end();
+		const bool is_global{global_iterator != LV::Constants::supported_global_datasets.end()};
+		if(!*is_usgs && !is_global) throw std::runtime_error{"Unrecognized dataset."};
+		return *is_usgs ? *usgs_iterator : *global_iterator;
+	}
+}
+
+
+LV::Dem::Source LV::Dem::get_source(const std::string& dataset, const std::string& api_key)
+{
+	if(is_local(dataset)) return retrieve_local;
+
+	bool is_usgs;
+	const std::string matched_dataset{match_dataset(dataset, &is_usgs)};
+
+	return [=](const LV::Bounds& bounds)
+		{ return retrieve_opentopography(matched_dataset, is_usgs, bounds, api_key); };
+}
+
+
+LV::Dem::Grid LV::Dem::retrieve(const std::string& dataset,
+	const LV::Bounds& bounds, const std::string& api_key)
+{ return get_source(dataset, api_key)(bounds); }
+
+
+LV::Dem::Plan LV::Dem::plan(const std::string& dataset, const LV::Bounds& bounds)
+{
+	Plan plan{};
+
+	if(is_local(dataset))
+	{
+		const std::vector<Local_tile> tiles{find_covering_local_tiles(bounds)};
+		plan.cell_size = tiles[0].cell_size;
+		plan.tile_count = plan.cached_tile_count = static_cast<int>(tiles.size());
+
+		// Only the samples covering the bounds are read from each file.
+		for(const Local_tile& tile : tiles)
+		{
+			plan.cell_size = std::min(plan.cell_size, tile.cell_size);
+
+			const double width{std::min<double>(bounds.right, tile.left+tile.size.x*tile.cell_size)-
+				std::max<double>(bounds.left, tile.left)};
+
+			const double height{std::min<double>(bounds.top, tile.top)-
+				std::max<double>(bounds.bottom, tile.top-tile.size.y*tile.cell_size)};
+
+			plan.tile_bytes += static_cast<uint64_t>((width/tile.cell_size+3.)*
+				(height/tile.cell_size+3.))*sizeof(float);
+		}
+	}
+
+	else
+	{
+		bool is_usgs;
+		const std::string matched_dataset{match_dataset(dataset, &is_usgs)};
+		const double tile_degrees{LV::Constants::dem_tile_degrees.at(matched_dataset)};
+		plan.cell_size = LV::Constants::dem_cell_degrees.at(matched_dataset);
+
+		glm::ivec2 first_tile, tile_count;
+		get_tile_range(bounds, tile_degrees, &first_tile, &tile_count);
+		plan.tile_count = tile_count.x*tile_count.y;
+
+		for(int y{}; y < tile_count.y; ++y) for(int x{}; x < tile_count.x; ++x)
+			if(std::filesystem::exists(get_tile_path(matched_dataset, first_tile+glm::ivec2{x, y})))
+				++plan.cached_tile_count;
+
+		// Every tile is held until the grid is assembled.
+		const double tile_side{std::ceil((tile_degrees+2.*get_tile_margin(matched_dataset))/
+			plan.cell_size)};
+		const uint64_t tile_cells{static_cast<uint64_t>(tile_side*tile_side)};
+		plan.tile_bytes = plan.tile_count*tile_cells*sizeof(float);
+
+		plan.download_bytes = static_cast<uint64_t>((plan.tile_count-plan.cached_tile_count)*
+			tile_cells*(is_usgs ? usgs_response_bytes_per_value : global_response_bytes_per_value));
+	}
+
+	plan.size = get_grid_size(bounds, plan.cell_size);
+	return plan;
+}
+
+
+LV::Dem::Grid LV::Dem::parse_grid(std::string_view text)
+{
+	const LV::Trace::Span span{"Elevation parsing"};
+	const LV::Memory::Scope memory{"Elevation parsing"};
+
+	LV::Dem::Grid grid{};
+	double bottom{};
+	double no_data{-9999.}; // The usual value, for grids without a NODATA_value.
+	bool centered{};
+
+	// Parse the header.
+	while(!text.empty() && std::isalpha(static_cast<unsigned char>(text.front())))
+	{
+		const size_t end{std::min(text.find('\n'), text.size())};
+		std::istringstream line{std::string{text.substr(0, end)}};
+		text.remove_prefix(std::min(end+1, text.size()));
+
+		std::string key;
+		double value;
+		line>>key>>value;
+		key = LV::Utilities::to_uppercase(key);
+
+		if(key == "NCOLS") grid.size.x = static_cast<int>(value);
+		else if(key == "NROWS") grid.size.y = static_cast<int>(value);
+		else if(key == "XLLCORNER" || key == "XLLCENTER") grid.left = value;
+		else if(key == "YLLCORNER" || key == "YLLCENTER") bottom = value;
+		else if(key == "CELLSIZE") grid.cell_size = value;
+		else if(key == "NODATA_VALUE") no_data = value;
+		centered = centered || key == "XLLCENTER";
+	}
+
+	if(grid.size.x <= 0 || grid.size.y <= 0 || grid.cell_size <= 0.)
+		throw std::runtime_error{"Failed to parse the topography data."};
+
+	if(centered)
+	{
+		grid.left -= grid.cell_size/2.;
+		bottom -= grid.cell_size/2.;
+	}
+
+	grid.top = bottom+grid.size.y*grid.cell_size;
+
+	// Parse the values.
+	const size_t count{static_cast<size_t>(grid.size.x)*grid.size.y};
+	grid.elevations.reserve(count);
+	const char* position{text.data()};
+	const char* const end{text.data()+text.size()};
+
+	while(grid.elevations.size() < count)
+	{
+		while(position < end && std::isspace(static_cast<unsigned char>(*position))) ++position;
+
+		double value;
+		const std::from_chars_result result{std::from_chars(position, end, value)};
+		if(result.ec != std::errc{}) throw std::runtime_error{
+			"Failed to parse the topography data."};
+
+		position = result.ptr;
+		grid.elevations.emplace_back((value == no_data) ?
+			std::numeric_limits<float>::quiet_NaN() : static_cast<float>(value));
+	}
+
+	return grid;
+}
@@ -0,0 +1,59 @@
+/*
+	Copyright Myles Trevino
+	Licensed under the Apache License, Version 2.0
+	https://www.apache.org/licenses/LICENSE-2.0
+*/
+
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <functional>
+#include <glm/glm.hpp>
+
+#include "Frustum.hpp"
+
+
+namespace LV::Dem
+{
+	struct Grid
+	{
+		glm::ivec2 size;
+		double left; // Longitude of the left edge.
+		double top; // Latitude of the top edge.
+		double cell_size; // Degrees per cell.
+		std::vector<float> elevations; // Meters, by row from the top. NaN where there is no data.
+	};
+
+
+	// Returns the grid covering the bounds.
+	using Source = std::function<Grid(const LV::Bounds& bounds)>;
+
+
+	// The local dataset reads SRTM .hgt tiles and uncompressed GeoTIFFs from the DEM
+	// folder through memory mappings. Other datasets are downloaded from OpenTopography
+	// as tiles on a fixed geographic grid which are cached on disk per dataset, so only
+	// the tiles missing from the cache are downloaded. The least recently used tiles
+	// are evicted once the cache exceeds its budget.
+	Source get_source(const std::string& dataset, const std::string& api_key);
+
+	Grid retrieve(const std::string& dataset, const LV::Bounds& bounds, const std::string& api_key);
+
+	// What retrieving the grid covering the bounds involves, found without the network.
+	struct Plan
+	{
+		glm::ivec2 size; // Of the grid.
+		double cell_size; // Degrees per cell.
+		int tile_count; // Tiles, or local files, read.
+		int cached_tile_count; // Of the tiles read, those which are not downloaded.
+		uint64_t tile_bytes; // Held in memory while the grid is assembled.
+		uint64_t download_bytes; // About that of the missing tiles' responses.
+	};
+
+	Plan plan(const std::string& dataset, const LV::Bounds& bounds);
+
+	// Parses an Arc ASCII grid, converting the missing values to NaN.
+	Grid parse_grid(std::string_view text);
+}
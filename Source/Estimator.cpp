@@ -0,0 +1,306 @@
+/*
+	Copyright Myles Trevino
+	Licensed under the Apache License, Version 2.0
+	https://www.apache.org/licenses/LICENSE-2.0
+*/
+
+
+#include "Estimator.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <thread>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+
+#include "Constants.hpp"
+#include "Utilities.hpp"
+#include "Dem.hpp"
+
+
+namespace
+{
+	// Rough averages, since they depend on the terrain.
+	constexpr double saved_bytes_per_point{1.5};
+	constexpr double obj_bytes_per_coordinate{10.}; // Including its separator.
+
+
+	struct Estimate
+	{
+		LV::Dem::Plan plan;
+		glm::ivec2 size; // Of the terrain once resampled.
+		uint64_t terrain_vertices;
+		uint64_t terrain_triangles;
+		uint64_t base_vertices;
+		uint64_t base_triangles;
+		uint64_t generation_memory; // Peak bytes.
+		uint64_t viewing_memory;
+		uint64_t disk_bytes;
+	};
+
+
+	double get_meters_per_cell(double cell_size)
+	{ return LV::Constants::meters_per_frustum_base_unit*cell_size/.0003; }
+
+
+	Estimate get_estimate(const LV::Dem::Plan& plan, const LV::Frustum::Save_options& options)
+	{
+		Estimate estimate{plan};
+
+		LV::Frustum::Data data;
+		data.size = plan.size;
+		data.cell_size = .0003/plan.cell_size;
+		estimate.size = LV::Frustum::get_resampled_size(data, options);
+
+		const uint64_t source_points{static_cast<uint64_t>(plan.size.x)*plan.size.y};
+		const uint64_t points{static_cast<uint64_t>(estimate.size.x)*estimate.size.y};
+
+		// The terrain has a vertex per point, and the base two per edge point and the four
+		// bottom corners.
+		estimate.terrain_vertices = points;
+		estimate.terrain_triangles = 2ull*(estimate.size.x-1)*(estimate.size.y-1);
+		estimate.base_vertices = 4ull*(estimate.size.x+estimate.size.y)+4;
+		estimate.base_triangles = 4ull*(estimate.size.x-1)+4ull*(estimate.size.y-1)+2;
+		estimate.disk_bytes = static_cast<uint64_t>(points*saved_bytes_per_point);
+
+		// Retrieval holds the tiles, and the responses being downloaded, with the grid.
+		const uint64_t missing_tiles{static_cast<uint64_t>(plan.tile_count-plan.cached_tile_count)};
+		const uint64_t responses{(missing_tiles == 0) ? 0 : plan.download_bytes/missing_tiles*
+			std::min<uint64_t>(missing_tiles, std::max(std::thread::hardware_concurrency(), 1u))};
+
+		const uint64_t retrieval{plan.tile_bytes+responses+source_points*sizeof(float)};
+
+		// Conversion holds the grid and the terrain, resampling the terrain, its resampled
+		// columns, and the result, and saving the terrain and its encoding.
+		const uint64_t conversion{2*source_points*sizeof(float)};
+		const uint64_t resampling{(points == source_points) ? 0 : (source_points+
+			static_cast<uint64_t>(plan.size.y)*estimate.size.x+points)*sizeof(float)};
+
+		const uint64_t saving{points*sizeof(float)+2*estimate.disk_bytes};
+		estimate.generation_memory = std::max({retrieval, conversion, resampling, saving});
+
+		// Viewing holds the terrain, and the meshes' vertices with the terrain's normals
+		// and their indices.
+		estimate.viewing_memory = points*sizeof(float)+estimate.terrain_vertices*
+			2*sizeof(glm::fvec3)+estimate.base_vertices*sizeof(glm::fvec3)+
+			(estimate.terrain_triangles+estimate.base_triangles)*3*sizeof(unsigned);
+
+		return estimate;
+	}
+
+
+	// Returns the size of each export format's file in bytes.
+	std::vector<std::pair<std::string, uint64_t>> get_export_sizes(const Estimate& estimate)
+	{
+		const uint64_t vertices{estimate.terrain_vertices+estimate.base_vertices};
+		const uint64_t triangles{estimate.terrain_triangles+estimate.base_triangles};
+		const double index_digits{std::floor(std::log10(static_cast<double>(vertices)))+1.};
+
+		// GLTF indices are 16 bits when the mesh has few enough vertices.
+		const auto get_index_bytes{[](uint64_t vertices, uint64_t triangles)
+		{
+			const bool short_indices{vertices <= std::numeric_limits<uint16_t>::max()};
+			return triangles*3*(short_indices ? sizeof(uint16_t) : sizeof(uint32_t));
+		}};
+
+		std::vector<std::pair<std::string, uint64_t>> sizes;
+		for(const std::string& format : LV::Constants::supported_formats)
+		{
+			double bytes;
+
+			if(format == "ply") bytes = 256.+12.*vertices+13.*triangles;
+			else if(format == "stl") bytes = 84.+50.*triangles;
+
+			else if(format == "obj") bytes = vertices*(3.+3.*obj_bytes_per_coordinate)+
+				triangles*(5.+3.*index_digits);
+
+			// Quantized positions, byte normals for the terrain, and the JSON.
+			else if(format == "glb") bytes = 2048.+8.*vertices+4.*estimate.terrain_vertices+
+				get_index_bytes(estimate.terrain_vertices, estimate.terrain_triangles)+
+				get_index_bytes(estimate.base_vertices, estimate.base_triangles);
+
+			else continue;
+			sizes.emplace_back(format, static_cast<uint64_t>(bytes));
+		}
+
+		return sizes;
+	}
+
+
+	bool fits(const Estimate& estimate, const LV::Estimator::Budget& budget)
+	{
+		return (budget.memory == 0 || std::max(estimate.generation_memory,
+			estimate.viewing_memory) <= budget.memory) && (budget.triangles == 0 ||
+			estimate.terrain_triangles+estimate.base_triangles <= budget.triangles);
+	}
+
+
+	double to_megabytes(uint64_t bytes){ return bytes/(1024.*1024.); }
+
+
+	void print_estimate(const std::string& dataset, const Estimate& estimate)
+	{
+		const LV::Dem::Plan& plan{estimate.plan};
+
+		std::cout<<std::fixed<<std::setprecision(1)<<"\nEstimate for '"<<dataset<<"':\n"<<
+			"  Grid         "<<plan.size.x<<'x'<<plan.size.y<<" points, about "<<
+			get_meters_per_cell(plan.cell_size)<<" meters apart\n"<<
+			"  Tiles        "<<plan.tile_count<<" ("<<plan.cached_tile_count<<" cached), "<<
+			to_megabytes(plan.download_bytes)<<" MB to download\n";
+
+		if(estimate.size != plan.size) std::cout<<"  Resampled    "<<estimate.size.x<<'x'<<
+			estimate.size.y<<" points, about "<<get_meters_per_cell(plan.cell_size)*
+			plan.size.x/estimate.size.x<<" meters apart\n";
+
+		std::cout<<"  Triangles    "<<estimate.terrain_triangles<<" terrain, "<<
+			estimate.base_triangles<<" base\n"<<
+			"  Peak memory  "<<to_megabytes(estimate.generation_memory)<<" MB generating, "<<
+			to_megabytes(estimate.viewing_memory)<<" MB viewing\n"<<
+			"  Disk         "<<to_megabytes(estimate.disk_bytes)<<" MB\n"<<
+			"  Exports      ";
+
+		const char* separator{""};
+		for(const auto& [format, bytes] : get_export_sizes(estimate))
+		{
+			std::cout<<separator<<LV::Utilities::to_uppercase(format)<<' '<<to_megabytes(bytes)<<" MB";
+			separator = ", ";
+		}
+
+		std::cout<<"\nBuildings are not included, since they are only known once retrieved.\n"<<
+			std::defaultfloat;
+	}
+
+
+	// Recommends the dataset and resolution keeping the most terrain points within the
+	// budget, preferring less memory and then the requested dataset.
+	void recommend(const std::string& requested_dataset, const LV::Bounds& bounds,
+		const LV::Estimator::Budget& budget)
+	{
+		std::vector<std::string> datasets;
+		for(const auto& [dataset, cell_size] : LV::Constants::dem_cell_degrees)
+			datasets.emplace_back(dataset);
+
+		if(LV::Utilities::to_uppercase(requested_dataset) ==
+			LV::Utilities::to_uppercase(LV::Constants::local_dataset_name))
+			datasets.emplace_back(requested_dataset);
+
+		std::cout<<"\nWithin the budget:\n";
+		std::string best_dataset;
+		Estimate best{};
+		uint64_t best_vertex_budget{};
+
+		for(const std::string& dataset : datasets)
+		{
+			LV::Dem::Plan plan;
+			try{ plan = LV::Dem::plan(dataset, bounds); }
+			catch(const std::exception& error)
+			{
+				std::cout<<"  "<<std::left<<std::setw(10)<<dataset<<std::right<<error.what()<<'\n';
+				continue;
+			}
+
+			// Find the largest vertex budget fitting, if the dataset's resolution does not.
+			LV::Frustum::Save_options options;
+			Estimate estimate{get_estimate(plan, options)};
+
+			if(!fits(estimate, budget))
+			{
+				uint64_t low{4}, high{static_cast<uint64_t>(plan.size.x)*plan.size.y-1};
+				options.vertex_budget = low;
+
+				if(!fits(get_estimate(plan, options), budget))
+				{
+					std::cout<<"  "<<std::left<<std::setw(10)<<dataset<<std::right<<
+						"Does not fit, even when resampled.\n";
+					continue;
+				}
+
+				while(low < high)
+				{
+					options.vertex_budget = low+(high-low+1)/2;
+					if(fits(get_estimate(plan, options), budget)) low = options.vertex_budget;
+					else high = options.vertex_budget-1;
+				}
+
+				options.vertex_budget = low;
+				estimate = get_estimate(plan, options);
+			}
+
+			std::cout<<"  "<<std::left<<std::setw(10)<<dataset<<std::right<<estimate.size.x<<'x'<<
+				estimate.size.y<<" points"<<(options.vertex_budget > 0 ? " once resampled" : "")<<'\n';
+
+			const uint64_t points{estimate.terrain_vertices}, best_points{best.terrain_vertices};
+			const uint64_t memory{std::max(estimate.generation_memory, estimate.viewing_memory)};
+			const uint64_t best_memory{std::max(best.generation_memory, best.viewing_memory)};
+
+			if(best_dataset.empty() || points > best_points || (points == best_points &&
+				(memory < best_memory || (memory == best_memory && LV::Utilities::to_uppercase(dataset) ==
+				LV::Utilities::to_uppercase(requested_dataset)))))
+			{
+				best_dataset = dataset;
+				best = estimate;
+				best_vertex_budget = options.vertex_budget;
+			}
+		}
+
+		if(best_dataset.empty())
+		{
+			std::cout<<"No dataset fits the budget. Divide the area into smaller Frustums.\n";
+			return;
+		}
+
+		std::cout<<"Recommended: generate with '"<<best_dataset<<'\'';
+		if(best_vertex_budget > 0) std::cout<<" and 'resolution="<<best_vertex_budget<<'\'';
+		std::cout<<'.';
+
+		if(LV::Constants::supported_usgs_datasets.contains(best_dataset))
+			std::cout<<" USGS datasets only cover the United States.";
+
+		std::cout<<'\n';
+	}
+}
+
+
+void LV::Estimator::parse_options(const std::map<std::string, std::string>& options,
+	LV::Frustum::Save_options* save_options, Budget* budget)
+{
+	std::map<std::string, std::string> remaining_options{options};
+	*budget = {};
+
+	const auto extract{[&](const std::string& key) -> uint64_t
+	{
+		const auto option{remaining_options.find(key)};
+		if(option == remaining_options.end()) return 0;
+
+		const double value{std::stod(option->second)};
+		if(!(value > 0.)) throw std::runtime_error{"'"+key+"' must be positive."};
+
+		remaining_options.erase(option);
+		return static_cast<uint64_t>(value);
+	}};
+
+	budget->memory = extract("memory")*1024*1024;
+	budget->triangles = extract("triangles");
+	*save_options = LV::Frustum::parse_save_options(remaining_options);
+}
+
+
+void LV::Estimator::estimate(const std::string& dataset, float top, float left,
+	float bottom, float right, const LV::Frustum::Save_options& options, const Budget& budget)
+{
+	LV::Frustum::validate_bounds(top, left, bottom, right);
+	const LV::Bounds bounds{LV::Frustum::get_compensated_bounds({top, left, bottom, right})};
+
+	const Estimate estimate{get_estimate(LV::Dem::plan(dataset, bounds), options)};
+	print_estimate(dataset, estimate);
+
+	if(budget.memory > 0 || budget.triangles > 0)
+	{
+		if(fits(estimate, budget)) std::cout<<"This fits within the budget.\n";
+		else std::cout<<"This exceeds the budget.\n";
+		recommend(dataset, bounds, budget);
+	}
+}
@@ -0,0 +1,38 @@
+/*
+	Copyright Myles Trevino
+	Licensed under the Apache License, Version 2.0
+	https://www.apache.org/licenses/LICENSE-2.0
+*/
+
+
+#pragma once
+
+#include <string>
+#include <map>
+#include <cstdint>
+
+#include "Frustum.hpp"
+
+
+namespace LV::Estimator
+{
+	struct Budget
+	{
+		uint64_t memory{}; // Peak bytes, or zero for no limit.
+		uint64_t triangles{}; // Of the terrain and base, or zero for no limit.
+	};
+
+
+	// Parses 'key=value' estimate options, which are those of generate plus the budget's
+	// 'memory=<megabytes>' and 'triangles=<count>'.
+	void parse_options(const std::map<std::string, std::string>& options,
+		LV::Frustum::Save_options* save_options, Budget* budget);
+
+	// Predicts the grid size, download, peak memory, disk use, triangle counts, and
+	// export sizes of generating the Frustum from the bounds and the dataset's cell size
+	// alone, without the network. If a budget is given, the dataset and resolution
+	// keeping the most detail within it are also recommended. Buildings are not
+	// included, since they are only known once retrieved.
+	void estimate(const std::string& dataset, float top, float left, float bottom,
+		float right, const LV::Frustum::Save_options& options = {}, const Budget& budget = {});
+}
@@ -8,30 +8,478 @@
 #include "Exporter.hpp"
 
 #include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
 #include <filesystem>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <charconv>
+#include <bit>
+#include <cstring>
 #include <assimp/Exporter.hpp>
 #include <assimp/scene.h>
 
 #include "Constants.hpp"
 #include "Utilities.hpp"
 #include "Frustum.hpp"
+#include "Gltf.hpp"
+#include "Optimizer.hpp"
+#include "Trace.hpp"
+#include "Memory.hpp"
+
+
+static_assert(std::endian::native == std::endian::little,
+	"The native exporters write little-endian data directly from memory.");
 
 
 namespace
 {
-	std::string format;
-	std::string name;
-	bool z_up;
+	constexpr size_t output_buffer_size{1 << 22};
+
+	struct Output
+	{
+		std::ofstream file;
+		std::vector<char> buffer;
+	};
+
+	struct Export_mesh
+	{
+		std::string name;
+		const LV::Mesh* mesh;
+		bool has_normals;
+	};
+
+	std::mutex path_mutexes_mutex;
+	std::map<std::string, std::mutex> path_mutexes;
+
+
+	// Serializes the exports to the path, since each writes its files in place.
+	std::unique_lock<std::mutex> lock_path(const std::string& path)
+	{
+		std::mutex* mutex;
+
+		{
+			const std::lock_guard lock{path_mutexes_mutex};
+			mutex = &path_mutexes[path];
+		}
+
+		return std::unique_lock{*mutex};
+	}
+
+
+	void open_output(Output* output, const std::string& path)
+	{
+		output->file.open(path, std::ios::binary);
+		if(!output->file) throw std::runtime_error{"Failed to open the export file."};
+		output->buffer.reserve(output_buffer_size);
+	}
+
+
+	void flush_output(Output* output)
+	{
+		output->file.write(output->buffer.data(), output->buffer.size());
+		output->buffer.clear();
+		if(!output->file) throw std::runtime_error{"Failed to write the export file."};
+	}
+
+
+	void write(Output* output, const void* data, size_t size)
+	{
+		if(output->buffer.size()+size > output_buffer_size) flush_output(output);
+
+		const char* bytes{static_cast<const char*>(data)};
+		output->buffer.insert(output->buffer.end(), bytes, bytes+size);
+	}
+
+
+	void write(Output* output, const std::string& string)
+	{ write(output, string.data(), string.size()); }
+
+
+	void write_number(Output* output, float number)
+	{
+		char characters[32];
+		const std::to_chars_result result{std::to_chars(
+			characters, characters+sizeof(characters), number)};
+
+		write(output, characters, result.ptr-characters);
+	}
+
+
+	void write_number(Output* output, unsigned number)
+	{
+		char characters[16];
+		const std::to_chars_result result{std::to_chars(
+			characters, characters+sizeof(characters), number)};
+
+		write(output, characters, result.ptr-characters);
+	}
+
+
+	size_t get_vertex_count(const Export_mesh& mesh)
+	{ return mesh.mesh->vertices.size()/(mesh.has_normals ? 2 : 1); }
+
+
+	glm::fvec3 get_vertex(const Export_mesh& mesh, size_t index, bool z_up)
+	{
+		const glm::fvec3 vertex{mesh.mesh->vertices[index*(mesh.has_normals ? 2 : 1)]};
+		return z_up ? glm::fvec3{vertex.x, -vertex.z, vertex.y} : vertex;
+	}
+
+
+	std::vector<Export_mesh> get_export_meshes(const LV::Frustum::Meshes& meshes)
+	{
+		for(const LV::Mesh* mesh : {&meshes.terrain, &meshes.base, &meshes.buildings})
+			if(mesh->indices.size()%3 != 0)
+				throw std::runtime_error{"Failed to generate the export data."};
+
+		return {{"Terrain", &meshes.terrain, true}, {"Base", &meshes.base, false},
+			{"Buildings", &meshes.buildings, false}};
+	}
+
+
+	void write_ply_header(Output* output, size_t vertex_count, size_t face_count)
+	{
+		write(output, "ply\nformat binary_little_endian 1.0\ncomment "+
+			LV::Constants::program_name+"\nelement vertex "+std::to_string(vertex_count)+
+			"\nproperty float x\nproperty float y\nproperty float z\nelement face "+
+			std::to_string(face_count)+"\nproperty list uchar uint vertex_indices\nend_header\n");
+	}
+
+
+	// Writes the first vertices of the mesh.
+	void write_ply_vertices(Output* output, const Export_mesh& mesh, size_t count, bool z_up)
+	{
+		for(size_t index{}; index < count; ++index)
+		{
+			const glm::fvec3 vertex{get_vertex(mesh, index, z_up)};
+			write(output, &vertex, sizeof(vertex));
+		}
+	}
+
+
+	void write_ply_faces(Output* output, const LV::Mesh& mesh, unsigned index_offset)
+	{
+		const std::vector<unsigned>& indices{mesh.indices};
+
+		for(size_t index{}; index < indices.size(); index += 3)
+		{
+			char face[13]{3};
+			const unsigned face_indices[3]{indices[index]+index_offset,
+				indices[index+1]+index_offset, indices[index+2]+index_offset};
+
+			std::memcpy(face+1, face_indices, sizeof(face_indices));
+			write(output, face, sizeof(face));
+		}
+	}
+
+
+	void write_ply(Output* output, const std::vector<Export_mesh>& meshes, bool z_up)
+	{
+		// Write the header.
+		size_t vertex_count{}, face_count{};
+		for(const Export_mesh& mesh : meshes)
+		{
+			vertex_count += get_vertex_count(mesh);
+			face_count += mesh.mesh->indices.size()/3;
+		}
+
+		write_ply_header(output, vertex_count, face_count);
+
+		// Write the vertices.
+		for(const Export_mesh& mesh : meshes)
+			write_ply_vertices(output, mesh, get_vertex_count(mesh), z_up);
+
+		// Write the faces, offsetting each mesh's indices past the preceding meshes' vertices.
+		unsigned index_offset{};
+		for(const Export_mesh& mesh : meshes)
+		{
+			write_ply_faces(output, *mesh.mesh, index_offset);
+			index_offset += static_cast<unsigned>(get_vertex_count(mesh));
+		}
+	}
+
+
+	void write_stl_header(Output* output, uint32_t triangle_count)
+	{
+		char header[80]{};
+		LV::Constants::program_name.copy(header, sizeof(header));
+		write(output, header, sizeof(header));
+		write(output, &triangle_count, sizeof(triangle_count));
+	}
+
+
+	// Writes each triangle's normal, three vertices, and an empty attribute.
+	void write_stl_triangles(Output* output, const Export_mesh& mesh, bool z_up)
+	{
+		const std::vector<unsigned>& indices{mesh.mesh->indices};
+
+		for(size_t index{}; index < indices.size(); index += 3)
+		{
+			glm::fvec3 triangle[4];
+			for(int corner{}; corner < 3; ++corner)
+				triangle[corner+1] = get_vertex(mesh, indices[index+corner], z_up);
+
+			const glm::fvec3 normal{glm::cross(triangle[2]-triangle[1], triangle[3]-triangle[1])};
+			const float length{glm::length(normal)};
+			triangle[0] = (length > 0.f) ? normal/length : glm::fvec3{0.f, 0.f, 0.f};
+
+			const uint16_t attribute{};
+			write(output, triangle, sizeof(triangle));
+			write(output, &attribute, sizeof(attribute));
+		}
+	}
+
+
+	void write_stl(Output* output, const std::vector<Export_mesh>& meshes, bool z_up)
+	{
+		uint32_t triangle_count{};
+		for(const Export_mesh& mesh : meshes)
+			triangle_count += static_cast<uint32_t>(mesh.mesh->indices.size()/3);
+
+		write_stl_header(output, triangle_count);
+		for(const Export_mesh& mesh : meshes) write_stl_triangles(output, mesh, z_up);
+	}
+
+
+	void write_obj_header(Output* output, const std::string& material_file_name)
+	{ write(output, "# "+LV::Constants::program_name+"\nmtllib "+material_file_name+"\n"); }
+
+
+	void write_obj_object(Output* output, const std::string& name)
+	{ write(output, "\no "+name+"\nusemtl "+LV::Constants::material_name+"\n"); }
+
+
+	// Writes the first vertices of the mesh.
+	void write_obj_vertices(Output* output, const Export_mesh& mesh, size_t count, bool z_up)
+	{
+		for(size_t index{}; index < count; ++index)
+		{
+			const glm::fvec3 vertex{get_vertex(mesh, index, z_up)};
+
+			write(output, "v ", 2);
+			write_number(output, vertex.x);
+			write(output, " ", 1);
+			write_number(output, vertex.y);
+			write(output, " ", 1);
+			write_number(output, vertex.z);
+			write(output, "\n", 1);
+		}
+	}
+
+
+	void write_obj_faces(Output* output, const LV::Mesh& mesh, unsigned index_offset)
+	{
+		const std::vector<unsigned>& indices{mesh.indices};
+
+		for(size_t index{}; index < indices.size(); index += 3)
+		{
+			write(output, "f ", 2);
+			write_number(output, indices[index]+index_offset);
+			write(output, " ", 1);
+			write_number(output, indices[index+1]+index_offset);
+			write(output, " ", 1);
+			write_number(output, indices[index+2]+index_offset);
+			write(output, "\n", 1);
+		}
+	}
+
+
+	void write_obj(Output* output, const std::vector<Export_mesh>& meshes,
+		bool z_up, const std::string& material_file_name)
+	{
+		write_obj_header(output, material_file_name);
+
+		// Write each mesh as an object. OBJ indices are global and one-based.
+		unsigned index_offset{1};
+		for(const Export_mesh& mesh : meshes)
+		{
+			write_obj_object(output, mesh.name);
+			write_obj_vertices(output, mesh, get_vertex_count(mesh), z_up);
+			write_obj_faces(output, *mesh.mesh, index_offset);
+			index_offset += static_cast<unsigned>(get_vertex_count(mesh));
+		}
+	}
+
+
+	void write_mtl(const std::string& path)
+	{
+		std::ofstream file{path};
+		if(!file) throw std::runtime_error{"Failed to write the material file."};
+
+		const glm::fvec3 color{LV::Constants::material_color};
+		file<<"newmtl "<<LV::Constants::material_name<<"\nKd "<<
+			color.x<<' '<<color.y<<' '<<color.z<<'\n';
+	}
+
+
+	// Streams the meshes directly to the file without building an Assimp scene.
+	void export_native(const LV::Frustum::Meshes& meshes,
+		const std::string& format, const std::string& path, bool z_up)
+	{
+		const LV::Trace::Span span{"Native export"};
+		const LV::Memory::Scope memory{"Native export"};
+
+		std::cout<<"Exporting...\n";
+		const std::vector<Export_mesh> export_meshes{get_export_meshes(meshes)};
+
+		Output output;
+		open_output(&output, path);
+
+		if(format == "ply") write_ply(&output, export_meshes, z_up);
+		else if(format == "stl") write_stl(&output, export_meshes, z_up);
+		else if(format == "obj")
+		{
+			const std::filesystem::path material_path{
+				std::filesystem::path{path}.replace_extension(".mtl")};
+
+			write_obj(&output, export_meshes, z_up, material_path.filename().string());
+			write_mtl(material_path.string());
+		}
+
+		flush_output(&output);
+	}
+
+
+	// Copies the temporary file to the output and deletes it.
+	void append_file(Output* output, Output* file, const std::string& path)
+	{
+		flush_output(file);
+		file->file.close();
+		flush_output(output);
+
+		std::ifstream input{path, std::ios::binary};
+		if(!input) throw std::runtime_error{"Failed to read the temporary export file."};
+		if(input.peek() != std::ifstream::traits_type::eof()) output->file<<input.rdbuf();
+		input.close();
+
+		std::filesystem::remove(path);
+		if(!output->file) throw std::runtime_error{"Failed to write the export file."};
+	}
+
+
+	// Writes the terrain band by band as it is generated from the saved Frustum, so that
+	// memory use is bounded by the band size rather than the Frustum's. The faces are
+	// held in a temporary file when the format needs all of the vertices before them.
+	void export_streaming(const std::string& name,
+		const std::string& format, const std::string& path, bool z_up)
+	{
+		const LV::Trace::Span span{"Streaming export"};
+		const LV::Memory::Scope memory{"Streaming export"};
+
+		const std::string vertices_path{path+".vertices"};
+		const std::string faces_path{path+".faces"};
+		const std::filesystem::path material_path{
+			std::filesystem::path{path}.replace_extension(".mtl")};
+
+		Output output, vertices, faces;
+		Output& terrain_vertices{(format == "ply") ? vertices : output};
+		open_output(&terrain_vertices, (format == "ply") ? vertices_path : path);
+		if(format != "stl") open_output(&faces, faces_path);
+
+		// The STL triangle count is written once known.
+		if(format == "stl") write_stl_header(&output, 0);
+
+		else if(format == "obj")
+		{
+			write_obj_header(&output, material_path.filename().string());
+			write_obj_object(&output, "Terrain");
+		}
 
-	glm::fvec2 frustum_size;
-	LV::Mesh terrain_mesh;
-	LV::Mesh buildings_mesh;
-	LV::Mesh base_mesh;
-	aiScene* scene;
+		// Write the terrain.
+		unsigned terrain_vertex_count{};
+		size_t terrain_face_count{};
+
+		const LV::Frustum::Meshes meshes{LV::Frustum::stream_meshes(name,
+			LV::Constants::export_band_rows, [&](const LV::Frustum::Terrain_band& band)
+		{
+			const Export_mesh mesh{"Terrain", &band.mesh, true};
+			terrain_vertex_count += band.vertex_count;
+			terrain_face_count += band.mesh.indices.size()/3;
+
+			if(format == "stl") write_stl_triangles(&output, mesh, z_up);
+
+			else if(format == "ply")
+			{
+				write_ply_vertices(&vertices, mesh, band.vertex_count, z_up);
+				write_ply_faces(&faces, band.mesh, band.first_vertex);
+			}
+
+			else
+			{
+				write_obj_vertices(&output, mesh, band.vertex_count, z_up);
+				write_obj_faces(&faces, band.mesh, band.first_vertex+1);
+			}
+		})};
+
+		std::vector<Export_mesh> other_meshes{get_export_meshes(meshes)};
+		other_meshes.erase(other_meshes.begin());
+
+		// Write the other meshes after the terrain.
+		if(format == "stl")
+		{
+			uint32_t triangle_count{static_cast<uint32_t>(terrain_face_count)};
+			for(const Export_mesh& mesh : other_meshes)
+			{
+				write_stl_triangles(&output, mesh, z_up);
+				triangle_count += static_cast<uint32_t>(mesh.mesh->indices.size()/3);
+			}
+
+			flush_output(&output);
+			output.file.seekp(80);
+			output.file.write(reinterpret_cast<const char*>(&triangle_count), sizeof(triangle_count));
+		}
+
+		else if(format == "obj")
+		{
+			append_file(&output, &faces, faces_path);
+
+			unsigned index_offset{terrain_vertex_count+1};
+			for(const Export_mesh& mesh : other_meshes)
+			{
+				write_obj_object(&output, mesh.name);
+				write_obj_vertices(&output, mesh, get_vertex_count(mesh), z_up);
+				write_obj_faces(&output, *mesh.mesh, index_offset);
+				index_offset += static_cast<unsigned>(get_vertex_count(mesh));
+			}
+
+			write_mtl(material_path.string());
+		}
+
+		else
+		{
+			size_t vertex_count{terrain_vertex_count}, face_count{terrain_face_count};
+			for(const Export_mesh& mesh : other_meshes)
+			{
+				vertex_count += get_vertex_count(mesh);
+				face_count += mesh.mesh->indices.size()/3;
+			}
+
+			open_output(&output, path);
+			write_ply_header(&output, vertex_count, face_count);
+			append_file(&output, &vertices, vertices_path);
+
+			for(const Export_mesh& mesh : other_meshes)
+				write_ply_vertices(&output, mesh, get_vertex_count(mesh), z_up);
+
+			append_file(&output, &faces, faces_path);
+
+			unsigned index_offset{terrain_vertex_count};
+			for(const Export_mesh& mesh : other_meshes)
+			{
+				write_ply_faces(&output, *mesh.mesh, index_offset);
+				index_offset += static_cast<unsigned>(get_vertex_count(mesh));
+			}
+		}
+
+		flush_output(&output);
+	}
 
 
-	void populate_scene_mesh(unsigned scene_mesh_index, const std::string& mesh_name,
-		const LV::Mesh& frustum_mesh, bool has_normals)
+	void populate_scene_mesh(aiScene* scene, unsigned scene_mesh_index,
+		const std::string& mesh_name, const LV::Mesh& frustum_mesh, bool has_normals, bool z_up)
 	{
 		// Populate the vertices.
 		aiMesh* mesh{scene->mMeshes[scene_mesh_index]};
@@ -72,12 +520,15 @@ namespace
 	}
 
 
-	void generate_scene()
+	std::unique_ptr<aiScene> generate_scene(const LV::Frustum::Meshes& meshes, bool z_up)
 	{
+		const LV::Trace::Span span{"Scene generation"};
+		const LV::Memory::Scope memory{"Scene generation"};
+
 		std::cout<<"Generating the export data...\n";
 
 		// Create the scene and root node.
-		scene = new aiScene();
+		std::unique_ptr<aiScene> scene{new aiScene()};
 		scene->mRootNode = new aiNode();
 
 		// Create the material.
@@ -100,9 +551,9 @@ namespace
 			scene->mMeshes[index] = new aiMesh;
 			scene->mMeshes[index]->mMaterialIndex = 0;
 
-			if(index == 0) populate_scene_mesh(index, "Terrain", terrain_mesh, true);
-			else if(index == 1) populate_scene_mesh(index, "Base", base_mesh, false);
-			else if(index == 2) populate_scene_mesh(index, "Buildings", buildings_mesh, false);
+			if(index == 0) populate_scene_mesh(scene.get(), index, "Terrain", meshes.terrain, true, z_up);
+			else if(index == 1) populate_scene_mesh(scene.get(), index, "Base", meshes.base, false, z_up);
+			else if(index == 2) populate_scene_mesh(scene.get(), index, "Buildings", meshes.buildings, false, z_up);
 		}
 
 		// Link the meshes to the root node.
@@ -110,50 +561,238 @@ namespace
 		scene->mRootNode->mMeshes = new unsigned int[scene->mRootNode->mNumMeshes];
 		for(unsigned index{}; index < scene->mRootNode->mNumMeshes; ++index)
 			scene->mRootNode->mMeshes[index] = index;
+
+		return scene;
 	}
 
 
-	void export_scene()
+	void export_scene(const aiScene& scene, const std::string& format, const std::string& path)
 	{
+		const LV::Trace::Span span{"Assimp export"};
+		const LV::Memory::Scope memory{"Assimp export"};
+
 		std::cout<<"Exporting...\n";
-		std::filesystem::create_directory("Exports");
 
 		Assimp::Exporter exporter;
-		if(exporter.Export(scene, format, "Exports/"+name+"."+format) != AI_SUCCESS)
+		if(exporter.Export(&scene, format, path) != AI_SUCCESS)
 			throw std::runtime_error{"Export failed."};
 	}
+
+
+	LV::Frustum::Meshes optimize_meshes(const LV::Frustum::Meshes& meshes)
+	{
+		const LV::Trace::Span span{"Mesh optimization"};
+		const LV::Memory::Scope memory{"Mesh optimization"};
+
+		std::cout<<"Optimizing the meshes...\n";
+		LV::Frustum::Meshes optimized{meshes};
+
+		const std::vector<std::tuple<std::string, LV::Mesh*, bool>> parts{
+			{"Terrain", &optimized.terrain, true}, {"Base", &optimized.base, false},
+			{"Buildings", &optimized.buildings, false}};
+
+		for(const auto& [name, mesh, has_normals] : parts)
+		{
+			const LV::Optimizer::Statistics before{LV::Optimizer::analyze(*mesh, has_normals)};
+			LV::Optimizer::optimize(mesh, has_normals, LV::Constants::weld_tolerance);
+			const LV::Optimizer::Statistics after{LV::Optimizer::analyze(*mesh, has_normals)};
+
+			// Format locally, since tiles are optimized concurrently.
+			std::ostringstream line;
+			line<<name<<": "<<before.vertices<<" -> "<<after.vertices<<" vertices, ACMR "<<
+				std::fixed<<std::setprecision(3)<<before.acmr<<" -> "<<after.acmr<<", "<<
+				std::setprecision(1)<<before.bytes/1024.f<<" -> "<<after.bytes/1024.f<<" KiB.\n";
+
+			std::cout<<line.str();
+		}
+
+		return optimized;
+	}
+
+
+	std::string export_tiles(const LV::Frustum::Data& data, const std::string& format,
+		const std::string& orientation, const LV::Exporter::Options& options)
+	{
+		const glm::ivec2 tiles{options.tiles};
+		const glm::ivec2 cells{data.size.x-1, data.size.y-1};
+
+		if(tiles.x < 1 || tiles.y < 1 || tiles.x > cells.x || tiles.y > cells.y)
+			throw std::runtime_error{"Invalid tile count for a Frustum of "+
+				std::to_string(cells.x)+"x"+std::to_string(cells.y)+" cells."};
+
+		const std::string directory{"Exports/"+data.name+"/"};
+		const std::unique_lock<std::mutex> lock{lock_path(directory)};
+
+		std::cout<<"Exporting "<<tiles.x*tiles.y<<" tiles...\n";
+		LV::Exporter::Options tile_options{options};
+		tile_options.tiles = {1, 1};
+
+		// Neighboring tiles share their edge samples, so their edge vertices coincide.
+		LV::Utilities::parallel_for(static_cast<size_t>(tiles.x)*tiles.y, [&](size_t index)
+		{
+			const glm::ivec2 tile{static_cast<int>(index%tiles.x), static_cast<int>(index/tiles.x)};
+			const glm::ivec2 start{tile.x*cells.x/tiles.x, tile.y*cells.y/tiles.y};
+			const glm::ivec2 end{(tile.x+1)*cells.x/tiles.x, (tile.y+1)*cells.y/tiles.y};
+
+			LV::Frustum::Data tile_data{LV::Frustum::get_region(data,
+				start, glm::ivec2{end.x-start.x+1, end.y-start.y+1})};
+
+			tile_data.name = data.name+"/"+std::to_string(tile.x)+"-"+std::to_string(tile.y);
+
+			// Keep the tiles in the coordinate space of the whole Frustum.
+			const LV::Frustum::Meshes meshes{LV::Frustum::generate_meshes(tile_data, glm::fvec3{
+				start.x-data.size.x/2.f, 0.f, start.y-data.size.y/2.f})};
+
+			LV::Exporter::export_frustum(tile_data, meshes, format, orientation, tile_options);
+		});
+
+		return directory;
+	}
+
+
+	bool parse_orientation(const std::string& orientation)
+	{
+		if(orientation == "z-up") return true;
+		else if(orientation == "y-up") return false;
+		else throw std::runtime_error{"'orientation' must be either 'z-up' or 'y-up'."};
+	}
+}
+
+
+LV::Exporter::Options LV::Exporter::parse_options(
+	const std::map<std::string, std::string>& options)
+{
+	Options result;
+
+	for(const auto& [key, value] : options)
+	{
+		if(key == "compression")
+		{
+			if(value == "meshopt") result.meshopt_compression = true;
+			else if(value != "none") throw std::runtime_error{
+				"'compression' must be either 'meshopt' or 'none'."};
+		}
+
+		else if(key == "optimize")
+		{
+			if(value == "true") result.optimize = true;
+			else if(value != "false") throw std::runtime_error{
+				"'optimize' must be either 'true' or 'false'."};
+		}
+
+		else if(key == "streaming")
+		{
+			if(value == "true") result.streaming = true;
+			else if(value != "false") throw std::runtime_error{
+				"'streaming' must be either 'true' or 'false'."};
+		}
+
+		else if(key == "tiles")
+		{
+			const size_t separator{value.find('x')};
+			if(separator == std::string::npos) throw std::runtime_error{
+				"'tiles' must be given as '<columns>x<rows>', for example '4x4'."};
+
+			result.tiles = {std::stoi(value.substr(0, separator)),
+				std::stoi(value.substr(separator+1))};
+		}
+
+		else throw std::runtime_error{"Unrecognized export option '"+key+"'."};
+	}
+
+	return result;
 }
 
 
-void LV::Exporter::export_frustum(const std::string& name,
-	const std::string& format, const std::string& orientation)
+void LV::Exporter::validate(const std::string& format,
+	const std::string& orientation, const Options& options)
 {
-	::name = name;
-	::format = format;
+	if(!LV::Utilities::is_supported(format, LV::Constants::supported_formats))
+		throw std::runtime_error{"Unrecognized export format."};
+
+	if(options.meshopt_compression && format != "glb")
+		throw std::runtime_error{"Meshopt compression is only supported for GLB exports."};
+
+	if(options.streaming) throw std::runtime_error{
+		"Streaming is only supported when exporting a saved Frustum."};
 
-	// Validate the format.
+	parse_orientation(orientation);
+}
+
+
+void LV::Exporter::export_frustum(const std::string& name, const std::string& format,
+	const std::string& orientation, const Options& options)
+{
+	// Validate the parameters before loading.
 	if(!LV::Utilities::is_supported(format, LV::Constants::supported_formats))
 		throw std::runtime_error{"Unrecognized export format."};
 
-	// Parse the Y-Up variable.
-	if(orientation == "z-up") z_up = true;
-	else if(orientation == "y-up") z_up = false;
-	else throw std::runtime_error{"'orientation' must be either 'z-up' or 'y-up'."};
+	const bool z_up{parse_orientation(orientation)};
 
-	// Load the Frustum.
-	LV::Frustum::load(name);
-	frustum_size = LV::Frustum::get_size();
-	terrain_mesh = LV::Frustum::get_terrain_mesh();
-	buildings_mesh = LV::Frustum::get_buildings_mesh();
-	base_mesh = LV::Frustum::get_base_mesh();
+	// Stream the terrain from the saved Frustum instead of loading it.
+	if(options.streaming)
+	{
+		if(!LV::Utilities::is_supported(format, LV::Constants::native_formats))
+			throw std::runtime_error{"Streaming is only supported for PLY, OBJ, and STL exports."};
+
+		if(options.tiles != glm::ivec2{1, 1} || options.optimize) throw std::runtime_error{
+			"Streaming cannot be combined with 'tiles' or 'optimize'."};
 
-	// Generate the Assimp scene.
-	generate_scene();
+		const std::string path{"Exports/"+name+"."+format};
+		std::filesystem::create_directories(std::filesystem::path{path}.parent_path());
+
+		const std::unique_lock<std::mutex> lock{lock_path(path)};
+		export_streaming(name, format, path, z_up);
+		std::cout<<"Export finished.\n";
+		return;
+	}
+
+	// Load the Frustum. Tiled exports generate the meshes per tile.
+	LV::Frustum::Data data;
+	LV::Frustum::Meshes meshes;
+
+	if(options.tiles == glm::ivec2{1, 1}) LV::Frustum::load(name, &data, &meshes);
+	else data = LV::Frustum::load(name);
+
+	// Export.
+	export_frustum(data, meshes, format, orientation, options);
+}
+
+
+std::string LV::Exporter::export_frustum(const LV::Frustum::Data& data,
+	const LV::Frustum::Meshes& meshes, const std::string& format,
+	const std::string& orientation, const Options& options)
+{
+	validate(format, orientation, options);
+	const bool z_up{parse_orientation(orientation)};
+
+	if(options.tiles != glm::ivec2{1, 1})
+		return export_tiles(data, format, orientation, options);
+
+	const std::string path{"Exports/"+data.name+"."+format};
+	std::filesystem::create_directories(std::filesystem::path{path}.parent_path());
+	const std::unique_lock<std::mutex> lock{lock_path(path)};
+
+	// Optimize the meshes if requested.
+	LV::Frustum::Meshes optimized_meshes;
+	if(options.optimize) optimized_meshes = optimize_meshes(meshes);
+	const LV::Frustum::Meshes& export_meshes{options.optimize ? optimized_meshes : meshes};
+
+	// Write the native formats directly.
+	if(LV::Utilities::is_supported(format, LV::Constants::native_formats))
+		export_native(export_meshes, format, path, z_up);
+
+	else if(format == "glb")
+		LV::Gltf::export_glb(export_meshes, path, z_up, options.meshopt_compression);
+
+	// Export other formats through an Assimp scene.
+	else
+	{
+		const std::unique_ptr<aiScene> scene{generate_scene(export_meshes, z_up)};
+		export_scene(*scene, format, path);
+	}
 
-	// Export the Assimp scene as the given format.
-	export_scene();
 	std::cout<<"Export finished.\n";
 
-	// Destroy the scene.
-	delete scene;
+	return path;
 }
@@ -8,10 +8,36 @@
 #pragma once
 
 #include <string>
+#include <map>
+
+#include "Frustum.hpp"
 
 
 namespace LV::Exporter
 {
+	struct Options
+	{
+		bool meshopt_compression{};
+		glm::ivec2 tiles{1, 1}; // Exports a separate file per tile if larger than 1x1.
+		bool optimize{}; // Welds and reorders the meshes for smaller, faster models.
+		bool streaming{}; // Exports the saved terrain band by band instead of loading it whole.
+	};
+
+
+	// Parses 'key=value' export options.
+	Options parse_options(const std::map<std::string, std::string>& options);
+
+	// Throws if the format, orientation, or options cannot be used to export loaded data.
+	void validate(const std::string& format, const std::string& orientation,
+		const Options& options);
+
 	void export_frustum(const std::string& name, const std::string& format,
-		const std::string& orientation);
+		const std::string& orientation, const Options& options = {});
+
+	// Exports already loaded data, so streaming is not supported, and returns the path
+	// of the exported file, or of the directory containing the tiles. Safe to call
+	// concurrently, as exports to the same path wait for each other.
+	std::string export_frustum(const LV::Frustum::Data& data,
+		const LV::Frustum::Meshes& meshes, const std::string& format,
+		const std::string& orientation, const Options& options = {});
 }
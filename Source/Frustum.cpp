@@ -11,66 +11,34 @@
 #include <fstream>
 #include <sstream>
 #include <set>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <iomanip>
+#include <algorithm>
 #include <filesystem>
+#include <chrono>
+#include <charconv>
+#include <limits>
+#include <functional>
+#include <string_view>
 #include <glm/gtc/reciprocal.hpp>
 #include <glm/gtx/transform.hpp>
-#include <nlohmann/json.hpp>
 #include <earcut/earcut.hpp>
 
 #include "Request.hpp"
+#include "Codec.hpp"
+#include "Dem.hpp"
+#include "Osm.hpp"
 #include "Constants.hpp"
 #include "Utilities.hpp"
+#include "Trace.hpp"
+#include "Memory.hpp"
 
 
 namespace
 {
-	struct Bounds
-	{
-		float top;
-		float left;
-		float bottom;
-		float right;
-	};
-
-	struct Building
-	{
-		float height;
-		std::vector<glm::fvec2> outline;
-	};
-
-
-	std::string name;
-	std::string dataset;
-
-	Bounds bounds;
-	glm::ivec2 size;
-	double cell_size;
-	glm::fmat4 center_matrix;
-
-	std::vector<std::vector<float>> terrain_data;
-	std::vector<Building> buildings_data;
-	LV::Mesh terrain_mesh;
-	LV::Mesh buildings_mesh;
-	LV::Mesh base_mesh;
-
-
-	Bounds get_compensated_bounds(const Bounds& bounds)
-	{
-		Bounds compensated_bounds{bounds};
-
-		float average_latitude{std::abs(bounds.bottom+bounds.top)/2.f};
-		float compensation_factor{glm::sec(glm::radians(average_latitude))};
-		float distance{glm::distance(bounds.left, bounds.right)};
-		float compensation{(distance-distance/compensation_factor)/2.f};
-
-		compensated_bounds.left += compensation;
-		compensated_bounds.right -= compensation;
-
-		return compensated_bounds;
-	}
-
-
-	void add_vertex(LV::Mesh* mesh, const glm::fvec3& vertex)
+	void add_vertex(LV::Mesh* mesh, const glm::fmat4& center_matrix, const glm::fvec3& vertex)
 	{ mesh->vertices.emplace_back(center_matrix*glm::fvec4{vertex, 1.f}); }
 
 
@@ -88,149 +56,185 @@ namespace
 		indicies->emplace_back(top_left);
 	}
 
-	void retrieve_terrain_data(const std::string& api_key)
-	{
-		std::cout<<"Retrieving the topography data...\n";
-
-		// Validate the dataset.
-		
-		const std::set<std::string>::iterator usgs_iterator{LV::Constants::supported_usgs_datasets.find(dataset)};
-		const std::set<std::string>::iterator global_iterator{LV::Constants::supported_global_datasets.find(dataset)};
-		const bool is_usgs{usgs_iterator != LV::Constants::supported_usgs_datasets.end()};
-		const bool is_global{global_iterator != LV::Constants::supported_global_datasets.end()};
-		if(!is_usgs && !is_global) throw std::runtime_error{"Unrecognized dataset."};
-		const std::string matched_dataset{is_usgs ? *usgs_iterator : *global_iterator};
 
-		// Make the request (OpenTopography API).
-		std::stringstream coordinates;
-		coordinates<<"&south="<<bounds.bottom<<"&north="<<bounds.top
-			<<"&west="<<bounds.left<<"&east="<<bounds.right;
+	// Records when each stage of a generation ran, so that the critical path is visible.
+	struct Stage_timings
+	{
+		struct Stage
+		{
+			std::string name;
+			double start; // Seconds since the generation started.
+			double duration;
+		};
 
-		std::string request{"https://portal.opentopography.org/API/"+std::string(is_usgs ? "usgsdem" : "globaldem")+
-			std::string(is_usgs ? "?datasetName=" : "?demtype=")+matched_dataset+coordinates.str()+
-			"&outputFormat=AAIGrid&API_Key="+api_key};
-		std::string response{LV::Request::request(request)};
-		std::stringstream response_stream{response};
+		const std::chrono::steady_clock::time_point start{std::chrono::steady_clock::now()};
+		std::mutex mutex;
+		std::vector<Stage> stages;
+	};
 
-		if(response.find("Error") != std::string::npos) throw std::runtime_error{
-			"Failed to retrieve the topography data. Response: \""+response+"\"."};
 
-		// Parse Arc ASCII dataset header.
-		std::cout<<"Parsing the topography data...\n";
-		const std::set<std::string> header_keys{"ncols", "nrows", "xllcorner", "yllcorner", "cellsize", "NODATA_value"};
-		std::string line;
-		bool is_header{true};
+	// Records the stage's timing when destroyed, traces it as a span, and attributes
+	// the memory allocated meanwhile to it. The timings may be null.
+	class Stage_timer
+	{
+	public:
+		Stage_timer(Stage_timings* timings, const char* name) :
+			timings{timings}, name{name}, span{name}, memory{name} {}
 
-		while(is_header)
+		~Stage_timer()
 		{
-			std::getline(response_stream, line);
-
-			is_header = false;
-			for(const std::string& key : header_keys)
-				if(line.find(key) != std::string::npos)
-				{
-					size_t last_space{line.find_last_of(" ")};
-					std::string value{line.substr(last_space+1)};
+			if(!timings) return;
+			const auto seconds{[&](std::chrono::steady_clock::time_point time)
+			{ return std::chrono::duration<double>(time-timings->start).count(); }};
+
+			const double end{seconds(std::chrono::steady_clock::now())};
+			const LV::Memory::Unbudgeted unbudgeted;
+			const std::lock_guard lock{timings->mutex};
+			timings->stages.push_back({name, seconds(start), end-seconds(start)});
+		}
 
-					if(key == "ncols") size.x = stof(value);
-					else if(key == "nrows") size.y = stof(value);
-					else if(key == "cellsize") cell_size = stod(value);
+		Stage_timer(const Stage_timer&) = delete;
+		Stage_timer& operator=(const Stage_timer&) = delete;
 
-					is_header = true;
-					break;
-				}
-		}
+	private:
+		Stage_timings* timings;
+		const char* name;
+		const LV::Trace::Span span;
+		const LV::Memory::Scope memory;
+		const std::chrono::steady_clock::time_point start{std::chrono::steady_clock::now()};
+	};
 
-		// Convert header data.
-		cell_size = 0.0003/cell_size;
-		size.y -= 1; // The last row of AW3D30 can be incorrect, so ignore it.
 
-		// Parse the grid.
-		terrain_data.clear();
+	void print_stage_timings(Stage_timings* timings)
+	{
+		std::sort(timings->stages.begin(), timings->stages.end(), [](
+			const Stage_timings::Stage& a, const Stage_timings::Stage& b){ return a.start < b.start; });
+
+		// Format locally, since generations may run concurrently.
+		std::ostringstream report;
+		report<<"Stage timings (seconds since the start):\n"<<std::fixed<<std::setprecision(3);
+		for(const Stage_timings::Stage& stage : timings->stages)
+			report<<"  "<<std::left<<std::setw(24)<<stage.name<<std::right<<std::setw(9)<<
+				stage.start<<" to "<<std::setw(9)<<stage.start+stage.duration<<" ("<<
+				stage.duration<<")\n";
+
+		LV::Utilities::print(report.str());
+	}
 
-		for(int z{}; z < size.y; ++z)
-		{
-			terrain_data.emplace_back();
-			std::vector<std::string> tokens;
-			boost::split(tokens, line, boost::is_any_of(" "));
-			tokens.erase(tokens.begin());
 
-			for(const std::string& token : tokens)
-			{
-				const double value{std::stof(token)};
-				float elevation;
+	LV::Dem::Grid retrieve_terrain_data(const LV::Frustum::Data& data,
+		const std::string& api_key, Stage_timings* timings)
+	{
+		const Stage_timer timer{timings, "Terrain retrieval"};
+		LV::Utilities::print("Retrieving the topography data...\n");
+		return LV::Dem::retrieve(data.dataset, data.bounds, api_key);
+	}
 
-				if(value <= -9999) elevation = terrain_data.back().back();
-				else elevation = (value*cell_size)/LV::Constants::meters_per_frustum_base_unit;
 
-				terrain_data.back().emplace_back(elevation);
-			}
+	void convert_terrain_data(LV::Frustum::Data* data,
+		LV::Dem::Grid grid, Stage_timings* timings)
+	{
+		const Stage_timer timer{timings, "Terrain conversion"};
 
-			if(terrain_data.back().size() != size.x)
-				throw std::runtime_error{"Failed to parse the topography data."};
+		// Convert the elevations to Frustum units.
+		data->size = grid.size;
+		data->cell_size = 0.0003/grid.cell_size;
+		data->terrain.assign(grid.size.y, std::vector<float>(grid.size.x));
 
-			std::getline(response_stream, line);
-		}
+		LV::Utilities::parallel_for(grid.size.y, [&](size_t z)
+		{
+			std::vector<float>& row{data->terrain[z]};
+			for(int x{}; x < grid.size.x; ++x)
+			{
+				const float value{grid.elevations[z*grid.size.x+x]};
 
-		if(terrain_data.size() != size.y)
-			throw std::runtime_error{"Failed to parse the topography data."};
+				// Fill missing values from the previous point.
+				if(std::isnan(value)) row[x] = (x > 0) ? row[x-1] : 0.f;
+				else row[x] = static_cast<float>((value*data->cell_size)/
+					LV::Constants::meters_per_frustum_base_unit);
+			}
+		});
 	}
 
 
-	void generate_terrain_mesh()
+	// Generates the vertices and normals of the rows from the first up to the end, and
+	// the triangles between them, into the empty mesh, indexed from the first row. The
+	// height function takes the column and row, and is also called for the rows on either
+	// side. Each row's data has a fixed place in the mesh, so the rows are generated in
+	// parallel and the height function must be safe to call concurrently.
+	template<typename Height_function>
+	void generate_terrain_rows(const Height_function& height, const glm::ivec2& size,
+		int first_row, int end_row, const glm::fmat4& center_matrix, LV::Mesh* terrain_mesh)
 	{
-		std::cout<<"Generating the terrain mesh...\n";
+		const size_t row_vertices{static_cast<size_t>(size.x)*2};
+		const size_t row_indices{static_cast<size_t>(size.x-1)*6};
+		terrain_mesh->vertices.resize(row_vertices*(end_row-first_row));
+		terrain_mesh->indices.resize(row_indices*std::max(end_row-first_row-1, 0));
 
-		terrain_mesh.vertices.clear();
-		terrain_mesh.indices.clear();
-
-		// For each row of the grid...
-		for(int z{}; z < size.y; ++z)
+		// For each row...
+		LV::Utilities::parallel_for(end_row-first_row, [&](size_t row)
 		{
+			const int z{first_row+static_cast<int>(row)};
+			glm::fvec3* vertex{terrain_mesh->vertices.data()+row*row_vertices};
+			unsigned* index{terrain_mesh->indices.data()+row*row_indices};
+
 			// For each column in the row...
 			for(int x{}; x < size.x; ++x)
 			{
 				// Generate the vertex.
-				add_vertex(&terrain_mesh, glm::fvec3{x, terrain_data[z][x], z});
+				*vertex++ = glm::fvec3{center_matrix*glm::fvec4{x, height(x, z), z, 1.f}};
 
 				// Generate the normal.
-				float adjacent_left_height{terrain_data[z][(x > 0) ? x-1 : 0]};
-				float adjacent_right_height{terrain_data[z][(x < size.x-1) ? x+1 : x]};
-				float adjacent_top_height{terrain_data[(z > 0) ? z-1 : 0][x]};
-				float adjacent_bottom_height{terrain_data[(z < size.y-1) ? z+1 : z][x]};
+				float adjacent_left_height{height((x > 0) ? x-1 : 0, z)};
+				float adjacent_right_height{height((x < size.x-1) ? x+1 : x, z)};
+				float adjacent_top_height{height(x, (z > 0) ? z-1 : 0)};
+				float adjacent_bottom_height{height(x, (z < size.y-1) ? z+1 : z)};
 
 				const glm::fvec3 normal{
 					adjacent_left_height-adjacent_right_height,
 					LV::Constants::terrain_normal_smoothing,
 					adjacent_top_height-adjacent_bottom_height};
 
-				terrain_mesh.vertices.emplace_back(glm::normalize(normal));
+				*vertex++ = glm::normalize(normal);
 
-				// Generate the indices.
-				if(z >= size.y-1 || x >= size.x-1) continue;
+				// Generate the indices, in the same order as generate_square_indicies.
+				if(z >= end_row-1 || x >= size.x-1) continue;
 
-				const unsigned top_left{static_cast<unsigned>(z*size.x+x)};
+				const unsigned top_left{static_cast<unsigned>(row*size.x+x)};
 				const unsigned	bottom_left{static_cast<unsigned>(top_left+size.x)};
 				const unsigned	bottom_right{bottom_left+1};
 				const unsigned	top_right{top_left+1};
 
-				generate_square_indicies(&terrain_mesh.indices,
-					top_left, bottom_left, bottom_right, top_right);
+				for(const unsigned corner : {top_left, bottom_left,
+					bottom_right, bottom_right, top_right, top_left}) *index++ = corner;
 			}
-		}
+		});
+	}
+
+
+	void generate_terrain_mesh(const LV::Frustum::Data& data,
+		const glm::fmat4& center_matrix, LV::Mesh* terrain_mesh)
+	{
+		const LV::Trace::Span span{"Terrain mesh"};
+		const LV::Memory::Scope memory{"Terrain mesh"};
+
+		LV::Utilities::print("Generating the terrain mesh...\n");
+		const std::vector<std::vector<float>>& terrain_data{data.terrain};
+
+		generate_terrain_rows([&](int x, int z){ return terrain_data[z][x]; },
+			data.size, 0, data.size.y, center_matrix, terrain_mesh);
 	}
 
 
-	bool get_building_outline(Building* building,
-		const nlohmann::json& json, const glm::fvec2 scale_factor)
+	bool get_building_outline(LV::Building* building, const LV::Frustum::Data& data,
+		const std::vector<glm::dvec2>& geometry, const glm::dvec2 scale_factor)
 	{
-		const nlohmann::json::const_iterator geometry{json.find("geometry")};
-		if(geometry == json.end()) return false;
+		const LV::Bounds& bounds{data.bounds};
+		const glm::ivec2& size{data.size};
 
-		for(const nlohmann::json& point : geometry.value())
+		for(const glm::dvec2& coordinate : geometry)
 		{
-			const glm::fvec2 coordinate{glm::fvec2{point["lon"], point["lat"]}};
-			const glm::fvec2 relative_coordinate{
+			const glm::dvec2 relative_coordinate{
 				coordinate.x-bounds.left, bounds.top-coordinate.y};
 			const glm::fvec2 result{relative_coordinate*scale_factor};
 
@@ -244,10 +248,14 @@ namespace
 	}
 
 
-	void retrieve_buildings_data()
+	std::vector<LV::Osm::Building> retrieve_overpass_buildings(const LV::Bounds& bounds)
 	{
+		const LV::Trace::Span span{"Overpass retrieval"};
+		const LV::Memory::Scope memory{"Overpass retrieval"};
+
 		// Make the request (OpenStreetMap Overpass API).
-		std::cout<<"Retrieving the building data...\n";
+		LV::Utilities::print("Retrieving the building data...\n");
+
 		std::stringstream coordinates;
 		coordinates<<bounds.bottom<<','<<bounds.left
 			<<','<<bounds.top<<','<<bounds.right;
@@ -265,92 +273,214 @@ namespace
 		};
 
 		const std::string response{LV::Request::request(
-			"https://lz4.overpass-api.de/api/interpreter", payload)};
+			"https://"+LV::Constants::overpass_host+"/api/interpreter", payload)};
 
 		if(response.find("<?xml") != std::string::npos)
 			throw std::runtime_error{"Failed to retrieve the building data."};
 
 		// Parse the response data.
-		std::cout<<"Parsing the building data...\n";
+		LV::Utilities::print("Parsing the building data...\n");
+		return LV::Osm::parse_overpass(response);
+	}
+
 
-		glm::fvec2 scale_factor{size.x/glm::distance(bounds.left, bounds.right),
-			size.y/glm::distance(bounds.top, bounds.bottom)};
+	// Reads the buildings from a local OpenStreetMap extract covering the bounds if there
+	// is one, otherwise from the Overpass API. Only needs the bounds, so it can run
+	// alongside the terrain's retrieval.
+	std::vector<LV::Osm::Building> retrieve_buildings_data(
+		const LV::Bounds& bounds, Stage_timings* timings)
+	{
+		const Stage_timer timer{timings, "Building retrieval"};
+		const std::string extract{LV::Osm::find_extract(bounds)};
 
+		return extract.empty() ? retrieve_overpass_buildings(bounds) :
+			LV::Osm::read_buildings(extract, bounds);
+	}
+
+
+	// Converts the buildings to outlines on the terrain's grid.
+	void convert_buildings_data(LV::Frustum::Data* data,
+		const std::vector<LV::Osm::Building>& buildings, Stage_timings* timings)
+	{
+		const Stage_timer timer{timings, "Building conversion"};
+		const LV::Bounds& bounds{data->bounds};
+		const glm::ivec2& size{data->size};
+
+		const glm::dvec2 scale_factor{size.x/glm::distance<double>(bounds.left, bounds.right),
+			size.y/glm::distance<double>(bounds.top, bounds.bottom)};
+
+		std::vector<LV::Building>& buildings_data{data->buildings};
 		buildings_data.clear();
-		const nlohmann::json json{nlohmann::json::parse(response)};
 
 		// For each building...
-		for(const nlohmann::json& element : json["elements"])
+		for(const LV::Osm::Building& building : buildings)
 		{
 			try
 			{
-				Building building;
-				const nlohmann::json::const_iterator tags{element.find("tags")};
-				if(tags == element.end()) continue;
+				LV::Building result;
 
 				// Get the building's height.
-				const nlohmann::json::const_iterator height{tags.value().find("height")};
-				const nlohmann::json::const_iterator levels{
-					tags.value().find("building:levels")};
+				if(!building.height.empty()) result.height = std::stof(building.height);
 
-				if(height != tags.value().end())
-					building.height = std::stof(height.value().get<std::string>());
+				else if(!building.levels.empty()) result.height =
+					LV::Constants::building_level_height*std::stof(building.levels);
 
-				else if(levels != tags.value().end())
-					building.height = LV::Constants::building_level_height*
-						std::stof(levels.value().get<std::string>());
+				else result.height = LV::Constants::default_building_height;
 
-				else building.height = LV::Constants::default_building_height;
+				result.height /= LV::Constants::meters_per_frustum_base_unit;
 
-				building.height /= LV::Constants::meters_per_frustum_base_unit;
+				// Get the outline and add the parsed building to the vector.
+				if(!get_building_outline(&result, *data, building.geometry, scale_factor)) continue;
+				buildings_data.emplace_back(result);
+			}
+			catch(...){ continue; }
+		}
+	}
 
-				// Get the geometry of "way" buildings.
-				const nlohmann::json::const_iterator type{element.find("type")};
-				if(type == element.end()) continue;
 
-				if(type.value() == "way")
-				{
-					if(!get_building_outline(&building, element, scale_factor)) continue;
-				}
+	struct Tap
+	{
+		int index;
+		float weight;
+	};
+
+
+	// Returns the source points and weights of each resampled point along an axis, with
+	// the first points aligned. Shrinking averages the area around each point, while
+	// enlarging interpolates between the nearest two.
+	std::vector<std::vector<Tap>> get_taps(int source_size, int size)
+	{
+		const double scale{static_cast<double>(source_size)/size};
+		std::vector<std::vector<Tap>> taps(size);
 
-				// Get the geometry of "relation" buildings.
-				else if(type.value() == "relation")
+		for(int index{}; index < size; ++index)
+		{
+			const double position{index*scale};
+			std::vector<Tap>& point_taps{taps[index]};
+
+			if(scale > 1.)
+			{
+				// Each source point covers half a cell on either side.
+				const double start{std::max(position-scale/2., -.5)};
+				const double end{std::min(position+scale/2., source_size-.5)};
+				float total{};
+
+				for(int source{static_cast<int>(std::floor(start+.5))}; source-.5 < end; ++source)
 				{
-					const nlohmann::json::const_iterator members{element.find("members")};
-					if(members == element.end()) continue;
+					const float weight{static_cast<float>(
+						std::min(end, source+.5)-std::max(start, source-.5))};
 
-					if(!get_building_outline(&building,
-						members.value().begin().value(), scale_factor)) continue;
+					if(weight <= 0.f) continue;
+					point_taps.emplace_back(Tap{source, weight});
+					total += weight;
 				}
 
-				else continue;
+				for(Tap& tap : point_taps) tap.weight /= total;
+			}
+
+			else if(source_size < 2) point_taps = {Tap{0, 1.f}};
 
-				// Add the parsed building to the vector.
-				buildings_data.emplace_back(building);
+			else
+			{
+				const double clamped_position{std::min(position, source_size-1.)};
+				const int source{std::min(static_cast<int>(clamped_position), source_size-2)};
+				const float weight{static_cast<float>(clamped_position-source)};
+				point_taps = {Tap{source, 1.f-weight}, Tap{source+1, weight}};
 			}
-			catch(...){ continue; }
 		}
+
+		return taps;
 	}
 
 
-	void generate_buildings_mesh()
+	// Resamples the terrain to the requested resolution, scaling the heights and the
+	// buildings to match so that they keep their size relative to the cells.
+	void resample(LV::Frustum::Data* data, const LV::Frustum::Save_options& options,
+		Stage_timings* timings = nullptr)
 	{
-		std::cout<<"Generating the buildings mesh...\n";
-		buildings_mesh.vertices.clear();
-		buildings_mesh.indices.clear();
+		const glm::ivec2 size{LV::Frustum::get_resampled_size(*data, options)};
+		if(size == data->size) return;
+
+		const Stage_timer timer{timings, "Resampling"};
+		LV::Utilities::print("Resampling the terrain from "+std::to_string(data->size.x)+'x'+
+			std::to_string(data->size.y)+" to "+std::to_string(size.x)+'x'+
+			std::to_string(size.y)+" points...\n");
+
+		const std::vector<std::vector<Tap>> column_taps{get_taps(data->size.x, size.x)};
+		const std::vector<std::vector<Tap>> row_taps{get_taps(data->size.y, size.y)};
+		const glm::dvec2 scale{glm::dvec2{size}/glm::dvec2{data->size}};
+		const float height_scale{static_cast<float>(scale.x)};
+
+		// Resample each row, then combine whole rows so that the inner loop vectorizes.
+		std::vector<std::vector<float>> rows(data->size.y, std::vector<float>(size.x));
+		LV::Utilities::parallel_for(rows.size(), [&](size_t z)
+		{
+			const std::vector<float>& source{data->terrain[z]};
+
+			for(int x{}; x < size.x; ++x)
+			{
+				float value{};
+				for(const Tap& tap : column_taps[x]) value += source[tap.index]*tap.weight;
+				rows[z][x] = value*height_scale;
+			}
+		});
+
+		std::vector<std::vector<float>> terrain(size.y, std::vector<float>(size.x));
+		LV::Utilities::parallel_for(terrain.size(), [&](size_t z)
+		{
+			float* const row{terrain[z].data()};
+
+			for(const Tap& tap : row_taps[z])
+			{
+				const float* const source{rows[tap.index].data()};
+				for(int x{}; x < size.x; ++x) row[x] += source[x]*tap.weight;
+			}
+		});
+
+		data->terrain = std::move(terrain);
+		data->size = size;
+		data->cell_size *= scale.x;
+
+		// Scale the buildings, dropping those which no longer fit.
+		std::vector<LV::Building> buildings;
+		for(LV::Building& building : data->buildings)
+		{
+			bool fits{true};
+			for(glm::fvec2& point : building.outline)
+			{
+				point *= glm::fvec2{scale};
+				fits = fits && point.x < size.x-1 && point.y < size.y-1;
+			}
+
+			building.height *= height_scale;
+			if(fits) buildings.emplace_back(std::move(building));
+		}
+
+		data->buildings = std::move(buildings);
+	}
+
+
+	// The height function takes the column and row of each building's first point.
+	template<typename Height_function>
+	void generate_buildings_mesh(const LV::Frustum::Data& data, const Height_function& height,
+		const glm::fmat4& center_matrix, LV::Mesh* buildings_mesh)
+	{
+		const LV::Trace::Span span{"Buildings mesh"};
+		const LV::Memory::Scope memory{"Buildings mesh"};
+
+		LV::Utilities::print("Generating the buildings mesh...\n");
 
 		// For each building...
 		unsigned wall_index_base{1};
-		for(const Building& building : buildings_data)
+		for(const LV::Building& building : data.buildings)
 		{
 			// Get the base height.
 			const glm::ivec2 location{building.outline[0]};
 
-			if(location.x >= terrain_data[0].size() ||
-				location.y >= terrain_data.size() ||
+			if(location.x >= data.size.x || location.y >= data.size.y ||
 				location.x < 0 || location.y < 0) continue;
 
-			const float base_height{terrain_data[location.y][location.x]};
+			const float base_height{height(location.x, location.y)};
 
 			// Generate the walls.
 			unsigned roof_index_base{wall_index_base-1};
@@ -359,17 +489,17 @@ namespace
 				// Generate the vertices (top and bottom).
 				const glm::fvec2 point{building.outline[index]};
 
-				add_vertex(&buildings_mesh, glm::fvec3{point.x,
+				add_vertex(buildings_mesh, center_matrix, glm::fvec3{point.x,
 					base_height+building.height, point.y});
 
-				add_vertex(&buildings_mesh, glm::fvec3{point.x,
+				add_vertex(buildings_mesh, center_matrix, glm::fvec3{point.x,
 					base_height-LV::Constants::building_depth/
 					LV::Constants::meters_per_frustum_base_unit, point.y});
 
 				// Generate the indicies.
 				if(index >= building.outline.size()-1) continue;
 
-				generate_square_indicies(&buildings_mesh.indices, wall_index_base-1,
+				generate_square_indicies(&buildings_mesh->indices, wall_index_base-1,
 					wall_index_base, wall_index_base+2, wall_index_base+1);
 
 				wall_index_base += 2;
@@ -384,12 +514,14 @@ namespace
 
 			std::vector<unsigned> roof_indices{mapbox::earcut<unsigned>(earclip_data)};
 			for(unsigned roof_index : roof_indices)
-				buildings_mesh.indices.emplace_back(roof_index_base+roof_index*2);
+				buildings_mesh->indices.emplace_back(roof_index_base+roof_index*2);
 		}
 	}
 
 
-	void generate_side_mesh(bool iterate_x, bool extreme)
+	template<typename Height_function>
+	void generate_side_mesh(const glm::ivec2& size, const Height_function& height,
+		const glm::fmat4& center_matrix, LV::Mesh* base_mesh, bool iterate_x, bool extreme)
 	{
 		const int max{iterate_x ? size.x : size.y};
 		const int static_value{extreme ? iterate_x ? size.y-1 : size.x-1 : 0};
@@ -400,69 +532,65 @@ namespace
 			if(iterate_x) x = index; else z = index;
 
 			// Generate the verticies (top and bottom).
-			add_vertex(&base_mesh, glm::fvec3{x, terrain_data[z][x], z});
-			add_vertex(&base_mesh, glm::fvec3{x, LV::Constants::bottom, z});
+			add_vertex(base_mesh, center_matrix, glm::fvec3{x, height(x, z), z});
+			add_vertex(base_mesh, center_matrix, glm::fvec3{x, LV::Constants::bottom, z});
 
 			// Generate the indicies.
 			if(index >= max-1) continue;
 
-			const unsigned base_index{static_cast<unsigned>(base_mesh.vertices.size()-2)};
+			const unsigned base_index{static_cast<unsigned>(base_mesh->vertices.size()-2)};
 			const bool couterclockwise{iterate_x ? extreme : !extreme};
 
-			if(couterclockwise) generate_square_indicies(&base_mesh.indices,
+			if(couterclockwise) generate_square_indicies(&base_mesh->indices,
 				base_index, base_index+1, base_index+3, base_index+2);
 
-			else generate_square_indicies(&base_mesh.indices,
+			else generate_square_indicies(&base_mesh->indices,
 				base_index+2, base_index+3, base_index+1, base_index);
 		}
 	}
 
 
-	void generate_bottom_mesh()
+	void generate_bottom_mesh(const glm::ivec2& size,
+		const glm::fmat4& center_matrix, LV::Mesh* base_mesh)
 	{
-		const unsigned base_index{static_cast<unsigned>(base_mesh.vertices.size())};
+		const unsigned base_index{static_cast<unsigned>(base_mesh->vertices.size())};
 
 		// Generate the vertices (top-left, bottom-left, bottom-right, top-right).
-		add_vertex(&base_mesh, glm::fvec3{0.f, LV::Constants::bottom, size.y-1});
-		add_vertex(&base_mesh, glm::fvec3{size.x-1, LV::Constants::bottom, size.y-1});
-		add_vertex(&base_mesh, glm::fvec3{0.f, LV::Constants::bottom, 0.f});
-		add_vertex(&base_mesh, glm::fvec3{size.x-1, LV::Constants::bottom, 0.f});
+		add_vertex(base_mesh, center_matrix, glm::fvec3{0.f, LV::Constants::bottom, size.y-1});
+		add_vertex(base_mesh, center_matrix, glm::fvec3{size.x-1, LV::Constants::bottom, size.y-1});
+		add_vertex(base_mesh, center_matrix, glm::fvec3{0.f, LV::Constants::bottom, 0.f});
+		add_vertex(base_mesh, center_matrix, glm::fvec3{size.x-1, LV::Constants::bottom, 0.f});
 
 		// Generate the indicies.
-		generate_square_indicies(&base_mesh.indices,
+		generate_square_indicies(&base_mesh->indices,
 			base_index, base_index+2, base_index+3, base_index+1);
 	}
 
 
-	void generate_base_mesh()
+	// The height function is only called for points along the edges.
+	template<typename Height_function>
+	void generate_base_mesh(const glm::ivec2& size, const Height_function& height,
+		const glm::fmat4& center_matrix, LV::Mesh* base_mesh)
 	{
-		base_mesh.vertices.clear();
-		base_mesh.indices.clear();
+		const LV::Trace::Span span{"Base mesh"};
+		const LV::Memory::Scope memory{"Base mesh"};
 
 		// Generate a mesh for each side.
-		generate_side_mesh(true, false);
-		generate_side_mesh(true, true);
-		generate_side_mesh(false, false);
-		generate_side_mesh(false, true);
+		generate_side_mesh(size, height, center_matrix, base_mesh, true, false);
+		generate_side_mesh(size, height, center_matrix, base_mesh, true, true);
+		generate_side_mesh(size, height, center_matrix, base_mesh, false, false);
+		generate_side_mesh(size, height, center_matrix, base_mesh, false, true);
 
 		// Generate a mesh for the bottom.
-		generate_bottom_mesh();
+		generate_bottom_mesh(size, center_matrix, base_mesh);
 	}
 
 
-	void generate_meshes()
+	void save_compressed(const std::string& file_path, const std::string& data,
+		LV::Utilities::Compression_profile profile, const std::string& dictionary)
 	{
-		center_matrix = glm::translate(glm::fvec3{-size.x/2.f, 0.f, -size.y/2.f});
-
-		generate_terrain_mesh();
-		generate_buildings_mesh();
-		generate_base_mesh();
-	}
-
-
-	void save_compressed(const std::string& file_path, const std::string& data)
-	{
-		std::vector<uint8_t> compressed_data{LV::Utilities::compress(data)};
+		std::vector<uint8_t> compressed_data{
+			LV::Utilities::compress(data, profile, dictionary)};
 
 		std::ofstream file{file_path, std::ios::binary};
 		if(!file) throw std::runtime_error{"Failed to save the Frustum."};
@@ -474,55 +602,252 @@ namespace
 
 	std::string load_compressed(const std::string& file_path)
 	{
-		std::ifstream file{file_path, std::ios::binary};
-		if(!file) throw std::runtime_error{"Failed to load the Frustum."};
+		if(!std::filesystem::exists(file_path))
+			throw std::runtime_error{"Failed to load the Frustum."};
 
-		std::vector<uint8_t> compressed_data{
-			std::istreambuf_iterator<char>(file),
-			std::istreambuf_iterator<char>()};
+		return LV::Utilities::decompress_file(file_path);
+	}
+
+
+	// Calls the function with each line of the text, without copying it.
+	void for_each_line(std::string_view text,
+		const std::function<void(std::string_view line)>& function)
+	{
+		while(!text.empty())
+		{
+			const size_t end{std::min(text.find('\n'), text.size())};
+			function(text.substr(0, end));
+			text.remove_prefix(std::min(end+1, text.size()));
+		}
+	}
+
+
+	// Parses the next space-separated number from the start of the text.
+	template<typename T>
+	bool parse_number(std::string_view* text, T* value)
+	{
+		const size_t start{text->find_first_not_of(' ')};
+		if(start == std::string_view::npos) return false;
+
+		const char* const end{text->data()+text->size()};
+		const std::from_chars_result result{std::from_chars(text->data()+start, end, *value)};
+		if(result.ec != std::errc{}) return false;
 
-		return LV::Utilities::decompress(compressed_data);
+		text->remove_prefix(result.ptr-text->data());
+		return true;
 	}
 
 
-	void save()
+	// Compresses and writes the terrain and buildings concurrently.
+	void save(const LV::Frustum::Data& data, const LV::Frustum::Save_options& options,
+		Stage_timings* timings = nullptr)
 	{
-		std::cout<<"Saving the generated Frustum...\n";
-		const std::string directory{LV::Constants::frustum_directory_name+"/"+name+"/"};
+		const LV::Trace::Span span{"Saving"};
+
+		LV::Utilities::print("Saving the generated Frustum...\n");
+		const LV::Bounds& bounds{data.bounds};
+		const std::string directory{LV::Constants::frustum_directory_name+"/"+data.name+"/"};
 		std::filesystem::create_directories(directory);
 
+		// Save the terrain data.
+		std::future<void> terrain{std::async(std::launch::async, [&]
+		{
+			const Stage_timer timer{timings, "Terrain compression"};
+			LV::Codec::save_tiled_terrain(directory+LV::Constants::terrain_file_name,
+				data.terrain, options.precision, options.profile);
+		})};
+
+		// Save the buildings data.
+		std::future<void> buildings{std::async(std::launch::async, [&]
+		{
+			const Stage_timer timer{timings, "Building compression"};
+			std::stringstream buildings_save_data;
+
+			for(const LV::Building& building : data.buildings)
+			{
+				buildings_save_data<<std::defaultfloat<<building.height<<' ';
+
+				for(const glm::fvec2& point : building.outline) buildings_save_data
+					<<std::fixed<<std::setprecision(3)<<point.x<<' '<<point.y<<' ';
+
+				buildings_save_data<<'\n';
+			}
+
+			save_compressed(directory+LV::Constants::buildings_file_name,
+				std::move(buildings_save_data).str(), options.profile,
+				LV::Constants::buildings_dictionary_name);
+		})};
+
 		// Save the metadata.
 		std::ofstream metadata_file{directory+LV::Constants::metadata_file_name};
-		metadata_file<<name<<'\n'<<dataset<<'\n'<<std::fixed<<std::setprecision(6)<<
-			bounds.top<<' '<<bounds.left<<' '<<bounds.bottom<<' '<<bounds.right;
+		metadata_file<<data.name<<'\n'<<data.dataset<<'\n'<<std::fixed<<std::setprecision(6)<<
+			bounds.top<<' '<<bounds.left<<' '<<bounds.bottom<<' '<<bounds.right<<
+			'\n'<<std::setprecision(9)<<data.cell_size;
 
-		// Save the terrain data.
-		std::stringstream terrain_save_data;
-		for(const std::vector<float>& row : terrain_data)
+		terrain.get();
+		buildings.get();
+	}
+
+
+	// Copies the bounds and buildings of the region.
+	LV::Frustum::Data get_region_without_terrain(const LV::Frustum::Data& data,
+		const glm::ivec2& start, const glm::ivec2& size)
+	{
+		if(start.x < 0 || start.y < 0 || size.x < 2 || size.y < 2 ||
+			start.x+size.x > data.size.x || start.y+size.y > data.size.y)
+			throw std::runtime_error{"The region is outside of the Frustum."};
+
+		LV::Frustum::Data region;
+		region.name = data.name;
+		region.dataset = data.dataset;
+		region.size = size;
+		region.cell_size = data.cell_size;
+
+		// Calculate the bounds.
+		const glm::fvec2 degrees_per_cell{glm::distance(data.bounds.left, data.bounds.right)/
+			data.size.x, glm::distance(data.bounds.top, data.bounds.bottom)/data.size.y};
+
+		region.bounds.left = data.bounds.left+start.x*degrees_per_cell.x;
+		region.bounds.right = region.bounds.left+size.x*degrees_per_cell.x;
+		region.bounds.top = data.bounds.top-start.y*degrees_per_cell.y;
+		region.bounds.bottom = region.bounds.top-size.y*degrees_per_cell.y;
+
+		// Copy the buildings whose first point lies in the region's cells.
+		const glm::fvec2 offset{start};
+		for(const LV::Building& building : data.buildings)
 		{
-			for(float point : row)
-				terrain_save_data<<std::fixed<<std::setprecision(3)<<point<<' ';
+			const glm::fvec2 location{building.outline[0]-offset};
+			if(location.x < 0.f || location.y < 0.f ||
+				location.x >= size.x-1 || location.y >= size.y-1) continue;
 
-			terrain_save_data<<'\n';
+			LV::Building& region_building{region.buildings.emplace_back(building)};
+			for(glm::fvec2& point : region_building.outline) point -= offset;
 		}
 
-		save_compressed(directory+LV::Constants::terrain_file_name,
-			terrain_save_data.str());
+		return region;
+	}
 
-		// Save the buildings data.
-		std::stringstream buildings_save_data;
-		for(const Building& building : buildings_data)
+
+	std::string get_directory(const std::string& name)
+	{ return LV::Constants::frustum_directory_name+"/"+name+"/"; }
+
+
+	// Loads the metadata and the terrain size. Older Frustums store the terrain as a
+	// single compressed stream, in which case the whole terrain is loaded as well.
+	LV::Frustum::Data load_metadata(const std::string& name)
+	{
+		const LV::Trace::Span span{"Metadata loading"};
+		const LV::Memory::Scope memory{"Metadata loading"};
+
+		LV::Frustum::Data data;
+		data.name = name;
+		const std::string directory{get_directory(name)};
+
+		std::ifstream metadata_file{directory+LV::Constants::metadata_file_name};
+		if(!metadata_file) throw std::runtime_error{"Failed to load the Frustum."};
+		metadata_file>>data.name>>data.dataset>>data.bounds.top>>
+			data.bounds.left>>data.bounds.bottom>>data.bounds.right;
+		if(!(metadata_file>>data.cell_size)) data.cell_size = 0.;
+
+		// Read the terrain size.
+		const std::string terrain_path{directory+LV::Constants::terrain_file_name};
+		if(LV::Codec::is_tiled_terrain(terrain_path))
+			data.size = LV::Codec::get_tiled_terrain_size(terrain_path);
+
+		else
 		{
-			buildings_save_data<<std::defaultfloat<<building.height<<' ';
+			const std::string terrain_save_data{load_compressed(terrain_path)};
 
-			for(const glm::fvec2& point : building.outline) buildings_save_data
-				<<std::fixed<<std::setprecision(3)<<point.x<<' '<<point.y<<' ';
+			if(LV::Codec::is_encoded_terrain(terrain_save_data))
+				data.terrain = LV::Codec::decode_terrain(terrain_save_data);
 
-			buildings_save_data<<'\n';
+			// The oldest Frustums stored the terrain as text.
+			else for_each_line(terrain_save_data, [&](std::string_view line)
+			{
+				data.terrain.emplace_back();
+
+				float point;
+				while(parse_number(&line, &point)) data.terrain.back().emplace_back(point);
+			});
+
+			if(data.terrain.empty() || data.terrain[0].empty())
+				throw std::runtime_error{"The terrain data is corrupt."};
+
+			data.size = {data.terrain[0].size(), data.terrain.size()};
 		}
 
-		save_compressed(directory+LV::Constants::buildings_file_name,
-			buildings_save_data.str());
+		// Older Frustums did not store the cell size, so derive it from the bounds
+		// (the grid had one more row than was kept).
+		if(data.cell_size <= 0.) data.cell_size = 0.0003/(glm::distance(
+			data.bounds.top, data.bounds.bottom)/(data.size.y+1));
+
+		return data;
+	}
+
+
+	void load_buildings(const std::string& name, LV::Frustum::Data* data)
+	{
+		const LV::Trace::Span span{"Buildings loading"};
+		const LV::Memory::Scope memory{"Buildings loading"};
+
+		for_each_line(load_compressed(get_directory(name)+LV::Constants::buildings_file_name),
+			[&](std::string_view line)
+		{
+			data->buildings.emplace_back();
+			parse_number(&line, &data->buildings.back().height);
+
+			glm::fvec2 point;
+			while(parse_number(&line, &point.x) && parse_number(&line, &point.y))
+				data->buildings.back().outline.emplace_back(point);
+		});
+	}
+
+
+	// Decompresses and parses the buildings on another thread.
+	std::future<std::vector<LV::Building>> load_buildings_async(const std::string& name)
+	{
+		return std::async(std::launch::async, [name]
+		{
+			LV::Frustum::Data data;
+			load_buildings(name, &data);
+			return std::move(data.buildings);
+		});
+	}
+
+
+	// Loads the whole terrain unless it has been loaded with the metadata.
+	void load_terrain(const std::string& name, LV::Frustum::Data* data)
+	{
+		const LV::Trace::Span span{"Terrain loading"};
+		const LV::Memory::Scope memory{"Terrain loading"};
+
+		if(data->terrain.empty()) data->terrain = LV::Codec::load_tiled_terrain(
+			get_directory(name)+LV::Constants::terrain_file_name, {0, 0}, data->size);
+	}
+
+
+	// Returns the decompressed terrain data, split into tiles when it is tiled.
+	std::vector<std::string> load_terrain_payloads(const std::string& path)
+	{
+		if(LV::Codec::is_tiled_terrain(path)) return LV::Codec::load_tile_payloads(path);
+		return {load_compressed(path)};
+	}
+
+
+	// Loads the buildings and the region of the terrain.
+	LV::Frustum::Data load_region_data(const std::string& name, LV::Frustum::Data data,
+		const glm::ivec2& start, const glm::ivec2& size)
+	{
+		load_buildings(name, &data);
+
+		// The terrain of older Frustums has already been loaded whole.
+		if(!data.terrain.empty()) return LV::Frustum::get_region(data, start, size);
+
+		LV::Frustum::Data region{get_region_without_terrain(data, start, size)};
+		region.terrain = LV::Codec::load_tiled_terrain(
+			get_directory(name)+LV::Constants::terrain_file_name, start, size);
+
+		return region;
 	}
 }
 
@@ -534,13 +859,8 @@ void validate_coordinate(const std::string& direction, float coordinate, float m
 }
 
 
-void LV::Frustum::generate(const std::string& name, const std::string& dataset,
-	float top, float left, float bottom, float right, const std::string& api_key)
+void LV::Frustum::validate_bounds(float top, float left, float bottom, float right)
 {
-	::name = name;
-	::dataset = dataset;
-
-	// Validate the coordinates.
 	validate_coordinate("top", top, 80.f);
 	validate_coordinate("bottom", bottom, 80.f);
 	validate_coordinate("left", left, 180.f);
@@ -551,74 +871,549 @@ void LV::Frustum::generate(const std::string& name, const std::string& dataset,
 
 	if(left > right) throw std::runtime_error{
 		"The left coordinate is father right than the right coordinate."};
+}
+
+
+LV::Bounds LV::Frustum::get_compensated_bounds(const Bounds& bounds)
+{
+	LV::Bounds compensated_bounds{bounds};
+
+	float average_latitude{std::abs(bounds.bottom+bounds.top)/2.f};
+	float compensation_factor{glm::sec(glm::radians(average_latitude))};
+	float distance{glm::distance(bounds.left, bounds.right)};
+	float compensation{(distance-distance/compensation_factor)/2.f};
+
+	compensated_bounds.left += compensation;
+	compensated_bounds.right -= compensation;
+
+	return compensated_bounds;
+}
+
+
+glm::ivec2 LV::Frustum::get_resampled_size(const Data& data, const Save_options& options)
+{
+	const glm::dvec2 size{data.size};
+
+	// Clamp to the source size, since enlarging would only interpolate.
+	if(options.resolution > 0.f)
+	{
+		const double meters_per_cell{LV::Constants::meters_per_frustum_base_unit/data.cell_size};
+		return glm::min(glm::max(glm::ivec2{glm::round(size*(meters_per_cell/
+			options.resolution))}, glm::ivec2{2}), data.size);
+	}
+
+	// Only shrink to fit the vertex budget.
+	const double vertices{size.x*size.y};
+	if(options.vertex_budget == 0 || options.vertex_budget >= vertices) return data.size;
+	return glm::max(glm::ivec2{glm::floor(size*std::sqrt(options.vertex_budget/vertices))},
+		glm::ivec2{2});
+}
+
+
+LV::Frustum::Save_options LV::Frustum::parse_save_options(
+	const std::map<std::string, std::string>& options)
+{
+	Save_options result;
+
+	for(const auto& [key, value] : options)
+	{
+		if(key == "profile") result.profile = LV::Utilities::parse_compression_profile(value);
+
+		else if(key == "precision")
+		{
+			result.precision = std::stof(value);
+			if(!(result.precision > 0.f)) throw std::runtime_error{
+				"'precision' must be positive."};
+		}
+
+		else if(key == "resolution")
+		{
+			const bool is_meters{value.ends_with('m')};
+			const double resolution{std::stod(is_meters ? value.substr(0, value.size()-1) : value)};
+			if(!(resolution > 0.)) throw std::runtime_error{"'resolution' must be positive."};
+
+			if(is_meters) result.resolution = static_cast<float>(resolution);
+			else result.vertex_budget = static_cast<uint64_t>(resolution);
+		}
+
+		else throw std::runtime_error{"Unrecognized option '"+key+"'."};
+	}
+
+	return result;
+}
+
+
+void LV::Frustum::generate(const std::string& name, const std::string& dataset,
+	float top, float left, float bottom, float right, const std::string& api_key,
+	const Save_options& options)
+{
+	LV::Frustum::Data data;
+	data.name = name;
+	data.dataset = dataset;
+	validate_bounds(top, left, bottom, right);
 
 	// Compensate for Mercator projection distortion.
-	bounds = get_compensated_bounds(Bounds{top, left, bottom, right});
+	data.bounds = get_compensated_bounds(LV::Bounds{top, left, bottom, right});
 
-	// Retrieve the data.
-	retrieve_terrain_data(api_key);
-	retrieve_buildings_data();
+	// Retrieve the buildings while the terrain is retrieved, since they only need the
+	// bounds until they are converted to the terrain's grid.
+	Stage_timings timings;
+	LV::Utilities::Output* const output{LV::Utilities::get_output()};
+
+	std::future<std::vector<LV::Osm::Building>> buildings{std::async(std::launch::async, [&]
+	{
+		const LV::Utilities::Output_scope output_scope{output};
+		return retrieve_buildings_data(data.bounds, &timings);
+	})};
+
+	std::future<void> terrain{std::async(std::launch::async, [&]
+	{
+		const LV::Utilities::Output_scope output_scope{output};
+		convert_terrain_data(&data, retrieve_terrain_data(data, api_key, &timings), &timings);
+	})};
+
+	terrain.get();
+	convert_buildings_data(&data, buildings.get(), &timings);
+	resample(&data, options, &timings);
 
 	// Save the Frustum data.
-	save();
-	std::cout<<"Frustum generation complete.\n";
+	::save(data, options, &timings);
+	LV::Utilities::print("Frustum generation complete.\n");
+	print_stage_timings(&timings);
 }
 
 
-void LV::Frustum::load(const std::string& name)
+LV::Frustum::Data LV::Frustum::load(const std::string& name)
 {
-	::name = name;
+	std::cout<<"Loading the Frustum...\n";
+	Data data{load_metadata(name)};
+
+	// Parse the buildings while the terrain is decompressed.
+	std::future<std::vector<Building>> buildings{load_buildings_async(name)};
+	load_terrain(name, &data);
+	data.buildings = buildings.get();
+	return data;
+}
+
 
+void LV::Frustum::load(const std::string& name, Data* data, Meshes* meshes)
+{
 	std::cout<<"Loading the Frustum...\n";
-	const std::string directory{LV::Constants::frustum_directory_name+"/"+name+"/"};
-	std::string line;
+	*data = load_metadata(name);
+	*meshes = {};
+
+	// Parse the buildings while the terrain is decompressed and meshed, since the
+	// buildings are only needed once their base heights are sampled.
+	std::future<std::vector<Building>> buildings{load_buildings_async(name)};
+	load_terrain(name, data);
+
+	const glm::fmat4 center_matrix{glm::translate(
+		glm::fvec3{-data->size.x/2.f, 0.f, -data->size.y/2.f})};
+
+	const auto height{[&](int x, int z){ return data->terrain[z][x]; }};
+
+	::generate_terrain_mesh(*data, center_matrix, &meshes->terrain);
+	generate_base_mesh(data->size, height, center_matrix, &meshes->base);
+
+	data->buildings = buildings.get();
+	::generate_buildings_mesh(*data, height, center_matrix, &meshes->buildings);
+}
+
+
+LV::Frustum::Data LV::Frustum::load_region(const std::string& name,
+	const glm::ivec2& start, const glm::ivec2& size)
+{
+	std::cout<<"Loading the Frustum region...\n";
+	return load_region_data(name, load_metadata(name), start, size);
+}
+
+
+void LV::Frustum::save(const Data& data, const Save_options& options)
+{ ::save(data, options); }
+
+
+void LV::Frustum::crop(const std::string& name, const std::string& new_name, float top,
+	float left, float bottom, float right, const Save_options& options)
+{
+	validate_bounds(top, left, bottom, right);
+
+	// Compensate as generate() does, since the stored bounds are compensated.
+	const LV::Bounds bounds{get_compensated_bounds(LV::Bounds{top, left, bottom, right})};
 
-	// Load the metadata.
-	std::ifstream metadata_file{directory+LV::Constants::metadata_file_name};
-	if(!metadata_file) throw std::runtime_error{"Failed to load the Frustum."};
-	metadata_file>>::name>>dataset>>bounds.top>>bounds.left>>bounds.bottom>>bounds.right;
+	std::cout<<"Loading the Frustum region...\n";
+	const Data data{load_metadata(name)};
 
-	// Load the terrain data.
-	terrain_data.clear();
-	std::stringstream terrain_save_data{load_compressed(
-		directory+LV::Constants::terrain_file_name)};
+	// Find the cells covering the coordinates.
+	const glm::fvec2 cells_per_degree{
+		data.size.x/glm::distance(data.bounds.left, data.bounds.right),
+		data.size.y/glm::distance(data.bounds.top, data.bounds.bottom)};
 
-	while(std::getline(terrain_save_data, line))
+	const glm::ivec2 start{glm::max(glm::ivec2{glm::floor(glm::fvec2{bounds.left-
+		data.bounds.left, data.bounds.top-bounds.top}*cells_per_degree)}, glm::ivec2{0})};
+
+	const glm::ivec2 end{glm::min(glm::ivec2{glm::ceil(glm::fvec2{bounds.right-
+		data.bounds.left, data.bounds.top-bounds.bottom}*cells_per_degree)}+1, data.size)};
+
+	// Load and save the region.
+	Data region{load_region_data(name, data, start, end-start)};
+	region.name = new_name;
+	resample(&region, options);
+	save(region, options);
+	std::cout<<"Cropping complete.\n";
+}
+
+
+LV::Frustum::Meshes LV::Frustum::generate_meshes(const Data& data)
+{ return generate_meshes(data, glm::fvec3{-data.size.x/2.f, 0.f, -data.size.y/2.f}); }
+
+
+LV::Frustum::Meshes LV::Frustum::generate_meshes(const Data& data, const glm::fvec3& offset)
+{
+	const glm::fmat4 center_matrix{glm::translate(offset)};
+
+	const auto height{[&](int x, int z){ return data.terrain[z][x]; }};
+
+	// Generate the buildings mesh while the terrain mesh is generated.
+	Meshes meshes;
+	std::future<void> buildings{std::async(std::launch::async,
+		[&]{ ::generate_buildings_mesh(data, height, center_matrix, &meshes.buildings); })};
+
+	::generate_terrain_mesh(data, center_matrix, &meshes.terrain);
+	generate_base_mesh(data.size, height, center_matrix, &meshes.base);
+	buildings.get();
+	return meshes;
+}
+
+
+LV::Mesh LV::Frustum::generate_terrain_mesh(const Data& data)
+{
+	Mesh mesh;
+	::generate_terrain_mesh(data, glm::translate(
+		glm::fvec3{-data.size.x/2.f, 0.f, -data.size.y/2.f}), &mesh);
+
+	return mesh;
+}
+
+
+LV::Mesh LV::Frustum::generate_buildings_mesh(const Data& data)
+{
+	Mesh mesh;
+	::generate_buildings_mesh(data, [&](int x, int z){ return data.terrain[z][x]; },
+		glm::translate(glm::fvec3{-data.size.x/2.f, 0.f, -data.size.y/2.f}), &mesh);
+
+	return mesh;
+}
+
+
+LV::Frustum::Meshes LV::Frustum::stream_meshes(const std::string& name,
+	int band_rows, const std::function<void(const Terrain_band& band)>& function)
+{
+	const LV::Trace::Span span{"Mesh streaming"};
+	const LV::Memory::Scope memory{"Mesh streaming"};
+
+	std::cout<<"Loading the Frustum...\n";
+	Data data{load_metadata(name)};
+	load_buildings(name, &data);
+
+	const glm::ivec2 size{data.size};
+	const glm::fmat4 center_matrix{glm::translate(glm::fvec3{-size.x/2.f, 0.f, -size.y/2.f})};
+	const std::string terrain_path{get_directory(name)+LV::Constants::terrain_file_name};
+
+	// The rows read from the terrain file which are still needed, read a band at a time.
+	std::deque<std::vector<float>> rows;
+	int first_row{};
+
+	const auto get_row{[&](int z) -> const std::vector<float>&
 	{
-		std::stringstream stream{line};
-		terrain_data.emplace_back();
+		while(first_row+static_cast<int>(rows.size()) <= z)
+		{
+			const int start{first_row+static_cast<int>(rows.size())};
+			const int count{std::min(band_rows, size.y-start)};
+
+			// The terrain of older Frustums has already been loaded whole.
+			if(!data.terrain.empty()) rows.insert(rows.end(),
+				data.terrain.begin()+start, data.terrain.begin()+start+count);
+
+			else for(std::vector<float>& row : LV::Codec::load_tiled_terrain(
+				terrain_path, {0, start}, {size.x, count})) rows.emplace_back(std::move(row));
+		}
+
+		return rows[z-first_row];
+	}};
+
+	const auto height{[&](int x, int z){ return get_row(z)[x]; }};
+
+	// Keep the heights needed by the base and buildings meshes.
+	std::vector<float> top_edge, bottom_edge, left_edge, right_edge;
+	std::map<std::pair<int, int>, float> building_heights;
+	for(const LV::Building& building : data.buildings)
+		building_heights.emplace(std::pair<int, int>{
+			static_cast<int>(building.outline[0].y), static_cast<int>(building.outline[0].x)}, 0.f);
+
+	// Generate the terrain mesh band by band. Each band also holds the following row
+	// so that it contains the triangles leading up to the next band.
+	std::cout<<"Generating the terrain mesh...\n";
+	for(int band_start{}; band_start < size.y; band_start += band_rows)
+	{
+		const int band_end{std::min(band_start+band_rows, size.y)};
+		const int mesh_end{std::min(band_end+1, size.y)};
+
+		// Read the rows first, since the rows are generated concurrently.
+		get_row(std::min(mesh_end, size.y-1));
+
+		Terrain_band band;
+		band.first_vertex = static_cast<unsigned>(band_start*size.x);
+		band.vertex_count = static_cast<unsigned>((band_end-band_start)*size.x);
+		generate_terrain_rows(height, size, band_start, mesh_end, center_matrix, &band.mesh);
+
+		for(int z{band_start}; z < band_end; ++z)
+		{
+			const std::vector<float>& row{get_row(z)};
+			left_edge.emplace_back(row.front());
+			right_edge.emplace_back(row.back());
+			if(z == 0) top_edge = row;
+			if(z == size.y-1) bottom_edge = row;
+
+			for(auto building{building_heights.lower_bound({z, 0})};
+				building != building_heights.end() && building->first.first == z; ++building)
+				if(building->first.second < size.x) building->second = row[building->first.second];
+		}
+
+		function(band);
 
-		float point;
-		while(stream>>point) terrain_data.back().emplace_back(point);
+		// Release the rows before the next band's preceding row.
+		while(first_row < band_end-1 && !rows.empty())
+		{
+			rows.pop_front();
+			++first_row;
+		}
 	}
 
-	size = {terrain_data[0].size(), terrain_data.size()};
+	// Generate the other meshes from the kept heights.
+	Meshes meshes;
+
+	::generate_buildings_mesh(data, [&](int x, int z){ return building_heights.at({z, x}); },
+		center_matrix, &meshes.buildings);
+
+	generate_base_mesh(size, [&](int x, int z)
+	{
+		if(z == 0) return top_edge[x];
+		if(z == size.y-1) return bottom_edge[x];
+		return (x == 0) ? left_edge[z] : right_edge[z];
+	}, center_matrix, &meshes.base);
+
+	return meshes;
+}
+
+
+LV::Frustum::Data LV::Frustum::get_region(const Data& data,
+	const glm::ivec2& start, const glm::ivec2& size)
+{
+	Data region{get_region_without_terrain(data, start, size)};
+
+	// Copy the terrain.
+	for(int z{start.y}; z < start.y+size.y; ++z)
+		region.terrain.emplace_back(data.terrain[z].begin()+start.x,
+			data.terrain[z].begin()+start.x+size.x);
+
+	return region;
+}
+
+
+glm::fvec2 LV::Frustum::get_position(const Data& data, float latitude, float longitude)
+{
+	const glm::fvec2 position{
+		(longitude-data.bounds.left)*data.size.x/glm::distance(data.bounds.left, data.bounds.right),
+		(data.bounds.top-latitude)*data.size.y/glm::distance(data.bounds.top, data.bounds.bottom)};
+
+	// Written so that NaN coordinates are outside as well.
+	if(!(position.x >= 0.f && position.y >= 0.f && position.x <= data.size.x-1 &&
+		position.y <= data.size.y-1)) throw std::runtime_error{
+		"The coordinate is outside of the Frustum."};
+
+	return position;
+}
+
+
+float LV::Frustum::get_elevation(const Data& data, float latitude, float longitude)
+{
+	const glm::fvec2 position{get_position(data, latitude, longitude)};
+
+	// Interpolate.
+	const glm::ivec2 cell{glm::min(glm::ivec2{position}, data.size-2)};
+	const glm::fvec2 weight{position-glm::fvec2{cell}};
+
+	const float top{glm::mix(data.terrain[cell.y][cell.x],
+		data.terrain[cell.y][cell.x+1], weight.x)};
+
+	const float bottom{glm::mix(data.terrain[cell.y+1][cell.x],
+		data.terrain[cell.y+1][cell.x+1], weight.x)};
+
+	// Convert from Frustum units back to meters.
+	return glm::mix(top, bottom, weight.y)*LV::Constants::
+		meters_per_frustum_base_unit/static_cast<float>(data.cell_size);
+}
+
+
+void LV::Frustum::get_elevations(const Data& data, std::span<const float> latitudes,
+	std::span<const float> longitudes, std::span<float> elevations)
+{
+	const LV::Trace::Span span{"Elevation sampling"};
+
+	if(latitudes.size() != longitudes.size() || latitudes.size() != elevations.size())
+		throw std::runtime_error{"The coordinate and elevation counts differ."};
+
+	if(data.size.x < 2 || data.size.y < 2) throw std::runtime_error{
+		"The terrain is too small to sample."};
+
+	const float width{glm::distance(data.bounds.left, data.bounds.right)};
+	const float height{glm::distance(data.bounds.top, data.bounds.bottom)};
+	const float last_x{data.size.x-1.f}, last_z{data.size.y-1.f};
+	const float cell_size{static_cast<float>(data.cell_size)};
+
+	std::vector<const float*> rows(data.size.y);
+	for(int z{}; z < data.size.y; ++z) rows[z] = data.terrain[z].data();
 
-	// Load the buildings data.
-	buildings_data.clear();
-	std::stringstream buildings_save_data{load_compressed(
-		directory+LV::Constants::buildings_file_name)};
+	const size_t block_size{LV::Constants::sample_block_size};
+	const size_t block_count{(elevations.size()+block_size-1)/block_size};
 
-	while(std::getline(buildings_save_data, line))
+	LV::Utilities::parallel_for(block_count, [&](size_t block)
 	{
-		std::stringstream stream{line};
-		buildings_data.emplace_back();
-		stream>>buildings_data.back().height;
+		const size_t first{block*block_size};
+		const size_t count{std::min(block_size, elevations.size()-first)};
+
+		// Find the cells and weights without branches, so that the loop is vectorized.
+		int cell_x[block_size], cell_z[block_size];
+		float weight_x[block_size], weight_z[block_size];
+		bool inside[block_size];
+
+		for(size_t index{}; index < count; ++index)
+		{
+			// Map the coordinate onto the grid exactly as get_position does.
+			const float x{(longitudes[first+index]-data.bounds.left)*data.size.x/width};
+			const float z{(data.bounds.top-latitudes[first+index])*data.size.y/height};
+			inside[index] = x >= 0.f && z >= 0.f && x <= last_x && z <= last_z;
+
+			// Sample the first cell instead for the points outside, including NaN coordinates.
+			const float inside_x{inside[index] ? x : 0.f};
+			const float inside_z{inside[index] ? z : 0.f};
+			cell_x[index] = std::min(static_cast<int>(inside_x), data.size.x-2);
+			cell_z[index] = std::min(static_cast<int>(inside_z), data.size.y-2);
+			weight_x[index] = inside_x-cell_x[index];
+			weight_z[index] = inside_z-cell_z[index];
+		}
+
+		// Interpolate.
+		for(size_t index{}; index < count; ++index)
+		{
+			const float* const top_row{rows[cell_z[index]]+cell_x[index]};
+			const float* const bottom_row{rows[cell_z[index]+1]+cell_x[index]};
+			const float top{glm::mix(top_row[0], top_row[1], weight_x[index])};
+			const float bottom{glm::mix(bottom_row[0], bottom_row[1], weight_x[index])};
+
+			elevations[first+index] = inside[index] ? glm::mix(top, bottom, weight_z[index])*
+				LV::Constants::meters_per_frustum_base_unit/cell_size :
+				std::numeric_limits<float>::quiet_NaN();
+		}
+	});
+}
+
+
+void LV::Frustum::benchmark_compression(const std::string& name)
+{
+	const std::string directory{get_directory(name)};
+	const std::vector<std::pair<std::string, std::vector<std::string>>> payloads{
+		{"Terrain", load_terrain_payloads(directory+LV::Constants::terrain_file_name)},
+		{"Buildings", {load_compressed(directory+LV::Constants::buildings_file_name)}}};
 
-		glm::fvec2 point;
-		while(stream>>point.x>>point.y)
-			buildings_data.back().outline.emplace_back(point);
+	const std::vector<std::pair<std::string, LV::Utilities::Compression_profile>> profiles{
+		{"fast", LV::Utilities::Compression_profile::fast},
+		{"balanced", LV::Utilities::Compression_profile::balanced},
+		{"archive", LV::Utilities::Compression_profile::archive}};
+
+	for(const auto& [payload_name, pieces] : payloads)
+	{
+		size_t size{};
+		for(const std::string& piece : pieces) size += piece.size();
+
+		const double megabytes{size/(1024.*1024.)};
+		std::cout<<payload_name<<" ("<<std::fixed<<std::setprecision(1)<<megabytes<<" MB):\n";
+
+		// Compress each piece separately, as they are saved.
+		for(const auto& [profile_name, profile] : profiles)
+		{
+			size_t compressed_size{};
+			double compression_seconds{};
+			double decompression_seconds{};
+
+			for(const std::string& piece : pieces)
+			{
+				std::chrono::steady_clock::time_point start{std::chrono::steady_clock::now()};
+				const std::vector<uint8_t> compressed{LV::Utilities::compress(piece, profile)};
+				compression_seconds += std::chrono::duration<double>(
+					std::chrono::steady_clock::now()-start).count();
+
+				start = std::chrono::steady_clock::now();
+				if(LV::Utilities::decompress(compressed) != piece)
+					throw std::runtime_error{"The compression round trip failed."};
+
+				decompression_seconds += std::chrono::duration<double>(
+					std::chrono::steady_clock::now()-start).count();
+
+				compressed_size += compressed.size();
+			}
+
+			std::cout<<"  "<<std::left<<std::setw(10)<<profile_name<<std::right<<
+				"ratio "<<std::setw(6)<<std::setprecision(2)<<
+				size/std::max<double>(compressed_size, 1)<<
+				", compression "<<std::setw(8)<<std::setprecision(1)<<
+				megabytes/std::max(compression_seconds, 1e-9)<<" MB/s, decompression "<<
+				std::setw(8)<<megabytes/std::max(decompression_seconds, 1e-9)<<" MB/s\n";
+		}
 	}
 
-	// Generate the meshes.
-	generate_meshes();
+	std::cout<<std::defaultfloat;
 }
 
 
-glm::ivec2 LV::Frustum::get_size(){ return size; }
+void LV::Frustum::train_dictionaries()
+{
+	std::vector<std::string> terrain_samples;
+	std::vector<std::string> buildings_samples;
+	size_t frustum_count{};
 
-LV::Mesh LV::Frustum::get_terrain_mesh(){ return terrain_mesh; }
+	// Sample the start of each piece of each saved Frustum's data.
+	const auto add_samples{[](std::vector<std::string>* samples, std::vector<std::string> pieces)
+	{
+		for(std::string& piece : pieces)
+		{
+			piece.resize(std::min(piece.size(), LV::Constants::dictionary_sample_size));
+			if(!piece.empty()) samples->emplace_back(std::move(piece));
+		}
+	}};
 
-LV::Mesh LV::Frustum::get_buildings_mesh(){ return buildings_mesh; }
+	if(!std::filesystem::is_directory(LV::Constants::frustum_directory_name))
+		throw std::runtime_error{"No saved Frustums were found to train from."};
 
-LV::Mesh LV::Frustum::get_base_mesh(){ return base_mesh; }
+	for(const std::filesystem::directory_entry& entry :
+		std::filesystem::directory_iterator{LV::Constants::frustum_directory_name})
+	{
+		const std::string directory{entry.path().string()+"/"};
+		const std::string terrain_path{directory+LV::Constants::terrain_file_name};
+		const std::string buildings_path{directory+LV::Constants::buildings_file_name};
+		if(!std::filesystem::exists(terrain_path) || !std::filesystem::exists(buildings_path)) continue;
+
+		add_samples(&terrain_samples, load_terrain_payloads(terrain_path));
+		add_samples(&buildings_samples, {load_compressed(buildings_path)});
+		++frustum_count;
+	}
+
+	if(terrain_samples.empty() || buildings_samples.empty())
+		throw std::runtime_error{"No saved Frustums were found to train from."};
+
+	// Train.
+	std::cout<<"Training the dictionaries from "<<frustum_count<<" Frustums...\n";
+	LV::Utilities::train_dictionary(LV::Constants::terrain_dictionary_name, terrain_samples);
+	LV::Utilities::train_dictionary(LV::Constants::buildings_dictionary_name, buildings_samples);
+	std::cout<<"Training complete. Newly saved Frustums will use the dictionaries.\n";
+}
@@ -9,8 +9,14 @@
 
 #include <string>
 #include <vector>
+#include <map>
+#include <functional>
+#include <span>
 #include <glm/glm.hpp>
 
+#include "Utilities.hpp"
+#include "Constants.hpp"
+
 
 namespace LV
 {
@@ -19,22 +25,130 @@ namespace LV
 		std::vector<glm::fvec3> vertices;
 		std::vector<unsigned> indices;
 	};
+
+	struct Bounds
+	{
+		float top;
+		float left;
+		float bottom;
+		float right;
+	};
+
+	struct Building
+	{
+		float height;
+		std::vector<glm::fvec2> outline;
+	};
 }
 
 
 namespace LV::Frustum
 {
+	struct Data
+	{
+		std::string name;
+		std::string dataset;
+		Bounds bounds;
+		glm::ivec2 size;
+		double cell_size; // Grid cells per 0.0003 degrees.
+		std::vector<std::vector<float>> terrain;
+		std::vector<Building> buildings;
+	};
+
+	struct Meshes
+	{
+		Mesh terrain;
+		Mesh buildings;
+		Mesh base;
+	};
+
+	struct Terrain_band
+	{
+		Mesh mesh; // Also holds the following row, if any, and the triangles leading to it.
+		unsigned first_vertex; // Within the whole terrain mesh.
+		unsigned vertex_count; // Excluding the following row.
+	};
+
+	struct Save_options
+	{
+		LV::Utilities::Compression_profile profile{LV::Utilities::Compression_profile::balanced};
+		float precision{LV::Constants::default_terrain_precision}; // Vertical, in Frustum units.
+
+		// The terrain is resampled before saving to either the meters per cell or
+		// at most the number of vertices, but never enlarged. Zero keeps the
+		// dataset's resolution.
+		float resolution{};
+		uint64_t vertex_budget{};
+	};
+
+
+	Save_options parse_save_options(const std::map<std::string, std::string>& options);
+
+	// Throws unless the coordinates are within range and in order.
+	void validate_bounds(float top, float left, float bottom, float right);
+
+	// Narrows the bounds to compensate for Mercator projection distortion, as generate does.
+	Bounds get_compensated_bounds(const Bounds& bounds);
+
+	// Returns the size of the terrain once resampled as by the options.
+	glm::ivec2 get_resampled_size(const Data& data, const Save_options& options);
+
+
+	// Safe to call concurrently for different names.
 	void generate(const std::string& name, const std::string& dataset, float top,
-		float left, float bottom, float right, const std::string& api_key);
+		float left, float bottom, float right, const std::string& api_key,
+		const Save_options& options = {});
+
+	// Saves the data as the Frustum named by it, without resampling.
+	void save(const Data& data, const Save_options& options = {});
+
+	Data load(const std::string& name);
+
+	// Loads the Frustum and generates its meshes as by generate_meshes, generating the
+	// terrain's meshes while the buildings are still being parsed.
+	void load(const std::string& name, Data* data, Meshes* meshes);
+
+	// Only loads the terrain covering the region, so the cost is proportional to its area.
+	Data load_region(const std::string& name, const glm::ivec2& start, const glm::ivec2& size);
+
+	// Saves the part of a saved Frustum covering the coordinates as a new Frustum.
+	void crop(const std::string& name, const std::string& new_name, float top,
+		float left, float bottom, float right, const Save_options& options = {});
+
+	Meshes generate_meshes(const Data& data);
+
+	// Generates the meshes translated by the given offset instead of centered.
+	Meshes generate_meshes(const Data& data, const glm::fvec3& offset);
+
+	// Generate only the terrain or buildings mesh, centered as by generate_meshes.
+	Mesh generate_terrain_mesh(const Data& data);
+	Mesh generate_buildings_mesh(const Data& data);
+
+	// Generates the terrain mesh of a saved Frustum in bands of rows which are passed
+	// to the function in order, so that only about two bands of the terrain are held in
+	// memory. The buildings and base meshes are returned afterwards, while the returned
+	// terrain mesh is empty. The meshes are centered as by generate_meshes.
+	Meshes stream_meshes(const std::string& name, int band_rows,
+		const std::function<void(const Terrain_band& band)>& function);
+
+	// Returns the part of the grid starting at the given cell. Buildings are kept
+	// whole and belong to the region containing their first outline point.
+	Data get_region(const Data& data, const glm::ivec2& start, const glm::ivec2& size);
 
-	void load(const std::string& name);
+	// Maps the coordinate onto the grid as a column and row, throwing if it is outside.
+	glm::fvec2 get_position(const Data& data, float latitude, float longitude);
 
-	// Getters.
-	glm::ivec2 get_size();
+	// Returns the bilinearly interpolated elevation in meters.
+	float get_elevation(const Data& data, float latitude, float longitude);
 
-	Mesh get_terrain_mesh();
+	// Writes the bilinearly interpolated elevation in meters at each latitude and
+	// longitude, or NaN outside of the Frustum. Blocks of points are sampled in parallel.
+	void get_elevations(const Data& data, std::span<const float> latitudes,
+		std::span<const float> longitudes, std::span<float> elevations);
 
-	Mesh get_buildings_mesh();
+	// Reports the ratio and speed of each compression profile on a saved Frustum.
+	void benchmark_compression(const std::string& name);
 
-	Mesh get_base_mesh();
+	// Trains the compression dictionaries from the saved Frustums.
+	void train_dictionaries();
 }
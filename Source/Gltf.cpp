@@ -0,0 +1,380 @@
+/*
+	Copyright Myles Trevino
+	Licensed under the Apache License, Version 2.0
+	https://www.apache.org/licenses/LICENSE-2.0
+*/
+
+
+#include "Gltf.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <limits>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <bit>
+#include <nlohmann/json.hpp>
+#include <meshoptimizer/meshoptimizer.h>
+
+#include "Constants.hpp"
+#include "Trace.hpp"
+#include "Memory.hpp"
+
+
+static_assert(std::endian::native == std::endian::little,
+	"The glTF exporter writes little-endian data directly from memory.");
+
+
+namespace
+{
+	// glTF constants.
+	constexpr int byte_component{5120};
+	constexpr int unsigned_short_component{5123};
+	constexpr int unsigned_int_component{5125};
+	constexpr int array_buffer_target{34962};
+	constexpr int element_array_buffer_target{34963};
+	constexpr uint32_t glb_magic{0x46546C67};
+	constexpr uint32_t json_chunk_type{0x4E4F534A};
+	constexpr uint32_t binary_chunk_type{0x004E4942};
+	const std::string meshopt_extension{"EXT_meshopt_compression"};
+
+	struct Glb
+	{
+		bool meshopt_compression{};
+		std::vector<uint8_t> binary;
+		size_t fallback_size{}; // Size of the uncompressed buffer the decoder reconstructs.
+		nlohmann::json buffer_views{nlohmann::json::array()};
+		nlohmann::json accessors{nlohmann::json::array()};
+	};
+
+	struct Quantized_positions
+	{
+		std::vector<uint16_t> positions; // Four components per vertex for alignment.
+		glm::fvec3 offset;
+		float scale;
+		glm::ivec3 minimum;
+		glm::ivec3 maximum;
+	};
+
+
+	size_t align(size_t offset){ return (offset+3)&~size_t{3}; }
+
+
+	// Appends data to the binary buffer and returns its offset.
+	size_t append(Glb* glb, const void* data, size_t size)
+	{
+		const size_t offset{align(glb->binary.size())};
+		glb->binary.resize(offset+size);
+		std::memcpy(glb->binary.data()+offset, data, size);
+		return offset;
+	}
+
+
+	size_t add_view(Glb* glb, nlohmann::json view)
+	{
+		glb->buffer_views.push_back(view);
+		return glb->buffer_views.size()-1;
+	}
+
+
+	size_t add_vertex_view(Glb* glb, const void* data,
+		size_t count, size_t stride, const std::string& filter = {})
+	{
+		nlohmann::json view;
+		view["byteLength"] = count*stride;
+		view["byteStride"] = stride;
+		view["target"] = array_buffer_target;
+
+		if(!glb->meshopt_compression)
+		{
+			view["buffer"] = 0;
+			view["byteOffset"] = append(glb, data, count*stride);
+			return add_view(glb, view);
+		}
+
+		// Compress the attributes and point the view into the fallback buffer.
+		std::vector<uint8_t> encoded(meshopt_encodeVertexBufferBound(count, stride));
+		encoded.resize(meshopt_encodeVertexBuffer(encoded.data(),
+			encoded.size(), data, count, stride));
+
+		nlohmann::json extension;
+		extension["buffer"] = 0;
+		extension["byteOffset"] = append(glb, encoded.data(), encoded.size());
+		extension["byteLength"] = encoded.size();
+		extension["byteStride"] = stride;
+		extension["count"] = count;
+		extension["mode"] = "ATTRIBUTES";
+		if(!filter.empty()) extension["filter"] = filter;
+
+		view["buffer"] = 1;
+		view["byteOffset"] = align(glb->fallback_size);
+		view["extensions"][meshopt_extension] = extension;
+		glb->fallback_size = align(glb->fallback_size)+count*stride;
+		return add_view(glb, view);
+	}
+
+
+	size_t add_index_view(Glb* glb, const std::vector<unsigned>& indices, size_t vertex_count)
+	{
+		// Use 16-bit indices when possible. GLTF reserves the largest value.
+		const bool short_indices{vertex_count <= std::numeric_limits<uint16_t>::max()};
+		const size_t index_size{short_indices ? sizeof(uint16_t) : sizeof(uint32_t)};
+
+		std::vector<uint16_t> short_data;
+		if(short_indices) short_data.assign(indices.begin(), indices.end());
+		const void* data{short_indices ? static_cast<const void*>(short_data.data()) : indices.data()};
+
+		nlohmann::json view;
+		view["byteLength"] = indices.size()*index_size;
+		view["target"] = element_array_buffer_target;
+
+		if(!glb->meshopt_compression)
+		{
+			view["buffer"] = 0;
+			view["byteOffset"] = append(glb, data, indices.size()*index_size);
+		}
+		else
+		{
+			std::vector<uint8_t> encoded(meshopt_encodeIndexBufferBound(indices.size(), vertex_count));
+			encoded.resize(meshopt_encodeIndexBuffer(encoded.data(),
+				encoded.size(), indices.data(), indices.size()));
+
+			nlohmann::json extension;
+			extension["buffer"] = 0;
+			extension["byteOffset"] = append(glb, encoded.data(), encoded.size());
+			extension["byteLength"] = encoded.size();
+			extension["byteStride"] = index_size;
+			extension["count"] = indices.size();
+			extension["mode"] = "TRIANGLES";
+
+			view["buffer"] = 1;
+			view["byteOffset"] = align(glb->fallback_size);
+			view["extensions"][meshopt_extension] = extension;
+			glb->fallback_size = align(glb->fallback_size)+indices.size()*index_size;
+		}
+
+		nlohmann::json accessor;
+		accessor["bufferView"] = add_view(glb, view);
+		accessor["componentType"] = short_indices ? unsigned_short_component : unsigned_int_component;
+		accessor["count"] = indices.size();
+		accessor["type"] = "SCALAR";
+		glb->accessors.push_back(accessor);
+		return glb->accessors.size()-1;
+	}
+
+
+	glm::fvec3 orient(const glm::fvec3& vector, bool z_up)
+	{ return z_up ? glm::fvec3{vector.x, -vector.z, vector.y} : vector; }
+
+
+	// Quantizes the positions to 16 bits with a uniform scale, so that the node
+	// transform does not distort the normals.
+	Quantized_positions quantize_positions(const LV::Mesh& mesh, size_t stride, bool z_up)
+	{
+		const size_t vertex_count{mesh.vertices.size()/stride};
+		Quantized_positions result;
+
+		glm::fvec3 minimum{std::numeric_limits<float>::max()};
+		glm::fvec3 maximum{std::numeric_limits<float>::lowest()};
+
+		for(size_t index{}; index < vertex_count; ++index)
+		{
+			const glm::fvec3 position{orient(mesh.vertices[index*stride], z_up)};
+			minimum = glm::min(minimum, position);
+			maximum = glm::max(maximum, position);
+		}
+
+		const glm::fvec3 extent{maximum-minimum};
+		const float largest_extent{std::max({extent.x, extent.y, extent.z})};
+		result.offset = minimum;
+		result.scale = (largest_extent > 0.f) ? largest_extent/65535.f : 1.f;
+		result.minimum = glm::ivec3{65535};
+		result.maximum = glm::ivec3{0};
+		result.positions.resize(vertex_count*4);
+
+		for(size_t index{}; index < vertex_count; ++index)
+		{
+			const glm::fvec3 position{orient(mesh.vertices[index*stride], z_up)};
+
+			for(int axis{}; axis < 3; ++axis)
+			{
+				const int value{static_cast<int>(std::lround((position[axis]-
+					result.offset[axis])/result.scale))};
+
+				result.positions[index*4+axis] = static_cast<uint16_t>(value);
+				result.minimum[axis] = std::min(result.minimum[axis], value);
+				result.maximum[axis] = std::max(result.maximum[axis], value);
+			}
+		}
+
+		return result;
+	}
+
+
+	size_t add_positions(Glb* glb, const Quantized_positions& quantized)
+	{
+		nlohmann::json accessor;
+		accessor["bufferView"] = add_vertex_view(glb, quantized.positions.data(),
+			quantized.positions.size()/4, 4*sizeof(uint16_t));
+
+		accessor["componentType"] = unsigned_short_component;
+		accessor["count"] = quantized.positions.size()/4;
+		accessor["type"] = "VEC3";
+		accessor["min"] = {quantized.minimum.x, quantized.minimum.y, quantized.minimum.z};
+		accessor["max"] = {quantized.maximum.x, quantized.maximum.y, quantized.maximum.z};
+		glb->accessors.push_back(accessor);
+		return glb->accessors.size()-1;
+	}
+
+
+	size_t add_normals(Glb* glb, const LV::Mesh& mesh, bool z_up)
+	{
+		const size_t vertex_count{mesh.vertices.size()/2};
+		std::vector<int8_t> normals(vertex_count*4);
+
+		// With compression, store the normals octahedrally encoded and let the decoder expand them.
+		if(glb->meshopt_compression)
+		{
+			std::vector<float> data(vertex_count*4);
+			for(size_t index{}; index < vertex_count; ++index)
+			{
+				const glm::fvec3 normal{orient(mesh.vertices[index*2+1], z_up)};
+				data[index*4] = normal.x;
+				data[index*4+1] = normal.y;
+				data[index*4+2] = normal.z;
+			}
+
+			meshopt_encodeFilterOct(normals.data(), vertex_count, 4, 8, data.data());
+		}
+
+		// Otherwise store them as normalized bytes.
+		else for(size_t index{}; index < vertex_count; ++index)
+		{
+			const glm::fvec3 normal{orient(mesh.vertices[index*2+1], z_up)};
+			for(int axis{}; axis < 3; ++axis) normals[index*4+axis] =
+				static_cast<int8_t>(std::lround(glm::clamp(normal[axis], -1.f, 1.f)*127.f));
+		}
+
+		nlohmann::json accessor;
+		accessor["bufferView"] = add_vertex_view(glb, normals.data(),
+			vertex_count, 4, glb->meshopt_compression ? "OCTAHEDRAL" : "");
+
+		accessor["componentType"] = byte_component;
+		accessor["normalized"] = true;
+		accessor["count"] = vertex_count;
+		accessor["type"] = "VEC3";
+		glb->accessors.push_back(accessor);
+		return glb->accessors.size()-1;
+	}
+
+
+	void write_chunk(std::ofstream* file, uint32_t type, const void* data, size_t size, char padding)
+	{
+		const uint32_t padded_size{static_cast<uint32_t>(align(size))};
+		file->write(reinterpret_cast<const char*>(&padded_size), sizeof(padded_size));
+		file->write(reinterpret_cast<const char*>(&type), sizeof(type));
+		file->write(static_cast<const char*>(data), size);
+
+		const std::string padding_characters(padded_size-size, padding);
+		file->write(padding_characters.data(), padding_characters.size());
+	}
+}
+
+
+void LV::Gltf::export_glb(const LV::Frustum::Meshes& meshes,
+	const std::string& path, bool z_up, bool meshopt_compression)
+{
+	const LV::Trace::Span span{"GLB export"};
+	const LV::Memory::Scope memory{"GLB export"};
+
+	std::cout<<"Exporting...\n";
+
+	Glb glb;
+	glb.meshopt_compression = meshopt_compression;
+	nlohmann::json json;
+
+	json["asset"]["version"] = "2.0";
+	json["asset"]["generator"] = LV::Constants::program_name+" "+LV::Constants::program_version;
+
+	// Add the material.
+	const glm::fvec3 color{LV::Constants::material_color};
+	nlohmann::json material;
+	material["name"] = LV::Constants::material_name;
+	material["pbrMetallicRoughness"]["baseColorFactor"] = {color.x, color.y, color.z, 1.f};
+	material["pbrMetallicRoughness"]["metallicFactor"] = 0.f;
+	material["pbrMetallicRoughness"]["roughnessFactor"] = 1.f;
+	json["materials"] = nlohmann::json::array({material});
+
+	// Add a mesh and node for each non-empty Frustum mesh.
+	const std::vector<std::pair<std::string, const LV::Mesh*>> parts{{"Terrain", &meshes.terrain},
+		{"Base", &meshes.base}, {"Buildings", &meshes.buildings}};
+
+	json["meshes"] = nlohmann::json::array();
+	json["nodes"] = nlohmann::json::array();
+
+	for(const auto& [name, mesh] : parts)
+	{
+		if(mesh->indices.empty()) continue;
+		const bool has_normals{mesh == &meshes.terrain};
+		const Quantized_positions quantized{quantize_positions(*mesh, has_normals ? 2 : 1, z_up)};
+
+		nlohmann::json primitive;
+		primitive["attributes"]["POSITION"] = add_positions(&glb, quantized);
+		if(has_normals) primitive["attributes"]["NORMAL"] = add_normals(&glb, *mesh, z_up);
+		primitive["indices"] = add_index_view(&glb, mesh->indices, quantized.positions.size()/4);
+		primitive["material"] = 0;
+
+		nlohmann::json gltf_mesh;
+		gltf_mesh["name"] = name;
+		gltf_mesh["primitives"] = nlohmann::json::array({primitive});
+		json["meshes"].push_back(gltf_mesh);
+
+		// The node transform dequantizes the positions.
+		nlohmann::json node;
+		node["name"] = name;
+		node["mesh"] = json["meshes"].size()-1;
+		node["translation"] = {quantized.offset.x, quantized.offset.y, quantized.offset.z};
+		node["scale"] = {quantized.scale, quantized.scale, quantized.scale};
+		json["nodes"].push_back(node);
+	}
+
+	nlohmann::json scene;
+	scene["nodes"] = nlohmann::json::array();
+	for(size_t index{}; index < json["nodes"].size(); ++index) scene["nodes"].push_back(index);
+	json["scenes"] = nlohmann::json::array({scene});
+	json["scene"] = 0;
+
+	// Add the buffers and extensions.
+	nlohmann::json buffer;
+	buffer["byteLength"] = align(glb.binary.size());
+	json["buffers"] = nlohmann::json::array({buffer});
+	json["extensionsUsed"] = nlohmann::json::array({"KHR_mesh_quantization"});
+
+	if(meshopt_compression)
+	{
+		nlohmann::json fallback_buffer;
+		fallback_buffer["byteLength"] = align(glb.fallback_size);
+		fallback_buffer["extensions"][meshopt_extension]["fallback"] = true;
+		json["buffers"].push_back(fallback_buffer);
+		json["extensionsUsed"].push_back(meshopt_extension);
+	}
+
+	json["extensionsRequired"] = json["extensionsUsed"];
+	json["bufferViews"] = glb.buffer_views;
+	json["accessors"] = glb.accessors;
+
+	// Write the file.
+	const std::string json_data{json.dump()};
+	std::ofstream file{path, std::ios::binary};
+	if(!file) throw std::runtime_error{"Failed to open the export file."};
+
+	const uint32_t header[3]{glb_magic, 2, static_cast<uint32_t>(12+8+
+		align(json_data.size())+8+align(glb.binary.size()))};
+
+	file.write(reinterpret_cast<const char*>(header), sizeof(header));
+	write_chunk(&file, json_chunk_type, json_data.data(), json_data.size(), ' ');
+	write_chunk(&file, binary_chunk_type, glb.binary.data(), glb.binary.size(), '\0');
+
+	if(!file) throw std::runtime_error{"Failed to write the export file."};
+}
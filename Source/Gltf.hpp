@@ -0,0 +1,21 @@
+/*
+	Copyright Myles Trevino
+	Licensed under the Apache License, Version 2.0
+	https://www.apache.org/licenses/LICENSE-2.0
+*/
+
+
+#pragma once
+
+#include <string>
+
+#include "Frustum.hpp"
+
+
+namespace LV::Gltf
+{
+	// Writes a binary glTF with one mesh per Frustum part. Positions and normals are
+	// quantized (KHR_mesh_quantization) and can be compressed (EXT_meshopt_compression).
+	void export_glb(const LV::Frustum::Meshes& meshes, const std::string& path,
+		bool z_up, bool meshopt_compression);
+}
@@ -0,0 +1,469 @@
+/*
+	Copyright Myles Trevino
+	Licensed under the Apache License, Version 2.0
+	https://www.apache.org/licenses/LICENSE-2.0
+*/
+
+
+#include "Http.hpp"
+
+#include <stdexcept>
+#include <cstdio>
+#include <vector>
+#include <deque>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <condition_variable>
+#include <boost/algorithm/string.hpp>
+#ifdef _WIN32
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#endif
+
+
+namespace
+{
+	// Idle keep-alive connections are closed after this many seconds, or sooner once
+	// other connections are waiting for a worker.
+	constexpr int receive_timeout{10};
+	constexpr int idle_check_interval{50}; // Milliseconds.
+
+	constexpr size_t max_header_size{64*1024};
+	constexpr size_t max_body_size{128*1024*1024};
+
+	#ifdef _WIN32
+	using Socket = SOCKET;
+	const Socket invalid_socket{INVALID_SOCKET};
+	constexpr int send_flags{0};
+
+	void close_socket(Socket socket){ closesocket(socket); }
+	void stop_receiving(Socket socket){ shutdown(socket, SD_RECEIVE); }
+	int poll_socket(pollfd* descriptor, int milliseconds){ return WSAPoll(descriptor, 1, milliseconds); }
+
+	void set_receive_timeout(Socket socket, int seconds)
+	{
+		const DWORD timeout{static_cast<DWORD>(seconds*1000)};
+		setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO,
+			reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+	}
+	#else
+	using Socket = int;
+	constexpr Socket invalid_socket{-1};
+	constexpr int send_flags{MSG_NOSIGNAL};
+
+	void close_socket(Socket socket){ close(socket); }
+	void stop_receiving(Socket socket){ shutdown(socket, SHUT_RD); }
+	int poll_socket(pollfd* descriptor, int milliseconds){ return poll(descriptor, 1, milliseconds); }
+
+	void set_receive_timeout(Socket socket, int seconds)
+	{
+		const timeval timeout{seconds, 0};
+		setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	}
+	#endif
+
+
+	std::string decode(const std::string& string)
+	{
+		std::string result;
+
+		for(size_t index{}; index < string.size(); ++index)
+		{
+			if(string[index] == '+') result += ' ';
+
+			else if(string[index] == '%' && index+2 < string.size())
+			{
+				result += static_cast<char>(std::stoi(string.substr(index+1, 2), nullptr, 16));
+				index += 2;
+			}
+
+			else result += string[index];
+		}
+
+		return result;
+	}
+
+
+	void parse_target(LV::Http::Request* request, const std::string& target)
+	{
+		const size_t query_start{target.find('?')};
+		request->path = decode(target.substr(0, query_start));
+		if(query_start == std::string::npos) return;
+
+		std::vector<std::string> pairs;
+		boost::split(pairs, target.substr(query_start+1), boost::is_any_of("&"));
+
+		for(const std::string& pair : pairs)
+		{
+			if(pair.empty()) continue;
+			const size_t separator{pair.find('=')};
+
+			request->parameters[decode(pair.substr(0, separator))] =
+				(separator == std::string::npos) ? "" : decode(pair.substr(separator+1));
+		}
+	}
+
+
+	// Reads one request from the connection. Returns false once the connection is closed.
+	bool receive_request(Socket connection, std::string* buffer,
+		LV::Http::Request* request, bool* keep_alive)
+	{
+		// Read until the end of the header.
+		size_t header_end;
+		while((header_end = buffer->find("\r\n\r\n")) == std::string::npos)
+		{
+			if(buffer->size() > max_header_size) throw std::runtime_error{"HTTP header too large."};
+
+			char chunk[4096];
+			const int received{static_cast<int>(recv(connection, chunk, sizeof(chunk), 0))};
+			if(received <= 0) return false;
+			buffer->append(chunk, received);
+		}
+
+		// Parse the request line.
+		std::vector<std::string> lines;
+		boost::split(lines, buffer->substr(0, header_end), boost::is_any_of("\n"));
+
+		std::vector<std::string> request_line;
+		boost::split(request_line, boost::trim_copy(lines[0]), boost::is_any_of(" "));
+		if(request_line.size() != 3) throw std::runtime_error{"Malformed HTTP request."};
+
+		request->method = request_line[0];
+		request->target = request_line[1];
+		parse_target(request, request_line[1]);
+		*keep_alive = (request_line[2] == "HTTP/1.1");
+
+		// Parse the relevant headers.
+		size_t content_length{};
+		for(size_t index{1}; index < lines.size(); ++index)
+		{
+			const size_t separator{lines[index].find(':')};
+			if(separator == std::string::npos) continue;
+
+			const std::string key{boost::to_lower_copy(boost::trim_copy(lines[index].substr(0, separator)))};
+			const std::string value{boost::to_lower_copy(boost::trim_copy(lines[index].substr(separator+1)))};
+
+			if(key == "content-length") content_length = std::stoul(value);
+			else if(key == "connection") *keep_alive = (value != "close");
+		}
+
+		// Read the body.
+		if(content_length > max_body_size) throw std::runtime_error{"HTTP body too large."};
+		buffer->erase(0, header_end+4);
+		while(buffer->size() < content_length)
+		{
+			char chunk[4096];
+			const int received{static_cast<int>(recv(connection, chunk, sizeof(chunk), 0))};
+			if(received <= 0) return false;
+			buffer->append(chunk, received);
+		}
+
+		request->body = buffer->substr(0, content_length);
+		buffer->erase(0, content_length);
+		return true;
+	}
+
+
+	bool send_all(Socket connection, const std::string& data)
+	{
+		for(size_t sent{}; sent < data.size();)
+		{
+			const int result{static_cast<int>(send(connection, data.data()+sent,
+				static_cast<int>(data.size()-sent), send_flags))};
+
+			if(result <= 0) return false;
+			sent += result;
+		}
+
+		return true;
+	}
+
+
+	// Sends the body in pieces no faster than the response's bandwidth, framing each as
+	// a chunk if it uses chunked transfer encoding.
+	bool send_body(Socket connection, const LV::Http::Response& response)
+	{
+		const size_t piece_size{response.chunk_size > 0 ? response.chunk_size :
+			response.bandwidth > 0. ? 16*1024 : std::max<size_t>(response.body.size(), 1)};
+
+		const std::chrono::steady_clock::time_point start{std::chrono::steady_clock::now()};
+
+		for(size_t offset{}; offset < response.body.size(); offset += piece_size)
+		{
+			const std::string piece{response.body.substr(offset, piece_size)};
+			char size[32];
+			std::snprintf(size, sizeof(size), "%zx\r\n", piece.size());
+
+			if(response.chunk_size > 0 && !send_all(connection, size)) return false;
+			if(!send_all(connection, piece)) return false;
+			if(response.chunk_size > 0 && !send_all(connection, "\r\n")) return false;
+
+			if(response.bandwidth > 0.) std::this_thread::sleep_until(start+
+				std::chrono::duration<double>((offset+piece.size())/response.bandwidth));
+		}
+
+		return response.chunk_size == 0 || send_all(connection, "0\r\n\r\n");
+	}
+
+
+	std::string get_reason(int status)
+	{
+		switch(status)
+		{
+			case 200: return "OK";
+			case 400: return "Bad Request";
+			case 404: return "Not Found";
+			default: return "Internal Server Error";
+		}
+	}
+
+
+	Socket create_listener(unsigned short port)
+	{
+		const Socket socket{::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)};
+		if(socket == invalid_socket) throw std::runtime_error{"Failed to create the socket."};
+
+		const int reuse{1};
+		setsockopt(socket, SOL_SOCKET, SO_REUSEADDR,
+			reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+		sockaddr_in address{};
+		address.sin_family = AF_INET;
+		address.sin_port = htons(port);
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		if(bind(socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+			listen(socket, SOMAXCONN) != 0)
+		{
+			close_socket(socket);
+			throw std::runtime_error{"Failed to listen on port "+std::to_string(port)+"."};
+		}
+
+		return socket;
+	}
+}
+
+
+struct LV::Http::Server_state
+{
+	Handler handler;
+	unsigned worker_count;
+	Socket listener;
+	std::atomic<bool> running{true};
+
+	std::mutex connections_mutex;
+	std::condition_variable connections_condition;
+	std::deque<Socket> connections;
+	std::set<Socket> active_connections; // Being handled by the workers.
+};
+
+
+namespace
+{
+	// Waits for the next request on the idle connection. Gives up after the receive
+	// timeout, or once other connections are waiting for a worker.
+	bool wait_for_request(LV::Http::Server_state* state, Socket connection)
+	{
+		for(int waited{}; waited < receive_timeout*1000; waited += idle_check_interval)
+		{
+			// Errors are left for recv to report.
+			pollfd descriptor{connection, POLLIN, 0};
+			if(poll_socket(&descriptor, idle_check_interval) != 0) return true;
+			if(!state->running) return false;
+
+			std::lock_guard<std::mutex> lock{state->connections_mutex};
+			if(!state->connections.empty()) return false;
+		}
+
+		return false;
+	}
+
+
+	void handle_connection(LV::Http::Server_state* state, Socket connection)
+	{
+		std::string buffer;
+		bool keep_alive{true};
+		bool idle{}; // Between requests, with none pipelined.
+		set_receive_timeout(connection, receive_timeout);
+
+		// Send the body right after the header, instead of waiting for its acknowledgement.
+		const int no_delay{1};
+		setsockopt(connection, IPPROTO_TCP, TCP_NODELAY,
+			reinterpret_cast<const char*>(&no_delay), sizeof(no_delay));
+
+		while(keep_alive && state->running)
+		{
+			// Receive the request and run the handler.
+			LV::Http::Request request;
+			LV::Http::Response response;
+
+			if(idle && !wait_for_request(state, connection)) break;
+			try{ if(!receive_request(connection, &buffer, &request, &keep_alive)) break; }
+			catch(...){ break; }
+
+			try{ response = state->handler(request); }
+			catch(std::exception& error){ response = {500, error.what(), "text/plain"}; }
+			catch(...){ response = {500, "Unhandled exception.", "text/plain"}; }
+
+			// Send the response.
+			keep_alive = keep_alive && !response.close;
+			if(response.latency > 0.) std::this_thread::sleep_for(
+				std::chrono::duration<double>(response.latency));
+
+			const std::string header{"HTTP/1.1 "+std::to_string(response.status)+" "+
+				get_reason(response.status)+"\r\nContent-Type: "+response.content_type+
+				(response.chunk_size > 0 ? "\r\nTransfer-Encoding: chunked" : "\r\nContent-Length: "+
+				std::to_string(response.body.size()))+(keep_alive ? "" : "\r\nConnection: close")+
+				"\r\n\r\n"};
+
+			if(!send_all(connection, header) || !send_body(connection, response)) break;
+			idle = buffer.empty();
+		}
+	}
+
+
+	void work(LV::Http::Server_state* state)
+	{
+		while(true)
+		{
+			Socket connection;
+
+			{
+				std::unique_lock<std::mutex> lock{state->connections_mutex};
+				state->connections_condition.wait(lock,
+					[&]{ return !state->connections.empty() || !state->running; });
+
+				if(state->connections.empty()) return;
+				connection = state->connections.front();
+				state->connections.pop_front();
+				state->active_connections.emplace(connection);
+			}
+
+			// Failures, such as exceeding the memory budget, close the connection.
+			try{ handle_connection(state, connection); }
+			catch(...){}
+
+			{
+				std::lock_guard<std::mutex> lock{state->connections_mutex};
+				state->active_connections.erase(connection);
+			}
+
+			close_socket(connection);
+		}
+	}
+
+
+	// Waits for the workers to finish and closes the remaining connections.
+	void finish(LV::Http::Server_state* state, std::vector<std::thread>* workers)
+	{
+		state->connections_condition.notify_all();
+		for(std::thread& worker : *workers) worker.join();
+
+		for(Socket connection : state->connections) close_socket(connection);
+		state->connections.clear();
+	}
+}
+
+
+LV::Http::Server::Server(unsigned short port, unsigned worker_count, Handler handler) :
+	state{std::make_unique<Server_state>()}
+{
+	#ifdef _WIN32
+	WSADATA wsa_data;
+	if(WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0)
+		throw std::runtime_error{"Failed to initialize Winsock."};
+	#endif
+
+	state->handler = std::move(handler);
+	state->worker_count = std::max(worker_count, 1u);
+
+	try{ state->listener = create_listener(port); }
+	catch(...)
+	{
+		#ifdef _WIN32
+		WSACleanup();
+		#endif
+
+		throw;
+	}
+}
+
+
+LV::Http::Server::~Server()
+{
+	close_socket(state->listener);
+
+	#ifdef _WIN32
+	WSACleanup();
+	#endif
+}
+
+
+void LV::Http::Server::serve()
+{
+	std::vector<std::thread> workers;
+
+	try
+	{
+		// Start the workers.
+		for(unsigned worker{}; worker < state->worker_count; ++worker)
+			workers.emplace_back(work, state.get());
+
+		// Accept connections until stopped, waking periodically to check.
+		while(state->running)
+		{
+			pollfd descriptor{state->listener, POLLIN, 0};
+			const int ready{poll_socket(&descriptor, idle_check_interval)};
+			if(ready == 0) continue;
+
+			// Wait before retrying after errors, for example while out of descriptors.
+			const Socket connection{(ready > 0) ?
+				accept(state->listener, nullptr, nullptr) : invalid_socket};
+
+			if(connection == invalid_socket)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds{idle_check_interval});
+				continue;
+			}
+
+			std::lock_guard<std::mutex> lock{state->connections_mutex};
+			try{ state->connections.emplace_back(connection); }
+			catch(...){ close_socket(connection); throw; }
+			state->connections_condition.notify_one();
+		}
+	}
+	catch(...)
+	{
+		// Join the started workers before rethrowing, since destroying them would terminate.
+		stop();
+		finish(state.get(), &workers);
+		throw;
+	}
+
+	finish(state.get(), &workers);
+}
+
+
+void LV::Http::Server::stop()
+{
+	// Notify while holding the lock, so that no worker can miss it before waiting.
+	std::lock_guard<std::mutex> lock{state->connections_mutex};
+	state->running = false;
+	state->connections_condition.notify_all();
+
+	// Wake the workers waiting for idle keep-alive connections, while still letting
+	// them send their responses.
+	for(const Socket connection : state->active_connections) stop_receiving(connection);
+}
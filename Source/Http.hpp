@@ -0,0 +1,67 @@
+/*
+	Copyright Myles Trevino
+	Licensed under the Apache License, Version 2.0
+	https://www.apache.org/licenses/LICENSE-2.0
+*/
+
+
+#pragma once
+
+#include <string>
+#include <map>
+#include <functional>
+#include <memory>
+
+
+namespace LV::Http
+{
+	struct Request
+	{
+		std::string method;
+		std::string target; // The path and query as received.
+		std::string path;
+		std::map<std::string, std::string> parameters;
+		std::string body;
+	};
+
+	struct Response
+	{
+		int status{200};
+		std::string body;
+		std::string content_type{"application/json"};
+
+		// Simulated network conditions, for standing in for remote servers.
+		double latency{}; // Seconds before the response is sent.
+		double bandwidth{}; // Bytes per second, or zero for unlimited.
+		size_t chunk_size{}; // Uses chunked transfer encoding if not zero.
+		bool close{}; // Closes the connection afterwards.
+	};
+
+	using Handler = std::function<Response(const Request& request)>;
+
+
+	struct Server_state;
+
+
+	// Serves HTTP/1.1 on the loopback interface. Each connection is handled by one of
+	// the workers, which closes it once idle if other connections are waiting. Listens
+	// once constructed, so that several servers may run at once on different ports.
+	class Server
+	{
+	public:
+		Server(unsigned short port, unsigned worker_count, Handler handler);
+		~Server();
+
+		Server(const Server&) = delete;
+		Server& operator=(const Server&) = delete;
+
+		// Handles connections until stop() is called. Blocks the calling thread.
+		void serve();
+
+		// Safe to call from any thread, including from within the handler.
+		void stop();
+
+	private:
+		std::unique_ptr<Server_state> state;
+	};
+}
@@ -0,0 +1,289 @@
+/*
+	Copyright Myles Trevino
+	Licensed under the Apache License, Version 2.0
+	https://www.apache.org/licenses/LICENSE-2.0
+*/
+
+
+#include "Loopback.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <future>
+#include <mutex>
+#include <memory>
+#include <map>
+#include <cmath>
+#include <iomanip>
+#include <algorithm>
+#include <stdexcept>
+
+#include "Constants.hpp"
+#include "Utilities.hpp"
+#include "Request.hpp"
+#include "Http.hpp"
+
+
+namespace
+{
+	constexpr double buildings_per_square_degree{2e6}; // About that of a dense city.
+	constexpr size_t response_cache_limit{256*1024*1024};
+
+	std::mutex mutex;
+	LV::Loopback::Conditions conditions;
+	std::unique_ptr<LV::Http::Server> server;
+	std::future<void> serving;
+
+	// Synthetic responses by recording name, since they are slower to generate than
+	// to send.
+	std::map<std::string, std::string> response_cache;
+	size_t response_cache_size{};
+
+
+	// Returns a deterministic value within [0, 1) for the integers.
+	double hash(int64_t a, int64_t b)
+	{
+		uint64_t value{static_cast<uint64_t>(a)*0x9E3779B97F4A7C15ull^
+			(static_cast<uint64_t>(b)+0x7F4A7C15ull)*0xBF58476D1CE4E5B9ull};
+
+		value ^= value>>31;
+		value *= 0x94D049BB133111EBull;
+		value ^= value>>29;
+		return (value>>11)/9007199254740992.;
+	}
+
+
+	// Rolling hills with small deterministic noise, in meters.
+	double get_elevation(double longitude, double latitude, double cell_size)
+	{
+		const double x{longitude*3600.}, z{latitude*3600.}; // Arc seconds.
+
+		return 400.+150.*std::sin(x*.013)*std::cos(z*.017)+30.*std::sin((x+z)*.11)+
+			5.*hash(std::llround(longitude/cell_size), std::llround(latitude/cell_size));
+	}
+
+
+	double get_cell_size(const std::string& dataset)
+	{
+		const auto cell_size{LV::Constants::dem_cell_degrees.find(dataset)};
+		return (cell_size == LV::Constants::dem_cell_degrees.end()) ? 1./3600. : cell_size->second;
+	}
+
+
+	const std::string& get_parameter(const LV::Http::Request& request, const std::string& key)
+	{
+		const auto parameter{request.parameters.find(key)};
+		if(parameter == request.parameters.end()) throw std::runtime_error{
+			"Missing the '"+key+"' parameter."};
+
+		return parameter->second;
+	}
+
+
+	std::string generate_elevation_response(const LV::Http::Request& request)
+	{
+		const auto dataset{request.parameters.find(request.path == "/API/usgsdem" ?
+			"datasetName" : "demtype")};
+
+		const double cell_size{get_cell_size(dataset == request.parameters.end() ?
+			std::string{} : dataset->second)};
+
+		const double south{std::stod(get_parameter(request, "south"))};
+		const double north{std::stod(get_parameter(request, "north"))};
+		const double west{std::stod(get_parameter(request, "west"))};
+		const double east{std::stod(get_parameter(request, "east"))};
+
+		return LV::Loopback::generate_grid(west, south,
+			std::max(static_cast<int>(std::ceil((east-west)/cell_size)), 2),
+			std::max(static_cast<int>(std::ceil((north-south)/cell_size)), 2), cell_size);
+	}
+
+
+	// Reads the bounds of the query's first bounding box, '(bottom,left,top,right)'.
+	std::string generate_buildings_response(const std::string& query)
+	{
+		const size_t start{query.find("](")};
+		if(start == std::string::npos) throw std::runtime_error{"Missing the bounding box."};
+
+		std::istringstream stream{query.substr(start+2)};
+		LV::Bounds bounds;
+		char separator;
+		stream>>bounds.bottom>>separator>>bounds.left>>separator>>bounds.top>>separator>>bounds.right;
+		if(!stream) throw std::runtime_error{"Malformed bounding box."};
+
+		const double area{(bounds.top-bounds.bottom)*static_cast<double>(bounds.right-bounds.left)};
+		return LV::Loopback::generate_buildings(bounds,
+			static_cast<int>(std::max(area, 0.)*buildings_per_square_degree));
+	}
+
+
+	LV::Http::Response handle(const LV::Http::Request& request)
+	{
+		LV::Http::Response response;
+		response.content_type = "text/plain";
+
+		{
+			const std::lock_guard lock{mutex};
+			response.latency = conditions.latency;
+			response.bandwidth = conditions.bandwidth;
+			response.chunk_size = conditions.chunk_size;
+			response.close = conditions.close;
+		}
+
+		if(request.path == "/payload")
+		{
+			response.body.assign(std::stoull(get_parameter(request, "bytes")), 'x');
+			return response;
+		}
+
+		// Serve the recorded response if there is one.
+		const std::string name{LV::Request::get_recording_name(request.target, request.body)};
+		const std::string path{LV::Constants::recording_directory_name+"/"+name};
+
+		if(std::filesystem::exists(path))
+		{
+			std::ifstream file{path, std::ios::binary};
+			response.body.assign(std::istreambuf_iterator<char>{file}, {});
+			return response;
+		}
+
+		{
+			const std::lock_guard lock{mutex};
+			const auto cached{response_cache.find(name)};
+
+			if(cached != response_cache.end())
+			{
+				response.body = cached->second;
+				return response;
+			}
+		}
+
+		// Otherwise generate one.
+		if(request.path == "/API/globaldem" || request.path == "/API/usgsdem")
+			response.body = generate_elevation_response(request);
+
+		else if(request.path == "/api/interpreter")
+		{
+			response.body = generate_buildings_response(request.body);
+			response.content_type = "application/json";
+		}
+
+		else return {404, "Not found.", "text/plain"};
+
+		const std::lock_guard lock{mutex};
+		if(response_cache_size+response.body.size() <= response_cache_limit)
+		{
+			response_cache_size += response.body.size();
+			response_cache[name] = response.body;
+		}
+
+		return response;
+	}
+}
+
+
+void LV::Loopback::start(const Conditions& new_conditions)
+{
+	if(server) throw std::runtime_error{"The stand-in server is already running."};
+	set_conditions(new_conditions);
+
+	// It listens once constructed, so requests made from here on are accepted.
+	server = std::make_unique<LV::Http::Server>(
+		LV::Constants::loopback_port, LV::Constants::loopback_workers, handle);
+
+	serving = std::async(std::launch::async, &LV::Http::Server::serve, server.get());
+
+	LV::Request::set_redirect(LV::Constants::opentopography_host, get_url());
+	LV::Request::set_redirect(LV::Constants::overpass_host, get_url());
+}
+
+
+void LV::Loopback::set_conditions(const Conditions& new_conditions)
+{
+	const std::lock_guard lock{mutex};
+	conditions = new_conditions;
+}
+
+
+void LV::Loopback::stop()
+{
+	if(!server) return;
+
+	LV::Request::set_redirect(LV::Constants::opentopography_host, {});
+	LV::Request::set_redirect(LV::Constants::overpass_host, {});
+
+	// Keep the server until it has finished serving, even if serving failed.
+	const std::unique_ptr<LV::Http::Server> stopped{std::move(server)};
+	stopped->stop();
+	serving.get();
+
+	const std::lock_guard lock{mutex};
+	response_cache.clear();
+	response_cache_size = 0;
+}
+
+
+std::string LV::Loopback::get_url()
+{ return "http://127.0.0.1:"+std::to_string(LV::Constants::loopback_port); }
+
+
+std::string LV::Loopback::generate_grid(double left, double bottom,
+	int columns, int rows, double cell_size)
+{
+	std::ostringstream text;
+	text<<std::setprecision(12)<<"ncols "<<columns<<"\nnrows "<<rows<<"\nxllcorner "<<left<<
+		"\nyllcorner "<<bottom<<"\ncellsize "<<cell_size<<"\nNODATA_value -9999\n"<<
+		std::fixed<<std::setprecision(2);
+
+	// The first row is the top.
+	for(int z{}; z < rows; ++z)
+	{
+		const double latitude{bottom+(rows-z-.5)*cell_size};
+
+		for(int x{}; x < columns; ++x)
+			text<<get_elevation(left+(x+.5)*cell_size, latitude, cell_size)<<' ';
+
+		text<<'\n';
+	}
+
+	return std::move(text).str();
+}
+
+
+std::string LV::Loopback::generate_buildings(const LV::Bounds& bounds, int building_count)
+{
+	const double width{std::max<double>(bounds.right-bounds.left, 0.)};
+	const double height{std::max<double>(bounds.top-bounds.bottom, 0.)};
+
+	std::ostringstream text;
+	text<<std::fixed<<std::setprecision(7)<<"{\"version\":0.6,\"elements\":[";
+
+	for(int building{}; building < building_count; ++building)
+	{
+		const double size{std::min({.0003*(.5+hash(building, 3)), width, height})};
+		const double left{bounds.left+hash(building, 1)*(width-size)};
+		const double bottom{bounds.bottom+hash(building, 2)*(height-size)};
+
+		text<<(building > 0 ? "," : "")<<"\n{\"type\":\"way\",\"id\":"<<building+1<<
+			",\"tags\":{\"building\":\"yes\",";
+
+		if(building%2 == 0) text<<"\"height\":\""<<10+building%30<<"\"},";
+		else text<<"\"building:levels\":\""<<1+building%8<<"\"},";
+
+		// Closed square outlines.
+		const double corners[][2]{{left, bottom}, {left+size, bottom},
+			{left+size, bottom+size}, {left, bottom+size}, {left, bottom}};
+
+		text<<"\"geometry\":[";
+		for(size_t corner{}; corner < std::size(corners); ++corner)
+			text<<(corner > 0 ? "," : "")<<"{\"lat\":"<<corners[corner][1]<<
+				",\"lon\":"<<corners[corner][0]<<'}';
+
+		text<<"]}";
+	}
+
+	text<<"\n]}\n";
+	return std::move(text).str();
+}
@@ -0,0 +1,46 @@
+/*
+	Copyright Myles Trevino
+	Licensed under the Apache License, Version 2.0
+	https://www.apache.org/licenses/LICENSE-2.0
+*/
+
+
+#pragma once
+
+#include <string>
+
+#include "Frustum.hpp"
+
+
+namespace LV::Loopback
+{
+	// Simulated network conditions of each response.
+	struct Conditions
+	{
+		double latency{}; // Seconds before the first byte.
+		double bandwidth{}; // Bytes per second per connection, or zero for unlimited.
+		size_t chunk_size{}; // Uses chunked transfer encoding if not zero.
+		bool close{}; // Closes each connection after its response.
+	};
+
+
+	// Stands in for OpenTopography and Overpass on the loopback interface, serving
+	// the recorded response of each request if there is one within the Recordings
+	// folder, and otherwise synthetic elevation or buildings covering the requested
+	// bounds. The program's requests to both are redirected to it until stopped.
+	// "GET /payload?bytes=<count>" returns the given number of bytes.
+	void start(const Conditions& conditions = {});
+	void set_conditions(const Conditions& conditions);
+	void stop();
+
+	// Returns the base URL of the running stand-in, for example "http://127.0.0.1:8080".
+	std::string get_url();
+
+	// Returns an Arc ASCII grid of deterministic rolling hills. The elevation depends
+	// only on the coordinates, so adjacent grids match.
+	std::string generate_grid(double left, double bottom, int columns, int rows, double cell_size);
+
+	// Returns an Overpass API JSON response with the given number of deterministic
+	// square buildings within the bounds.
+	std::string generate_buildings(const LV::Bounds& bounds, int building_count);
+}
@@ -7,7 +7,7 @@
 
 #include <fstream>
 #include <iostream>
-#include <regex>
+#include <map>
 #include <curl/curl.h>
 
 #include "Constants.hpp"
@@ -15,6 +15,15 @@
 #include "Frustum.hpp"
 #include "Viewer.hpp"
 #include "Exporter.hpp"
+#include "Batch.hpp"
+#include "Benchmark.hpp"
+#include "Estimator.hpp"
+#include "Visibility.hpp"
+#include "Sampler.hpp"
+#include "Server.hpp"
+#include "Request.hpp"
+#include "Trace.hpp"
+#include "Memory.hpp"
 
 
 void print_documentation()
@@ -22,9 +31,61 @@ void print_documentation()
 	std::cout<<"\nTo generate a Frustum, enter: 'generate <name> <terrain dataset> <top> "
 		"<left> <bottom> <right>'. The name must contain only alphanumeric characters "
 		"and dashes. Supported global datasets are: 'srtmgl1' or 'aw3d30'. Supported USGS "
-		"datasets are: 'usgs30m', 'usgs10m', and 'usgs1m'. For example: 'generate st-gallen "
+		"datasets are: 'usgs30m', 'usgs10m', and 'usgs1m'. The 'local' dataset uses SRTM "
+		"'.hgt' tiles and uncompressed GeoTIFFs placed within the 'DEM' folder instead of "
+		"downloading. For example: 'generate st-gallen "
 		"srtmgl1 47.327618 9.295821 47.126480 9.621767'. Generated Frustums will be saved "
-		"within the 'Frustums' folder."
+		"within the 'Frustums' folder. Downloaded elevation data is kept within the 'Cache' "
+		"folder, up to 2 GB, and reused by overlapping Frustums. Buildings are read from an "
+		"OpenStreetMap '.osm.pbf' extract within the 'OSM' folder when one covers the "
+		"coordinates, otherwise they are downloaded. Adding 'profile=fast', 'profile=balanced' (the "
+		"default), or 'profile=archive' selects how hard the saved data is compressed. "
+		"Heights are stored to a precision of 0.001 Frustum units, which can be changed "
+		"with 'precision=<value>'. Adding 'resolution=<meters>m' resamples the terrain to "
+		"the given meters per point, and 'resolution=<count>' shrinks it to at most the "
+		"given number of points. The terrain is never resampled finer than the dataset, "
+		"so smaller values keep the dataset's resolution."
+
+		<<"\n\nTo estimate the cost of generating a Frustum before doing so, enter: 'estimate "
+		"<terrain dataset> <top> <left> <bottom> <right>'. The grid size, download size, "
+		"peak memory, disk use, triangle counts, and export sizes are predicted without "
+		"downloading anything, and the options of 'generate' are also accepted. Adding "
+		"'memory=<megabytes>' or 'triangles=<count>' recommends the dataset and resolution "
+		"keeping the most detail within the budget. Buildings are not included."
+
+		<<"\n\nTo save part of a generated Frustum as a new Frustum, enter: 'crop <name> "
+		"<new name> <top> <left> <bottom> <right>'. Only the data covering the coordinates "
+		"is loaded, and nothing is downloaded. The options of 'generate' are also accepted."
+
+		<<"\n\nTo generate many Frustums at once, enter: 'batch <manifest>'. Each line of the "
+		"manifest file must contain '<name> <terrain dataset> <top> <left> <bottom> <right>'. "
+		"Empty lines and lines starting with '#' are ignored. The Frustums are generated "
+		"concurrently and failed entries are reported without stopping the batch. The "
+		"'profile' and 'precision' options of 'generate' are also accepted."
+
+		<<"\n\nTo compare the compression profiles on a generated Frustum, enter: "
+		"'benchmark-compression <name>'. The compression ratio and speed of each profile "
+		"are reported."
+
+		<<"\n\nTo measure the performance of the program, enter: 'benchmark'. Synthetic "
+		"Frustums are generated and parsed, meshed, saved, loaded, compressed, and "
+		"exported without downloading anything. The results are saved as JSON within the "
+		"'Benchmarks' folder. Adding 'sizes=<size>,<size>,...' sets the points per side of "
+		"the terrains (256, 1024, and 2048 by default), 'buildings=<count>' the buildings "
+		"per Frustum (5000 by default), and 'repetitions=<count>' how many times each is "
+		"timed, keeping the fastest. Requests are also timed against a local stand-in for "
+		"the elevation and building servers, simulating latency, limited bandwidth, "
+		"chunked responses, and closed connections, unless 'network=false' is added. "
+		"Adding 'baseline=<results file>' reports the change from an earlier run."
+
+		<<"\n\nTo record the responses of the elevation and building servers, enter "
+		"'record start', and 'record stop' once done. The responses are saved within the "
+		"'Recordings' folder, and are served by the stand-in in place of synthetic ones."
+
+		<<"\n\nTo improve the compression of small Frustums, enter: 'train-dictionary'. "
+		"Dictionaries for the terrain and buildings data are trained from the Frustums "
+		"within the 'Frustums' folder and saved in the 'Resources' folder. Frustums saved "
+		"afterwards use them, and keep loading as long as the dictionaries are kept."
 
 		<<"\n\nTo view a generated Frustum, enter: 'view <name>'. For example: 'view "
 		"st-gallen'. In the Viewer, navigate using the 'W', 'A', 'S', and 'D' keys and the  "
@@ -34,10 +95,54 @@ void print_documentation()
 		"key to close the Viewer."
 
 		<<"\n\nTo export a generated Frustum as a 3D model, enter: 'export <name> <format> "
-		"<orientation>'. Valid export formats are: 'ply', 'obj', and 'stl'. The orientation "
-		"can be either 'z-up' or 'y-up'. For example: 'export st-gallen stl z-up'. Exported "
-		"models will be saved within the 'Exports' folder. STL is not recommended for large "
-		"exports. Exporting as OBJ will generate a corresponding MTL file."
+		"<orientation>'. Valid export formats are: 'ply', 'obj', 'stl', and 'glb'. "
+		"The orientation can be either 'z-up' or 'y-up'. For example: 'export st-gallen stl "
+		"z-up'. Exported models will be saved within the 'Exports' folder. PLY and STL exports "
+		"are binary. STL is not recommended for large exports. Exporting as OBJ will generate "
+		"a corresponding MTL file. GLB exports store quantized geometry, and adding "
+		"'compression=meshopt' compresses it further (EXT_meshopt_compression). To split a "
+		"large Frustum into a grid of separate models, add 'tiles=<columns>x<rows>', for "
+		"example 'export st-gallen stl z-up tiles=4x4'. The tiles are saved within a folder "
+		"named after the Frustum. Adding 'optimize=true' welds duplicate vertices and "
+		"reorders the meshes for faster rendering, and reports the savings. Adding "
+		"'streaming=true' to a PLY, OBJ, or STL export writes the terrain in bands of rows "
+		"as it is read, so that Frustums larger than the available memory can be exported."
+
+		<<"\n\nTo sample the elevation of a generated Frustum at many points, enter: 'sample "
+		"<name> <points file>'. Each line of the file must contain a latitude and longitude "
+		"separated by a comma or spaces, and lines starting with '#' are ignored. Files "
+		"ending with '.bin' are instead read as pairs of 32-bit float latitudes and "
+		"longitudes. The elevations in meters are saved within the 'Exports' folder as CSV, "
+		"or as 32-bit floats if 'format=binary' is added, and are empty or NaN for points "
+		"outside of the Frustum."
+
+		<<"\n\nTo find which points of a generated Frustum can be seen from observers, "
+		"enter: 'viewshed <name> <latitude> <longitude>', followed by the latitude and "
+		"longitude of any further observers. The result is saved within the 'Exports' "
+		"folder as a grayscale PGM image with a pixel per terrain point, brighter where "
+		"more of the observers see it. Observers stand 1.7 meters above the surface, which "
+		"can be changed with 'height=<meters>'. Adding 'target=<meters>' checks points above "
+		"the surface instead, and 'radius=<meters>' limits how far the observers see. "
+		"Buildings block the view unless 'buildings=false' is added."
+
+		<<"\n\nTo serve Frustums to other programs, enter: 'serve <port> <cache megabytes>'. "
+		"The server listens on 127.0.0.1 and keeps recently used Frustums in memory up to "
+		"the given size. It answers 'GET /metadata?name=<name>', 'GET /sample?name=<name>"
+		"&latitude=<latitude>&longitude=<longitude>', and 'GET /export?name=<name>&format="
+		"<format>&orientation=<orientation>' with JSON. Many points can be sampled at once "
+		"by posting them to '/sample?name=<name>' in the text format of 'sample'. Request "
+		"'/shutdown' to stop it."
+
+		<<"\n\nThe memory used by each stage is reported after generating, cropping, "
+		"viewing, exporting, or computing a viewshed. To fail with an error instead of "
+		"running out of memory, enter 'memory-budget <megabytes>', after which commands "
+		"stop once they would use more. A budget of 0 removes it."
+
+		<<"\n\nTo record where time is spent, enter 'trace start', run the commands to "
+		"examine, then enter 'trace stop'. The recording is saved within the 'Traces' "
+		"folder as a Chrome trace, which can be opened with ui.perfetto.dev or "
+		"chrome://tracing. Each stage of the commands appears as a span on the thread "
+		"that ran it."
 
 		<<"\n\nTo exit, enter 'exit'."
 
@@ -65,11 +170,21 @@ void validate_command_parameters(const std::string& command, int required, size_
 }
 
 
-void validate_name(const std::string& name)
+// Removes the trailing 'key=value' options from the tokens and returns them.
+std::map<std::string, std::string> extract_options(std::vector<std::string>* tokens)
 {
-	if(!std::regex_match(name, std::regex{"^[a-zA-Z0-9-]+$"}))
-		throw std::runtime_error{"Invalid Frustum name. The name must "
-			"consist only of alphanumeric characters and dashes."};
+	std::map<std::string, std::string> options;
+
+	while(!tokens->empty())
+	{
+		const size_t separator{tokens->back().find('=')};
+		if(separator == std::string::npos) break;
+
+		options[tokens->back().substr(0, separator)] = tokens->back().substr(separator+1);
+		tokens->pop_back();
+	}
+
+	return options;
 }
 
 
@@ -108,6 +223,8 @@ int main(int arguments_count, const char* arguments[])
 	// Main loop.
 	while(true)
 	{
+		bool report_memory{};
+
 		try
 		{
 			// Prompt for input.
@@ -121,28 +238,151 @@ int main(int arguments_count, const char* arguments[])
 			std::string command_name{tokens[0]};
 			tokens.erase(tokens.begin());
 
+			// Report the memory used by the commands which process whole Frustums.
+			report_memory = (command_name == "generate" || command_name == "crop" ||
+				command_name == "batch" || command_name == "view" || command_name == "export" ||
+				command_name == "viewshed");
+
+			if(report_memory) LV::Memory::reset();
+
 			// Parse and execute the command.
 			if(command_name == "generate")
 			{
+				const LV::Frustum::Save_options options{
+					LV::Frustum::parse_save_options(extract_options(&tokens))};
+
 				validate_command_parameters(command_name, 6, tokens.size());
-				validate_name(tokens[0]);
+				LV::Utilities::validate_name(tokens[0]);
 				LV::Frustum::generate(tokens[0], tokens[1], std::stof(tokens[2]),
 					std::stof(tokens[3]), std::stof(tokens[4]), std::stof(tokens[5]),
-					api_key);
+					api_key, options);
+			}
+
+			else if(command_name == "estimate")
+			{
+				LV::Frustum::Save_options options;
+				LV::Estimator::Budget budget;
+				LV::Estimator::parse_options(extract_options(&tokens), &options, &budget);
+
+				validate_command_parameters(command_name, 5, tokens.size());
+				LV::Estimator::estimate(tokens[0], std::stof(tokens[1]), std::stof(tokens[2]),
+					std::stof(tokens[3]), std::stof(tokens[4]), options, budget);
+			}
+
+			else if(command_name == "crop")
+			{
+				const LV::Frustum::Save_options options{
+					LV::Frustum::parse_save_options(extract_options(&tokens))};
+
+				validate_command_parameters(command_name, 6, tokens.size());
+				LV::Utilities::validate_name(tokens[0]);
+				LV::Utilities::validate_name(tokens[1]);
+				LV::Frustum::crop(tokens[0], tokens[1], std::stof(tokens[2]),
+					std::stof(tokens[3]), std::stof(tokens[4]), std::stof(tokens[5]), options);
+			}
+
+			else if(command_name == "batch")
+			{
+				const LV::Frustum::Save_options options{
+					LV::Frustum::parse_save_options(extract_options(&tokens))};
+
+				validate_command_parameters(command_name, 1, tokens.size());
+				LV::Batch::generate(tokens[0], api_key, options);
+			}
+
+			else if(command_name == "benchmark-compression")
+			{
+				validate_command_parameters(command_name, 1, tokens.size());
+				LV::Utilities::validate_name(tokens[0]);
+				LV::Frustum::benchmark_compression(tokens[0]);
+			}
+
+			else if(command_name == "benchmark")
+			{
+				const LV::Benchmark::Options options{
+					LV::Benchmark::parse_options(extract_options(&tokens))};
+
+				validate_command_parameters(command_name, 0, tokens.size());
+				LV::Benchmark::run(options);
 			}
 
 			else if(command_name == "view")
 			{
 				validate_command_parameters(command_name, 1, tokens.size());
-				validate_name(tokens[0]);
+				LV::Utilities::validate_name(tokens[0]);
 				LV::Viewer::view(tokens[0]);
 			}
 
 			else if(command_name == "export")
 			{
+				const LV::Exporter::Options options{
+					LV::Exporter::parse_options(extract_options(&tokens))};
+
 				validate_command_parameters(command_name, 3, tokens.size());
-				validate_name(tokens[0]);
-				LV::Exporter::export_frustum(tokens[0], tokens[1], tokens[2]);
+				LV::Utilities::validate_name(tokens[0]);
+				LV::Exporter::export_frustum(tokens[0], tokens[1], tokens[2], options);
+			}
+
+			else if(command_name == "sample")
+			{
+				const LV::Sampler::Options options{
+					LV::Sampler::parse_options(extract_options(&tokens))};
+
+				validate_command_parameters(command_name, 2, tokens.size());
+				LV::Utilities::validate_name(tokens[0]);
+				LV::Sampler::sample(tokens[0], tokens[1], options);
+			}
+
+			else if(command_name == "viewshed")
+			{
+				const LV::Visibility::Options options{
+					LV::Visibility::parse_options(extract_options(&tokens))};
+
+				if(tokens.size() < 3 || tokens.size()%2 == 0) throw std::runtime_error{
+					"'viewshed' requires a name followed by pairs of coordinates."};
+
+				LV::Utilities::validate_name(tokens[0]);
+				std::vector<glm::fvec2> coordinates;
+				for(size_t index{1}; index < tokens.size(); index += 2)
+					coordinates.emplace_back(std::stof(tokens[index]), std::stof(tokens[index+1]));
+
+				LV::Visibility::viewshed(tokens[0], coordinates, options);
+			}
+
+			else if(command_name == "serve")
+			{
+				validate_command_parameters(command_name, 2, tokens.size());
+				LV::Server::serve(static_cast<unsigned short>(std::stoul(tokens[0])),
+					std::stoull(tokens[1])*1024*1024);
+			}
+
+			else if(command_name == "memory-budget")
+			{
+				validate_command_parameters(command_name, 1, tokens.size());
+				LV::Memory::set_budget(std::stoull(tokens[0])*1024*1024);
+				std::cout<<"Memory budget set.\n";
+			}
+
+			else if(command_name == "record")
+			{
+				validate_command_parameters(command_name, 1, tokens.size());
+				if(tokens[0] == "start") LV::Request::start_recording();
+				else if(tokens[0] == "stop") LV::Request::stop_recording();
+				else throw std::runtime_error{"Invalid record action."};
+			}
+
+			else if(command_name == "trace")
+			{
+				validate_command_parameters(command_name, 1, tokens.size());
+				if(tokens[0] == "start") LV::Trace::start();
+				else if(tokens[0] == "stop") LV::Trace::stop();
+				else throw std::runtime_error{"Invalid trace action."};
+			}
+
+			else if(command_name == "train-dictionary")
+			{
+				validate_command_parameters(command_name, 0, tokens.size());
+				LV::Frustum::train_dictionaries();
 			}
 
 			else if(command_name == "exit")
@@ -156,8 +396,11 @@ int main(int arguments_count, const char* arguments[])
 		}
 		catch(std::exception& error){ std::cout<<"Error: "<<error.what()<<'\n'; }
 		catch(...){ std::cout<<"Error: Unhandled exception.\n"; }
+
+		if(report_memory) LV::Memory::print_report();
 	}
 
 	// Destroy.
+	LV::Request::cleanup();
 	curl_global_cleanup();
 }
@@ -0,0 +1,329 @@
+/*
+	Copyright Myles Trevino
+	Licensed under the Apache License, Version 2.0
+	https://www.apache.org/licenses/LICENSE-2.0
+*/
+
+
+#include "Memory.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <atomic>
+#include <array>
+#include <unordered_map>
+#include <mutex>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include "Constants.hpp"
+
+#ifdef __APPLE__
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif
+
+
+struct LV::Memory::Stage
+{
+	const char* name{"Other"};
+	std::atomic<int64_t> live{}; // Of the blocks allocated while reporting.
+	std::atomic<int64_t> peak{}; // Of the live bytes, since the last reset.
+	std::atomic<uint64_t> allocated{}; // Since the last reset.
+};
+
+
+namespace
+{
+	// Constant initialized, so that allocations made before main are counted.
+	std::array<LV::Memory::Stage, LV::Constants::memory_stage_limit> stages;
+	size_t stage_count{1}; // The first stage is "Other".
+	std::mutex stages_mutex;
+
+	thread_local LV::Memory::Stage* current_stage{&stages[0]};
+	thread_local int unbudgeted_depth{};
+
+	std::atomic<int64_t> live{};
+	std::atomic<int64_t> peak{};
+	std::atomic<uint64_t> budget{};
+
+
+	// Allocates directly, so that the owners table is not itself counted.
+	template<typename Type> struct Malloc_allocator
+	{
+		using value_type = Type;
+
+		Malloc_allocator() = default;
+		template<typename Other> Malloc_allocator(const Malloc_allocator<Other>&){}
+
+		Type* allocate(size_t count)
+		{
+			void* const block{std::malloc(count*sizeof(Type))};
+			if(!block) throw std::bad_alloc{};
+			return static_cast<Type*>(block);
+		}
+
+		void deallocate(Type* block, size_t){ std::free(block); }
+		template<typename Other> bool operator==(const Malloc_allocator<Other>&) const { return true; }
+	};
+
+
+	// The stage of each block allocated while reporting, so that freeing it is credited
+	// to the stage which allocated it. Sharded by address to limit contention.
+	struct Owners
+	{
+		std::mutex mutex;
+		std::unordered_map<void*, LV::Memory::Stage*, std::hash<void*>, std::equal_to<void*>,
+			Malloc_allocator<std::pair<void* const, LV::Memory::Stage*>>> stages;
+	};
+
+	constexpr size_t owners_shard_count{64};
+	Owners* owners{}; // Never destroyed, since blocks are freed during static destruction.
+	std::atomic<bool> reporting{};
+
+
+	Owners& get_owners(void* block)
+	{ return owners[(reinterpret_cast<uintptr_t>(block)>>4)%owners_shard_count]; }
+
+
+	void update_peak(std::atomic<int64_t>* peak, int64_t value)
+	{
+		int64_t previous{peak->load(std::memory_order_relaxed)};
+		while(value > previous && !peak->compare_exchange_weak(
+			previous, value, std::memory_order_relaxed));
+	}
+
+
+	// Queries the allocator for the block's size rather than storing it in front of the
+	// block, since blocks allocated here may be freed by other modules and the reverse.
+	size_t get_size(void* block, size_t alignment)
+	{
+		#ifdef _WIN32
+		if(alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__) return _aligned_msize(block, alignment, 0);
+		return _msize(block);
+		#elif defined(__APPLE__)
+		return malloc_size(block);
+		#else
+		return malloc_usable_size(block);
+		#endif
+	}
+
+
+	void* allocate(size_t size, size_t alignment, bool throwing)
+	{
+		LV::Memory::Stage* const stage{current_stage};
+		const int64_t total{live.fetch_add(size, std::memory_order_relaxed)+
+			static_cast<int64_t>(size)};
+
+		const uint64_t limit{unbudgeted_depth > 0 ? 0 : budget.load(std::memory_order_relaxed)};
+		const size_t block_size{std::max<size_t>(size, 1)};
+		void* block{};
+
+		if(limit == 0 || total <= static_cast<int64_t>(limit))
+		{
+			if(alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__) block = std::malloc(block_size);
+
+			#ifdef _WIN32
+			else block = _aligned_malloc(block_size, alignment);
+			#else
+			else block = std::aligned_alloc(alignment, (block_size+alignment-1)/alignment*alignment);
+			#endif
+		}
+
+		if(!block)
+		{
+			live.fetch_sub(size, std::memory_order_relaxed);
+			if(!throwing) return nullptr;
+			if(limit > 0 && total > static_cast<int64_t>(limit))
+				throw LV::Memory::Budget_error{limit, stage->name};
+			throw std::bad_alloc{};
+		}
+
+		// Count the whole block, as freeing it does.
+		const int64_t slack{static_cast<int64_t>(get_size(block, alignment)-size)};
+		const int64_t block_total{live.fetch_add(slack, std::memory_order_relaxed)+slack};
+
+		update_peak(&peak, block_total);
+		stage->allocated.fetch_add(size+slack, std::memory_order_relaxed);
+
+		if(reporting.load(std::memory_order_acquire))
+		{
+			Owners& block_owners{get_owners(block)};
+
+			{
+				const std::lock_guard lock{block_owners.mutex};
+				block_owners.stages[block] = stage;
+			}
+
+			update_peak(&stage->peak, stage->live.fetch_add(size+slack,
+				std::memory_order_relaxed)+size+slack);
+		}
+
+		return block;
+	}
+
+
+	void deallocate(void* pointer, size_t alignment)
+	{
+		if(!pointer) return;
+		const size_t size{get_size(pointer, alignment)};
+		live.fetch_sub(size, std::memory_order_relaxed);
+
+		if(reporting.load(std::memory_order_acquire))
+		{
+			Owners& block_owners{get_owners(pointer)};
+			LV::Memory::Stage* stage{};
+
+			{
+				const std::lock_guard lock{block_owners.mutex};
+				const auto owner{block_owners.stages.find(pointer)};
+
+				if(owner != block_owners.stages.end())
+				{
+					stage = owner->second;
+					block_owners.stages.erase(owner);
+				}
+			}
+
+			if(stage) stage->live.fetch_sub(size, std::memory_order_relaxed);
+		}
+
+		if(alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__) std::free(pointer);
+
+		#ifdef _WIN32
+		else _aligned_free(pointer);
+		#else
+		else std::free(pointer);
+		#endif
+	}
+
+
+	double to_megabytes(int64_t bytes){ return bytes/(1024.*1024.); }
+}
+
+
+LV::Memory::Budget_error::Budget_error(uint64_t budget, const char* stage)
+{
+	std::snprintf(message, sizeof(message), "The memory budget of %.0f MB was exceeded "
+		"during the \"%s\" stage.", to_megabytes(static_cast<int64_t>(budget)), stage);
+}
+
+
+LV::Memory::Scope::Scope(const char* name) : previous{current_stage}
+{
+	const std::lock_guard lock{stages_mutex};
+	Stage* stage{&stages[0]};
+
+	for(size_t index{1}; index < stage_count; ++index)
+		if(std::strcmp(stages[index].name, name) == 0) stage = &stages[index];
+
+	if(stage == &stages[0] && stage_count < stages.size())
+	{
+		stage = &stages[stage_count++];
+		stage->name = name;
+	}
+
+	current_stage = stage;
+}
+
+
+LV::Memory::Scope::Scope(Stage* stage) : previous{current_stage} { current_stage = stage; }
+LV::Memory::Scope::~Scope(){ current_stage = previous; }
+LV::Memory::Unbudgeted::Unbudgeted(){ ++unbudgeted_depth; }
+LV::Memory::Unbudgeted::~Unbudgeted(){ --unbudgeted_depth; }
+LV::Memory::Stage* LV::Memory::get_stage(){ return current_stage; }
+void LV::Memory::set_budget(uint64_t bytes){ budget = bytes; }
+
+
+void LV::Memory::reset()
+{
+	const std::lock_guard lock{stages_mutex};
+
+	if(!owners)
+	{
+		owners = static_cast<Owners*>(std::malloc(sizeof(Owners)*owners_shard_count));
+		if(!owners) throw std::bad_alloc{};
+		for(size_t shard{}; shard < owners_shard_count; ++shard) new(&owners[shard]) Owners;
+		reporting.store(true, std::memory_order_release);
+	}
+
+	for(size_t index{}; index < stage_count; ++index)
+	{
+		stages[index].peak = stages[index].live.load();
+		stages[index].allocated = 0;
+	}
+
+	peak = live.load();
+}
+
+
+void LV::Memory::print_report()
+{
+	const std::lock_guard lock{stages_mutex};
+
+	std::cout<<"Memory usage (megabytes):\n"<<std::fixed<<std::setprecision(1);
+	for(size_t index{}; index < stage_count; ++index)
+	{
+		const Stage& stage{stages[index]};
+		if(stage.allocated == 0) continue;
+
+		std::cout<<"  "<<std::left<<std::setw(24)<<stage.name<<std::right<<std::setw(9)<<
+			to_megabytes(stage.peak)<<" peak, "<<std::setw(9)<<to_megabytes(static_cast<
+			int64_t>(stage.allocated.load()))<<" allocated\n";
+	}
+
+	std::cout<<"  "<<std::left<<std::setw(24)<<"Total"<<std::right<<std::setw(9)<<
+		to_megabytes(peak)<<" peak, "<<std::setw(9)<<to_megabytes(live)<<" held\n";
+
+	const uint64_t limit{budget};
+	if(limit > 0) std::cout<<"  "<<std::left<<std::setw(24)<<"Budget"<<std::right<<
+		std::setw(9)<<to_megabytes(static_cast<int64_t>(limit))<<'\n';
+	std::cout<<std::defaultfloat;
+}
+
+
+// Replace the global allocation functions to count every allocation made through them.
+void* operator new(size_t size){ return allocate(size, 0, true); }
+void* operator new[](size_t size){ return allocate(size, 0, true); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return allocate(size, 0, false); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return allocate(size, 0, false); }
+
+void* operator new(size_t size, std::align_val_t alignment)
+{ return allocate(size, static_cast<size_t>(alignment), true); }
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{ return allocate(size, static_cast<size_t>(alignment), true); }
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{ return allocate(size, static_cast<size_t>(alignment), false); }
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{ return allocate(size, static_cast<size_t>(alignment), false); }
+
+void operator delete(void* pointer) noexcept { deallocate(pointer, 0); }
+void operator delete[](void* pointer) noexcept { deallocate(pointer, 0); }
+void operator delete(void* pointer, size_t) noexcept { deallocate(pointer, 0); }
+void operator delete[](void* pointer, size_t) noexcept { deallocate(pointer, 0); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { deallocate(pointer, 0); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { deallocate(pointer, 0); }
+
+void operator delete(void* pointer, std::align_val_t alignment) noexcept
+{ deallocate(pointer, static_cast<size_t>(alignment)); }
+
+void operator delete[](void* pointer, std::align_val_t alignment) noexcept
+{ deallocate(pointer, static_cast<size_t>(alignment)); }
+
+void operator delete(void* pointer, size_t, std::align_val_t alignment) noexcept
+{ deallocate(pointer, static_cast<size_t>(alignment)); }
+
+void operator delete[](void* pointer, size_t, std::align_val_t alignment) noexcept
+{ deallocate(pointer, static_cast<size_t>(alignment)); }
+
+void operator delete(void* pointer, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{ deallocate(pointer, static_cast<size_t>(alignment)); }
+
+void operator delete[](void* pointer, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{ deallocate(pointer, static_cast<size_t>(alignment)); }
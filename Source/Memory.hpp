@@ -0,0 +1,75 @@
+/*
+	Copyright Myles Trevino
+	Licensed under the Apache License, Version 2.0
+	https://www.apache.org/licenses/LICENSE-2.0
+*/
+
+
+#pragma once
+
+#include <cstdint>
+#include <new>
+
+
+namespace LV::Memory
+{
+	struct Stage;
+
+
+	// Thrown by operator new when an allocation would exceed the budget.
+	class Budget_error : public std::bad_alloc
+	{
+	public:
+		Budget_error(uint64_t budget, const char* stage);
+		const char* what() const noexcept override { return message; }
+
+	private:
+		char message[160];
+	};
+
+
+	// Attributes the memory allocated by the calling thread to the named stage until
+	// destroyed, restoring the previous stage. A stage's peak is the most it held at
+	// once, counting each of its blocks until freed, wherever that happens. The name must
+	// outlive the program, for example a string literal.
+	class Scope
+	{
+	public:
+		explicit Scope(const char* name);
+		explicit Scope(Stage* stage); // For continuing a stage on another thread.
+		~Scope();
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+		Stage* previous;
+	};
+
+
+	// Exempts the calling thread's allocations from the budget until destroyed, for
+	// allocations within destructors, which must not throw.
+	class Unbudgeted
+	{
+	public:
+		Unbudgeted();
+		~Unbudgeted();
+
+		Unbudgeted(const Unbudgeted&) = delete;
+		Unbudgeted& operator=(const Unbudgeted&) = delete;
+	};
+
+
+	Stage* get_stage(); // The calling thread's.
+
+	// Zero disables the budget.
+	void set_budget(uint64_t bytes);
+
+	// Starts a new report, resetting the peaks to the bytes still allocated. Blocks are
+	// attributed to their stages from the first report on.
+	void reset();
+
+	// Prints the peak and allocated bytes of each stage since the last reset, and the
+	// total bytes still held.
+	void print_report();
+}
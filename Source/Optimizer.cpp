@@ -0,0 +1,140 @@
+/*
+	Copyright Myles Trevino
+	Licensed under the Apache License, Version 2.0
+	https://www.apache.org/licenses/LICENSE-2.0
+*/
+
+
+#include "Optimizer.hpp"
+
+#include <unordered_map>
+#include <limits>
+#include <meshoptimizer/meshoptimizer.h>
+
+
+namespace
+{
+	constexpr unsigned cache_size{16};
+	constexpr float overdraw_threshold{1.05f};
+	constexpr float normal_weld_threshold{.999f};
+
+
+	uint64_t get_cell_key(const glm::ivec3& cell)
+	{
+		return (static_cast<uint64_t>(static_cast<uint32_t>(cell.x))*73856093ull)^
+			(static_cast<uint64_t>(static_cast<uint32_t>(cell.y))*19349663ull)^
+			(static_cast<uint64_t>(static_cast<uint32_t>(cell.z))*83492791ull);
+	}
+
+
+	// Welds the vertices using a spatial hash with cells the size of the tolerance,
+	// so only the neighboring cells need to be searched.
+	void weld(LV::Mesh* mesh, size_t stride, float tolerance)
+	{
+		const size_t vertex_count{mesh->vertices.size()/stride};
+		std::vector<glm::fvec3> vertices;
+		std::vector<unsigned> remap(vertex_count);
+		std::vector<unsigned> next; // Next welded vertex in the same cell.
+		std::unordered_map<uint64_t, unsigned> cells;
+		cells.reserve(vertex_count);
+
+		for(size_t index{}; index < vertex_count; ++index)
+		{
+			const glm::fvec3 position{mesh->vertices[index*stride]};
+			const glm::ivec3 cell{glm::floor(position/tolerance)};
+			unsigned match{std::numeric_limits<unsigned>::max()};
+
+			// Search the neighboring cells.
+			for(int x{-1}; x <= 1 && match == std::numeric_limits<unsigned>::max(); ++x)
+				for(int y{-1}; y <= 1 && match == std::numeric_limits<unsigned>::max(); ++y)
+					for(int z{-1}; z <= 1 && match == std::numeric_limits<unsigned>::max(); ++z)
+					{
+						const auto head{cells.find(get_cell_key(cell+glm::ivec3{x, y, z}))};
+						if(head == cells.end()) continue;
+
+						for(unsigned candidate{head->second}; candidate !=
+							std::numeric_limits<unsigned>::max(); candidate = next[candidate])
+						{
+							if(glm::distance(vertices[candidate*stride], position) > tolerance) continue;
+							if(stride > 1 && glm::dot(vertices[candidate*stride+1],
+								mesh->vertices[index*stride+1]) < normal_weld_threshold) continue;
+
+							match = candidate;
+							break;
+						}
+					}
+
+			// Add the vertex if there was no match.
+			if(match == std::numeric_limits<unsigned>::max())
+			{
+				match = static_cast<unsigned>(vertices.size()/stride);
+				vertices.insert(vertices.end(), mesh->vertices.begin()+index*stride,
+					mesh->vertices.begin()+(index+1)*stride);
+
+				const uint64_t key{get_cell_key(cell)};
+				const auto head{cells.find(key)};
+				next.emplace_back(head == cells.end() ? std::numeric_limits<unsigned>::max() : head->second);
+				cells[key] = match;
+			}
+
+			remap[index] = match;
+		}
+
+		// Remap the indices and drop the triangles that collapsed.
+		std::vector<unsigned> indices;
+		indices.reserve(mesh->indices.size());
+
+		for(size_t index{}; index+2 < mesh->indices.size(); index += 3)
+		{
+			const unsigned a{remap[mesh->indices[index]]};
+			const unsigned b{remap[mesh->indices[index+1]]};
+			const unsigned c{remap[mesh->indices[index+2]]};
+			if(a == b || b == c || c == a) continue;
+
+			indices.insert(indices.end(), {a, b, c});
+		}
+
+		mesh->vertices = std::move(vertices);
+		mesh->indices = std::move(indices);
+	}
+}
+
+
+void LV::Optimizer::optimize(LV::Mesh* mesh, bool has_normals, float weld_tolerance)
+{
+	const size_t stride{has_normals ? size_t{2} : size_t{1}};
+	if(mesh->indices.empty()) return;
+
+	weld(mesh, stride, weld_tolerance);
+
+	const size_t vertex_count{mesh->vertices.size()/stride};
+	std::vector<unsigned> indices(mesh->indices.size());
+
+	// Reorder the triangles for the vertex cache, then for overdraw without
+	// giving up more than the threshold of the cache efficiency.
+	meshopt_optimizeVertexCache(indices.data(), mesh->indices.data(),
+		mesh->indices.size(), vertex_count);
+
+	meshopt_optimizeOverdraw(mesh->indices.data(), indices.data(), indices.size(),
+		&mesh->vertices[0].x, vertex_count, stride*sizeof(glm::fvec3), overdraw_threshold);
+
+	// Reorder the vertices in the order they are first used.
+	std::vector<glm::fvec3> vertices(mesh->vertices.size());
+	const size_t used_vertex_count{meshopt_optimizeVertexFetch(vertices.data(),
+		mesh->indices.data(), mesh->indices.size(), mesh->vertices.data(),
+		vertex_count, stride*sizeof(glm::fvec3))};
+
+	vertices.resize(used_vertex_count*stride);
+	mesh->vertices = std::move(vertices);
+}
+
+
+LV::Optimizer::Statistics LV::Optimizer::analyze(const LV::Mesh& mesh, bool has_normals)
+{
+	const size_t vertex_count{mesh.vertices.size()/(has_normals ? 2 : 1)};
+	const float acmr{mesh.indices.empty() ? 0.f : meshopt_analyzeVertexCache(
+		mesh.indices.data(), mesh.indices.size(), vertex_count, cache_size, 0, 0).acmr};
+
+	return {vertex_count, acmr, mesh.vertices.size()*sizeof(glm::fvec3)+
+		mesh.indices.size()*sizeof(unsigned)};
+}
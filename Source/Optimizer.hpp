@@ -0,0 +1,29 @@
+/*
+	Copyright Myles Trevino
+	Licensed under the Apache License, Version 2.0
+	https://www.apache.org/licenses/LICENSE-2.0
+*/
+
+
+#pragma once
+
+#include "Frustum.hpp"
+
+
+namespace LV::Optimizer
+{
+	struct Statistics
+	{
+		size_t vertices;
+		float acmr; // Average vertices transformed per triangle.
+		size_t bytes;
+	};
+
+
+	// Welds vertices within the tolerance, removes the resulting degenerate triangles,
+	// and reorders the triangles and vertices for the post-transform cache, overdraw,
+	// and fetch locality. Normals must also match for vertices to be welded.
+	void optimize(LV::Mesh* mesh, bool has_normals, float weld_tolerance);
+
+	Statistics analyze(const LV::Mesh& mesh, bool has_normals);
+}
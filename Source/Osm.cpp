@@ -0,0 +1,808 @@
+/*
+	Copyright Myles Trevino
+	Licensed under the Apache License, Version 2.0
+	https://www.apache.org/licenses/LICENSE-2.0
+*/
+
+
+#include "Osm.hpp"
+
+#include <filesystem>
+#include <string_view>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <algorithm>
+#include <iterator>
+#include <zlib/zlib.h>
+#include <zstd/zstd.h>
+#include <nlohmann/json.hpp>
+
+#include "Constants.hpp"
+#include "Utilities.hpp"
+#include "Trace.hpp"
+#include "Memory.hpp"
+
+
+namespace
+{
+	constexpr uint64_t maximum_block_size{32*1024*1024}; // Set by the format.
+	constexpr uint64_t no_string{std::numeric_limits<uint64_t>::max()};
+
+
+	struct Field
+	{
+		uint64_t number;
+		int wire_type;
+		uint64_t value; // Varint and fixed size fields.
+		std::string_view bytes; // Length delimited fields.
+	};
+
+
+	// Bounds in nanodegrees.
+	struct Filter
+	{
+		int64_t top;
+		int64_t left;
+		int64_t bottom;
+		int64_t right;
+	};
+
+
+	// Converts the coordinates of a block to nanodegrees.
+	struct Block_scale
+	{
+		int64_t granularity{100};
+		int64_t longitude_offset{};
+		int64_t latitude_offset{};
+	};
+
+
+	// The indices of the tags used within the block's string table.
+	struct String_table
+	{
+		std::vector<std::string_view> strings;
+		uint64_t building{no_string};
+		uint64_t height{no_string};
+		uint64_t levels{no_string};
+	};
+
+
+	struct Node
+	{
+		int64_t id;
+		glm::ivec2 coordinate; // Longitude and latitude in 100 nanodegree units.
+	};
+
+
+	// The nodes within the bounds and those of the ways crossing them, sorted by ID.
+	struct Node_index
+	{
+		std::vector<int64_t> ids;
+		std::vector<glm::ivec2> coordinates;
+	};
+
+
+	struct Relation
+	{
+		LV::Osm::Building building;
+		int64_t way; // The first member.
+	};
+
+
+	// A way crossing the bounds, resolved once its nodes outside them are read.
+	struct Partial_way
+	{
+		int64_t id;
+		bool is_building;
+		bool is_requested;
+		LV::Osm::Building building;
+		std::vector<int64_t> nodes;
+	};
+
+
+	using Way_geometry = std::pair<int64_t, std::vector<glm::dvec2>>;
+
+	struct Block
+	{
+		std::string_view blob;
+		bool has_nodes{};
+		bool has_ways{};
+		std::vector<Node> nodes; // Within the bounds, or those requested.
+		std::vector<Relation> relations; // Buildings.
+		std::vector<LV::Osm::Building> buildings; // Ways with a point within the bounds.
+		std::vector<Way_geometry> requested_ways; // By relations, likewise.
+		std::vector<Partial_way> partial_ways;
+	};
+
+
+	[[noreturn]] void throw_corrupt()
+	{ throw std::runtime_error{"The OSM extract is corrupt."}; }
+
+
+	uint64_t read_varint(std::string_view* input)
+	{
+		uint64_t value{};
+		for(int shift{}; shift < 64 && !input->empty(); shift += 7)
+		{
+			const uint8_t byte{static_cast<uint8_t>(input->front())};
+			input->remove_prefix(1);
+
+			value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+			if(!(byte & 0x80)) return value;
+		}
+
+		throw_corrupt();
+	}
+
+
+	int64_t decode_zigzag(uint64_t value)
+	{ return static_cast<int64_t>(value >> 1)^-static_cast<int64_t>(value & 1); }
+
+
+	// Reads the next field of a protocol buffer message.
+	bool read_field(std::string_view* message, Field* field)
+	{
+		if(message->empty()) return false;
+
+		const uint64_t key{read_varint(message)};
+		field->number = key >> 3;
+		field->wire_type = static_cast<int>(key & 7);
+		field->value = 0;
+		field->bytes = {};
+
+		if(field->wire_type == 0) field->value = read_varint(message);
+
+		else if(field->wire_type == 1 || field->wire_type == 5)
+		{
+			const size_t size{(field->wire_type == 1) ? 8u : 4u};
+			if(message->size() < size) throw_corrupt();
+
+			for(size_t byte{}; byte < size; ++byte) field->value |=
+				static_cast<uint64_t>(static_cast<uint8_t>((*message)[byte])) << (byte*8);
+
+			message->remove_prefix(size);
+		}
+
+		else if(field->wire_type == 2)
+		{
+			const uint64_t size{read_varint(message)};
+			if(size > message->size()) throw_corrupt();
+
+			field->bytes = message->substr(0, size);
+			message->remove_prefix(size);
+		}
+
+		else throw_corrupt();
+		return true;
+	}
+
+
+	// Reads the next block of the file, returning false at the end of the file.
+	bool read_file_block(std::string_view* file, std::string_view* type, std::string_view* blob)
+	{
+		if(file->empty()) return false;
+		if(file->size() < 4) throw_corrupt();
+
+		uint32_t header_size{};
+		for(int byte{}; byte < 4; ++byte) header_size = (header_size << 8)|
+			static_cast<uint8_t>((*file)[byte]);
+
+		file->remove_prefix(4);
+		if(header_size > file->size()) throw_corrupt();
+
+		std::string_view header{file->substr(0, header_size)};
+		file->remove_prefix(header_size);
+
+		uint64_t blob_size{};
+		Field field;
+
+		while(read_field(&header, &field))
+		{
+			if(field.number == 1) *type = field.bytes;
+			else if(field.number == 3) blob_size = field.value;
+		}
+
+		if(blob_size > file->size()) throw_corrupt();
+
+		*blob = file->substr(0, blob_size);
+		file->remove_prefix(blob_size);
+		return true;
+	}
+
+
+	// Returns the contents of the blob, decompressing them into the buffer if needed.
+	std::string_view read_blob(std::string_view blob, std::string* buffer)
+	{
+		uint64_t raw_size{};
+		std::string_view zlib_data;
+		std::string_view zstd_data;
+		Field field;
+
+		while(read_field(&blob, &field))
+		{
+			if(field.number == 1) return field.bytes;
+			else if(field.number == 2) raw_size = field.value;
+			else if(field.number == 3) zlib_data = field.bytes;
+			else if(field.number == 7) zstd_data = field.bytes;
+
+			else if(field.number >= 4 && field.number <= 6) throw std::runtime_error{
+				"The OSM extract uses an unsupported compression, only zlib and zstd are supported."};
+		}
+
+		if(raw_size > maximum_block_size) throw_corrupt();
+		buffer->resize(raw_size);
+
+		if(!zlib_data.empty())
+		{
+			uLongf size{static_cast<uLongf>(raw_size)};
+
+			if(uncompress(reinterpret_cast<Bytef*>(buffer->data()), &size,
+				reinterpret_cast<const Bytef*>(zlib_data.data()),
+				static_cast<uLong>(zlib_data.size())) != Z_OK || size != raw_size) throw_corrupt();
+		}
+
+		else if(!zstd_data.empty())
+		{
+			const size_t size{ZSTD_decompress(buffer->data(),
+				buffer->size(), zstd_data.data(), zstd_data.size())};
+
+			if(ZSTD_isError(size) || size != raw_size) throw_corrupt();
+		}
+
+		else throw_corrupt();
+		return *buffer;
+	}
+
+
+	// Reads the bounding box of the extract's header block, returning false if it has none.
+	bool read_extract_bounds(std::string_view file, Filter* bounds)
+	{
+		std::string_view type;
+		std::string_view blob;
+		if(!read_file_block(&file, &type, &blob) || type != "OSMHeader") throw_corrupt();
+
+		std::string buffer;
+		std::string_view header{read_blob(blob, &buffer)};
+		Field field;
+
+		while(read_field(&header, &field))
+		{
+			if(field.number != 1) continue;
+
+			std::string_view box{field.bytes};
+			while(read_field(&box, &field))
+			{
+				const int64_t value{decode_zigzag(field.value)};
+
+				if(field.number == 1) bounds->left = value;
+				else if(field.number == 2) bounds->right = value;
+				else if(field.number == 3) bounds->top = value;
+				else if(field.number == 4) bounds->bottom = value;
+			}
+
+			return true;
+		}
+
+		return false;
+	}
+
+
+	Filter get_filter(const LV::Bounds& bounds)
+	{
+		const auto to_nanodegrees{[](float degrees)
+		{ return static_cast<int64_t>(std::llround(static_cast<double>(degrees)*1e9)); }};
+
+		return {to_nanodegrees(bounds.top), to_nanodegrees(bounds.left),
+			to_nanodegrees(bounds.bottom), to_nanodegrees(bounds.right)};
+	}
+
+
+	String_table read_string_table(std::string_view message)
+	{
+		String_table table;
+		Field field;
+
+		while(read_field(&message, &field))
+		{
+			if(field.number != 1) continue;
+
+			const uint64_t index{table.strings.size()};
+			table.strings.emplace_back(field.bytes);
+
+			if(field.bytes == "building") table.building = index;
+			else if(field.bytes == "height") table.height = index;
+			else if(field.bytes == "building:levels") table.levels = index;
+		}
+
+		return table;
+	}
+
+
+	// Reads the height tags, returning false if there is no building tag.
+	bool read_building_tags(std::string_view keys, std::string_view values,
+		const String_table& strings, LV::Osm::Building* building)
+	{
+		if(strings.building == no_string) return false;
+		bool is_building{};
+
+		while(!keys.empty() && !values.empty())
+		{
+			const uint64_t key{read_varint(&keys)};
+			const uint64_t value{read_varint(&values)};
+			if(value >= strings.strings.size()) throw_corrupt();
+
+			if(key == strings.building) is_building = true;
+			else if(key == strings.height) building->height = strings.strings[value];
+			else if(key == strings.levels) building->levels = strings.strings[value];
+		}
+
+		return is_building;
+	}
+
+
+	// Appends the value of each delta coded entry.
+	void read_deltas(std::string_view packed, std::vector<int64_t>* values)
+	{
+		int64_t value{};
+		while(!packed.empty())
+		{
+			value += decode_zigzag(read_varint(&packed));
+			values->emplace_back(value);
+		}
+	}
+
+
+	// Keeps the node if it is requested, or otherwise if it lies within the bounds.
+	void add_node(int64_t id, int64_t longitude, int64_t latitude, const Filter& filter,
+		const std::vector<int64_t>* requested_nodes, const Block_scale& scale,
+		std::vector<Node>* nodes)
+	{
+		longitude = scale.longitude_offset+longitude*scale.granularity;
+		latitude = scale.latitude_offset+latitude*scale.granularity;
+
+		if(requested_nodes ? !std::binary_search(requested_nodes->begin(),
+			requested_nodes->end(), id) : (longitude < filter.left || longitude > filter.right ||
+			latitude < filter.bottom || latitude > filter.top)) return;
+
+		nodes->emplace_back(Node{id, glm::ivec2{
+			static_cast<int>(longitude/100), static_cast<int>(latitude/100)}});
+	}
+
+
+	void read_dense_nodes(std::string_view message, const Filter& filter,
+		const std::vector<int64_t>* requested_nodes, const Block_scale& scale,
+		std::vector<Node>* nodes)
+	{
+		std::string_view ids;
+		std::string_view latitudes;
+		std::string_view longitudes;
+		Field field;
+
+		while(read_field(&message, &field))
+		{
+			if(field.number == 1) ids = field.bytes;
+			else if(field.number == 8) latitudes = field.bytes;
+			else if(field.number == 9) longitudes = field.bytes;
+		}
+
+		int64_t id{};
+		int64_t longitude{};
+		int64_t latitude{};
+
+		while(!ids.empty())
+		{
+			id += decode_zigzag(read_varint(&ids));
+			longitude += decode_zigzag(read_varint(&longitudes));
+			latitude += decode_zigzag(read_varint(&latitudes));
+			add_node(id, longitude, latitude, filter, requested_nodes, scale, nodes);
+		}
+	}
+
+
+	void read_node(std::string_view message, const Filter& filter,
+		const std::vector<int64_t>* requested_nodes, const Block_scale& scale,
+		std::vector<Node>* nodes)
+	{
+		int64_t id{};
+		int64_t longitude{};
+		int64_t latitude{};
+		Field field;
+
+		while(read_field(&message, &field))
+		{
+			if(field.number == 1) id = decode_zigzag(field.value);
+			else if(field.number == 8) latitude = decode_zigzag(field.value);
+			else if(field.number == 9) longitude = decode_zigzag(field.value);
+		}
+
+		add_node(id, longitude, latitude, filter, requested_nodes, scale, nodes);
+	}
+
+
+	// Looks up the coordinates of the way's nodes, returning false if any are missing.
+	bool resolve_geometry(const std::vector<int64_t>& way_nodes,
+		const Node_index& nodes, std::vector<glm::dvec2>* geometry)
+	{
+		for(const int64_t node : way_nodes)
+		{
+			const std::vector<int64_t>::const_iterator iterator{
+				std::lower_bound(nodes.ids.begin(), nodes.ids.end(), node)};
+
+			if(iterator == nodes.ids.end() || *iterator != node) return false;
+			geometry->emplace_back(glm::dvec2{nodes.coordinates[iterator-nodes.ids.begin()]}*1e-7);
+		}
+
+		return geometry->size() >= 3;
+	}
+
+
+	bool is_indexed(const Node_index& nodes, int64_t node)
+	{ return std::binary_search(nodes.ids.begin(), nodes.ids.end(), node); }
+
+
+	void keep_way(int64_t id, bool is_building, bool is_requested,
+		LV::Osm::Building building, std::vector<glm::dvec2> geometry, Block* block)
+	{
+		if(is_requested) block->requested_ways.emplace_back(id, geometry);
+		if(!is_building) return;
+
+		building.geometry = std::move(geometry);
+		block->buildings.emplace_back(std::move(building));
+	}
+
+
+	// Keeps the building ways and the ways requested by relations with a point within
+	// the bounds, as their geometry. Those crossing the bounds are kept as partial ways,
+	// since Overpass returns them whole.
+	void read_way(std::string_view message, const String_table& strings,
+		const Node_index& nodes, const std::vector<int64_t>& requested_ways, Block* block)
+	{
+		int64_t id{};
+		LV::Osm::Building building;
+		std::string_view keys;
+		std::string_view values;
+		std::string_view way_nodes;
+		Field field;
+
+		while(read_field(&message, &field))
+		{
+			if(field.number == 1) id = static_cast<int64_t>(field.value);
+			else if(field.number == 2) keys = field.bytes;
+			else if(field.number == 3) values = field.bytes;
+			else if(field.number == 8) way_nodes = field.bytes;
+		}
+
+		const bool is_building{read_building_tags(keys, values, strings, &building)};
+		const bool is_requested{std::binary_search(requested_ways.begin(), requested_ways.end(), id)};
+		if(!is_building && !is_requested) return;
+
+		std::vector<int64_t> node_ids;
+		read_deltas(way_nodes, &node_ids);
+
+		std::vector<glm::dvec2> geometry;
+		if(resolve_geometry(node_ids, nodes, &geometry)) keep_way(id, is_building,
+			is_requested, std::move(building), std::move(geometry), block);
+
+		else if(std::any_of(node_ids.begin(), node_ids.end(),
+			[&](int64_t node){ return is_indexed(nodes, node); }))
+			block->partial_ways.push_back({id, is_building, is_requested,
+				std::move(building), std::move(node_ids)});
+	}
+
+
+	void read_relation(std::string_view message,
+		const String_table& strings, std::vector<Relation>* relations)
+	{
+		Relation relation{};
+		std::string_view keys;
+		std::string_view values;
+		std::string_view members;
+		std::string_view types;
+		Field field;
+
+		while(read_field(&message, &field))
+		{
+			if(field.number == 2) keys = field.bytes;
+			else if(field.number == 3) values = field.bytes;
+			else if(field.number == 9) members = field.bytes;
+			else if(field.number == 10) types = field.bytes;
+		}
+
+		// Only keep buildings whose first member is a way.
+		if(members.empty() || types.empty() || read_varint(&types) != 1 ||
+			!read_building_tags(keys, values, strings, &relation.building)) return;
+
+		relation.way = decode_zigzag(read_varint(&members));
+		relations->emplace_back(std::move(relation));
+	}
+
+
+	// Decodes the block, keeping the nodes within the bounds and the building relations.
+	// Once the nodes are indexed, decoding it again keeps the ways crossing the bounds.
+	// Decoding it with the requested nodes only keeps those.
+	void read_block(Block* block, const Filter& filter, const Node_index* nodes = nullptr,
+		const std::vector<int64_t>* requested_ways = nullptr,
+		const std::vector<int64_t>* requested_nodes = nullptr)
+	{
+		const LV::Trace::Span span{"OSM block decoding"};
+
+		std::string buffer;
+		std::string_view message{read_blob(block->blob, &buffer)};
+
+		String_table strings;
+		std::vector<std::string_view> groups;
+		Block_scale scale;
+		Field field;
+
+		while(read_field(&message, &field))
+		{
+			if(field.number == 1) strings = read_string_table(field.bytes);
+			else if(field.number == 2) groups.emplace_back(field.bytes);
+			else if(field.number == 17) scale.granularity = static_cast<int64_t>(field.value);
+			else if(field.number == 19) scale.latitude_offset = static_cast<int64_t>(field.value);
+			else if(field.number == 20) scale.longitude_offset = static_cast<int64_t>(field.value);
+		}
+
+		for(std::string_view group : groups)
+		{
+			while(read_field(&group, &field))
+			{
+				if(field.number == 3)
+				{
+					block->has_ways = true;
+					if(nodes) read_way(field.bytes, strings, *nodes, *requested_ways, block);
+				}
+
+				else if(nodes) continue;
+
+				else if(field.number == 1)
+				{
+					block->has_nodes = true;
+					read_node(field.bytes, filter, requested_nodes, scale, &block->nodes);
+				}
+
+				else if(field.number == 2)
+				{
+					block->has_nodes = true;
+					read_dense_nodes(field.bytes, filter, requested_nodes, scale, &block->nodes);
+				}
+
+				else if(field.number == 4 && !requested_nodes)
+					read_relation(field.bytes, strings, &block->relations);
+			}
+		}
+	}
+
+
+	// Adds the nodes decoded from the blocks to the index.
+	void index_nodes(std::vector<Block>* blocks, Node_index* index)
+	{
+		std::vector<Node> nodes;
+		for(size_t node{}; node < index->ids.size(); ++node)
+			nodes.emplace_back(Node{index->ids[node], index->coordinates[node]});
+
+		for(Block& block : *blocks)
+		{
+			nodes.insert(nodes.end(), block.nodes.begin(), block.nodes.end());
+			std::vector<Node>{}.swap(block.nodes);
+		}
+
+		std::sort(nodes.begin(), nodes.end(),
+			[](const Node& a, const Node& b){ return a.id < b.id; });
+
+		index->ids.resize(nodes.size());
+		index->coordinates.resize(nodes.size());
+
+		for(size_t node{}; node < nodes.size(); ++node)
+		{
+			index->ids[node] = nodes[node].id;
+			index->coordinates[node] = nodes[node].coordinate;
+		}
+	}
+
+
+	// Reads the geometry of an Overpass element's "geometry" array.
+	std::vector<glm::dvec2> get_geometry(const nlohmann::json& json)
+	{
+		std::vector<glm::dvec2> geometry;
+
+		const nlohmann::json::const_iterator points{json.find("geometry")};
+		if(points == json.end()) return geometry;
+
+		for(const nlohmann::json& point : points.value())
+			geometry.emplace_back(point.at("lon").get<double>(), point.at("lat").get<double>());
+
+		return geometry;
+	}
+}
+
+
+std::string LV::Osm::find_extract(const LV::Bounds& bounds)
+{
+	const std::string& directory{LV::Constants::osm_directory_name};
+	if(!std::filesystem::is_directory(directory)) return {};
+
+	std::vector<std::filesystem::path> paths;
+	for(const std::filesystem::directory_entry& entry :
+		std::filesystem::recursive_directory_iterator{directory})
+	{
+		const std::string name{LV::Utilities::to_uppercase(entry.path().filename().string())};
+		if(entry.is_regular_file() && name.ends_with(".OSM.PBF")) paths.emplace_back(entry.path());
+	}
+
+	std::sort(paths.begin(), paths.end());
+	const Filter filter{get_filter(bounds)};
+
+	for(const std::filesystem::path& path : paths)
+	{
+		const LV::Mapped_file file{path.string()};
+		Filter extract_bounds{};
+
+		if(!read_extract_bounds({reinterpret_cast<const char*>(file.data), file.size},
+			&extract_bounds) || (extract_bounds.left <= filter.left &&
+			extract_bounds.right >= filter.right && extract_bounds.top >= filter.top &&
+			extract_bounds.bottom <= filter.bottom)) return path.string();
+	}
+
+	return {};
+}
+
+
+std::vector<LV::Osm::Building> LV::Osm::read_buildings(
+	const std::string& path, const LV::Bounds& bounds)
+{
+	const LV::Trace::Span span{"OSM reading"};
+	const LV::Memory::Scope memory{"OSM reading"};
+
+	LV::Utilities::print("Reading the building data from \""+path+"\"...\n");
+
+	const LV::Mapped_file file{path};
+	std::string_view data{reinterpret_cast<const char*>(file.data), file.size};
+	const Filter filter{get_filter(bounds)};
+
+	// Index the data blocks.
+	std::vector<Block> blocks;
+	std::string_view type;
+	std::string_view blob;
+
+	while(read_file_block(&data, &type, &blob))
+		if(type == "OSMData") blocks.emplace_back().blob = blob;
+
+	// Decode the nodes and relations.
+	LV::Utilities::parallel_for(blocks.size(),
+		[&](size_t index){ read_block(&blocks[index], filter); });
+
+	// Index the nodes within the bounds by ID.
+	Node_index nodes;
+	index_nodes(&blocks, &nodes);
+
+	// Decode the ways again, only from the blocks containing them, keeping those with a
+	// point within the bounds, so that the ways elsewhere in the extract are never held.
+	std::vector<int64_t> requested_ways;
+	for(const Block& block : blocks) for(const Relation& relation : block.relations)
+		requested_ways.emplace_back(relation.way);
+
+	std::sort(requested_ways.begin(), requested_ways.end());
+	requested_ways.erase(std::unique(requested_ways.begin(),
+		requested_ways.end()), requested_ways.end());
+
+	LV::Utilities::parallel_for(blocks.size(), [&](size_t index)
+	{
+		Block& block{blocks[index]};
+		if(block.has_ways) read_block(&block, filter, &nodes, &requested_ways);
+	});
+
+	// Decode the nodes outside the bounds of the ways crossing them, then resolve those.
+	std::vector<int64_t> outside_nodes;
+	for(const Block& block : blocks) for(const Partial_way& way : block.partial_ways)
+		for(const int64_t node : way.nodes)
+			if(!is_indexed(nodes, node)) outside_nodes.emplace_back(node);
+
+	std::sort(outside_nodes.begin(), outside_nodes.end());
+	outside_nodes.erase(std::unique(outside_nodes.begin(),
+		outside_nodes.end()), outside_nodes.end());
+
+	if(!outside_nodes.empty())
+	{
+		LV::Utilities::parallel_for(blocks.size(), [&](size_t index)
+		{
+			Block& block{blocks[index]};
+			if(block.has_nodes) read_block(&block, filter, nullptr, nullptr, &outside_nodes);
+		});
+
+		index_nodes(&blocks, &nodes);
+	}
+
+	for(Block& block : blocks)
+	{
+		for(Partial_way& way : block.partial_ways)
+		{
+			std::vector<glm::dvec2> geometry;
+			if(resolve_geometry(way.nodes, nodes, &geometry)) keep_way(way.id, way.is_building,
+				way.is_requested, std::move(way.building), std::move(geometry), &block);
+		}
+
+		std::vector<Partial_way>{}.swap(block.partial_ways);
+	}
+
+	// Collect the building ways.
+	std::vector<LV::Osm::Building> buildings;
+	std::vector<Way_geometry> way_geometries;
+
+	for(Block& block : blocks)
+	{
+		std::move(block.buildings.begin(), block.buildings.end(), std::back_inserter(buildings));
+		std::move(block.requested_ways.begin(), block.requested_ways.end(),
+			std::back_inserter(way_geometries));
+	}
+
+	std::sort(way_geometries.begin(), way_geometries.end(),
+		[](const Way_geometry& a, const Way_geometry& b){ return a.first < b.first; });
+
+	// Resolve the building relations.
+	for(Block& block : blocks) for(Relation& relation : block.relations)
+	{
+		const auto way{std::lower_bound(way_geometries.begin(), way_geometries.end(), relation.way,
+			[](const Way_geometry& way, int64_t id){ return way.first < id; })};
+
+		if(way == way_geometries.end() || way->first != relation.way) continue;
+
+		relation.building.geometry = way->second;
+		buildings.emplace_back(std::move(relation.building));
+	}
+
+	return buildings;
+}
+
+
+std::vector<LV::Osm::Building> LV::Osm::parse_overpass(const std::string& json_text)
+{
+	const LV::Trace::Span span{"Overpass parsing"};
+	const LV::Memory::Scope memory{"Overpass parsing"};
+
+	std::vector<Building> buildings;
+	const nlohmann::json json{nlohmann::json::parse(json_text)};
+
+	// For each building...
+	for(const nlohmann::json& element : json["elements"])
+	{
+		try
+		{
+			Building building;
+			const nlohmann::json::const_iterator tags{element.find("tags")};
+			if(tags == element.end()) continue;
+
+			// Get the building's height tags.
+			const nlohmann::json::const_iterator height{tags.value().find("height")};
+			const nlohmann::json::const_iterator levels{
+				tags.value().find("building:levels")};
+
+			if(height != tags.value().end()) building.height = height.value().get<std::string>();
+			if(levels != tags.value().end()) building.levels = levels.value().get<std::string>();
+
+			// Get the geometry of "way" buildings.
+			const nlohmann::json::const_iterator type{element.find("type")};
+			if(type == element.end()) continue;
+
+			if(type.value() == "way") building.geometry = get_geometry(element);
+
+			// Get the geometry of "relation" buildings.
+			else if(type.value() == "relation")
+			{
+				const nlohmann::json::const_iterator members{element.find("members")};
+				if(members == element.end() || members.value().empty()) continue;
+
+				building.geometry = get_geometry(members.value().begin().value());
+			}
+
+			else continue;
+			buildings.emplace_back(std::move(building));
+		}
+		catch(...){ continue; }
+	}
+
+	return buildings;
+}
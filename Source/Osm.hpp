@@ -0,0 +1,44 @@
+/*
+	Copyright Myles Trevino
+	Licensed under the Apache License, Version 2.0
+	https://www.apache.org/licenses/LICENSE-2.0
+*/
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Frustum.hpp"
+
+
+namespace LV::Osm
+{
+	struct Building
+	{
+		std::string height; // The "height" tag, empty if missing.
+		std::string levels; // The "building:levels" tag, empty if missing.
+		std::vector<glm::dvec2> geometry; // Longitude and latitude of each point.
+	};
+
+
+	// Returns the first extract within the OSM folder whose bounding box covers the
+	// bounds, or an empty string if there is none. Extracts without a bounding box
+	// are assumed to cover the bounds.
+	std::string find_extract(const LV::Bounds& bounds);
+
+	// Reads the buildings with a point within the bounds from an .osm.pbf extract, whole
+	// as Overpass returns them. The blocks of the memory mapped extract are decompressed
+	// and decoded in parallel, keeping only the nodes within the bounds, which are then
+	// indexed by ID. The blocks containing ways are then decoded again, resolving the
+	// nodes of each building way and dropping those entirely outside. The nodes outside
+	// the bounds of the remaining ways are then decoded from the blocks containing nodes.
+	// Relations use their first member, which must be a way, as their outline.
+	std::vector<Building> read_buildings(const std::string& path, const LV::Bounds& bounds);
+
+	// Reads the buildings from an Overpass API JSON response made with "out geom".
+	// Relations use their first member as their outline. Malformed elements are skipped.
+	std::vector<Building> parse_overpass(const std::string& json);
+}
@@ -7,14 +7,162 @@
 
 #include "Request.hpp"
 
+#include <iostream>
+#include <fstream>
+#include <filesystem>
 #include <stdexcept>
+#include <map>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <cstdio>
+#include <condition_variable>
 #include <curl/curl.h>
 
 #include "Constants.hpp"
+#include "Trace.hpp"
+#include "Memory.hpp"
 
 
 namespace
 {
+	struct Host_limit
+	{
+		unsigned limit{};
+		unsigned active{};
+		std::condition_variable condition;
+	};
+
+	// Keep every caller within the APIs' rate limits by default.
+	std::map<std::string, Host_limit> get_default_host_limits()
+	{
+		std::map<std::string, Host_limit> result;
+		result[LV::Constants::opentopography_host].limit = LV::Constants::opentopography_concurrency;
+		result[LV::Constants::overpass_host].limit = LV::Constants::overpass_concurrency;
+		return result;
+	}
+
+
+	std::mutex host_limits_mutex;
+	std::map<std::string, Host_limit> host_limits{get_default_host_limits()};
+
+	std::mutex redirects_mutex;
+	std::map<std::string, std::string> redirects;
+
+	std::atomic<bool> recording;
+
+	// Idle handles keep their connections open, so that later requests to the same
+	// host skip connecting and the TLS handshake.
+	std::mutex handles_mutex;
+	std::vector<CURL*> idle_handles;
+
+
+	// Borrows an idle handle from the pool for the duration of a request.
+	struct Pooled_handle
+	{
+		CURL* handle{};
+
+		Pooled_handle()
+		{
+			{
+				std::lock_guard<std::mutex> lock{handles_mutex};
+
+				if(!idle_handles.empty())
+				{
+					handle = idle_handles.back();
+					idle_handles.pop_back();
+				}
+			}
+
+			// Resetting keeps the open connections.
+			if(handle) curl_easy_reset(handle);
+			else handle = curl_easy_init();
+			if(!handle) throw std::runtime_error{"Failed to initialize cURL."};
+		}
+
+		~Pooled_handle()
+		{
+			const LV::Memory::Unbudgeted unbudgeted;
+			std::lock_guard<std::mutex> lock{handles_mutex};
+			idle_handles.emplace_back(handle);
+		}
+
+		Pooled_handle(const Pooled_handle&) = delete;
+		Pooled_handle& operator=(const Pooled_handle&) = delete;
+	};
+
+
+	// Holds one of the host's request slots for the duration of a request.
+	struct Host_slot
+	{
+		Host_limit* host_limit{};
+
+		Host_slot(const std::string& host)
+		{
+			std::unique_lock<std::mutex> lock{host_limits_mutex};
+			const auto iterator{host_limits.find(host)};
+			if(iterator == host_limits.end()) return;
+
+			host_limit = &iterator->second;
+			host_limit->condition.wait(lock, [this]{
+				return host_limit->active < host_limit->limit; });
+			++host_limit->active;
+		}
+
+		~Host_slot()
+		{
+			if(!host_limit) return;
+
+			{
+				std::lock_guard<std::mutex> lock{host_limits_mutex};
+				--host_limit->active;
+			}
+
+			host_limit->condition.notify_one();
+		}
+	};
+
+
+	std::string get_host(const std::string& url)
+	{
+		const size_t scheme_end{url.find("://")};
+		const size_t host_start{scheme_end == std::string::npos ? 0 : scheme_end+3};
+		const size_t host_end{url.find_first_of(":/?", host_start)};
+		return url.substr(host_start, host_end == std::string::npos ?
+			std::string::npos : host_end-host_start);
+	}
+
+
+	// Returns the path and query of the URL.
+	std::string get_target(const std::string& url)
+	{
+		const size_t scheme_end{url.find("://")};
+		const size_t target_start{url.find('/', scheme_end == std::string::npos ? 0 : scheme_end+3)};
+		return target_start == std::string::npos ? "/" : url.substr(target_start);
+	}
+
+
+	std::string get_redirected_url(const std::string& url)
+	{
+		std::lock_guard<std::mutex> lock{redirects_mutex};
+		const auto redirect{redirects.find(get_host(url))};
+		return redirect == redirects.end() ? url : redirect->second+get_target(url);
+	}
+
+
+	void record(const std::string& url, const std::string& payload, const std::string& response)
+	{
+		const std::string directory{LV::Constants::recording_directory_name};
+		std::filesystem::create_directories(directory);
+
+		std::ofstream file{directory+"/"+LV::Request::get_recording_name(
+			get_target(url), payload), std::ios::binary};
+
+		file<<response;
+		if(!file) throw std::runtime_error{"Failed to record the response."};
+	}
+
+
 	size_t write_callback(void* buffer, size_t element_size,
 		size_t element_count, std::string* string)
 	{
@@ -32,15 +180,22 @@ namespace
 
 std::string LV::Request::request(const std::string& url, const std::string& payload)
 {
+	const LV::Trace::Span span{"Request"};
+	const LV::Memory::Scope memory{"Request"};
+
+	// Wait for a free slot if the host is limited.
+	const Host_slot host_slot{get_host(url)};
+	const std::string target_url{get_redirected_url(url)};
+
 	// Get a cURL handle.
 	std::string response;
 	char error_buffer[CURL_ERROR_SIZE]{};
 
-	CURL* curl_handle{curl_easy_init()};
-	if(!curl_handle) throw std::runtime_error{"Failed to initialize cURL."};
+	const Pooled_handle pooled_handle;
+	CURL* const curl_handle{pooled_handle.handle};
 
 	// Set the cURL options.
-	curl_easy_setopt(curl_handle, CURLOPT_URL, url.c_str());
+	curl_easy_setopt(curl_handle, CURLOPT_URL, target_url.c_str());
 	curl_easy_setopt(curl_handle, CURLOPT_CAINFO,
 		(LV::Constants::resources_directory+"/Certificates.pem").c_str());
 	curl_easy_setopt(curl_handle, CURLOPT_FOLLOWLOCATION, true);
@@ -60,9 +215,67 @@ std::string LV::Request::request(const std::string& url, const std::string& payl
 	if(curl_result != CURLE_OK) throw std::runtime_error{
 		"The cURL request failed. Code: "+std::to_string(curl_result)+"."};
 
-	// Free the cURL resources.
-	curl_easy_cleanup(curl_handle);
-
 	// Return.
+	if(recording) record(url, payload, response);
 	return response;
 }
+
+
+void LV::Request::set_host_limit(const std::string& host, unsigned limit)
+{
+	if(limit < 1) throw std::runtime_error{"The host limit must be at least 1."};
+
+	std::lock_guard<std::mutex> lock{host_limits_mutex};
+	Host_limit& host_limit{host_limits[host]};
+	host_limit.limit = limit;
+	host_limit.condition.notify_all();
+}
+
+
+void LV::Request::set_redirect(const std::string& host, const std::string& base_url)
+{
+	std::lock_guard<std::mutex> lock{redirects_mutex};
+	if(base_url.empty()) redirects.erase(host);
+	else redirects[host] = base_url;
+}
+
+
+void LV::Request::start_recording()
+{
+	recording = true;
+	std::cout<<"Recording the responses within the '"<<
+		LV::Constants::recording_directory_name<<"' folder.\n";
+}
+
+
+void LV::Request::stop_recording()
+{
+	recording = false;
+	std::cout<<"Recording stopped.\n";
+}
+
+
+std::string LV::Request::get_recording_name(const std::string& target, const std::string& payload)
+{
+	// Remove the API key.
+	std::string key{target};
+	const size_t api_key{key.find("API_Key=")};
+	if(api_key != std::string::npos) key.erase(api_key, key.find('&', api_key)-api_key);
+
+	// Hash with 64-bit FNV-1a.
+	uint64_t hash{0xCBF29CE484222325ull};
+	for(const char character : key+'\n'+payload)
+		hash = (hash^static_cast<unsigned char>(character))*0x100000001B3ull;
+
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx.response", static_cast<unsigned long long>(hash));
+	return name;
+}
+
+
+void LV::Request::cleanup()
+{
+	std::lock_guard<std::mutex> lock{handles_mutex};
+	for(CURL* handle : idle_handles) curl_easy_cleanup(handle);
+	idle_handles.clear();
+}
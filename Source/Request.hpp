@@ -13,4 +13,24 @@
 namespace LV::Request
 {
 	std::string request(const std::string& url, const std::string& payload = {});
+
+	// Limits the number of concurrent requests made to the given host. OpenTopography and
+	// Overpass are limited by default.
+	void set_host_limit(const std::string& host, unsigned limit);
+
+	// Sends the requests made to the host to the base URL instead, for example
+	// "http://127.0.0.1:8080", keeping their paths. An empty base URL removes it.
+	void set_redirect(const std::string& host, const std::string& base_url);
+
+	// Saves each response within the folder while recording, named by
+	// get_recording_name(), so that they can be served again offline.
+	void start_recording();
+	void stop_recording();
+
+	// Identifies a request by its target, the URL's path and query, excluding the API key,
+	// and its payload.
+	std::string get_recording_name(const std::string& target, const std::string& payload);
+
+	// Frees the pooled connections. Called before cURL's global cleanup.
+	void cleanup();
 }
@@ -0,0 +1,182 @@
+/*
+	Copyright Myles Trevino
+	Licensed under the Apache License, Version 2.0
+	https://www.apache.org/licenses/LICENSE-2.0
+*/
+
+
+#include "Sampler.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#include "Frustum.hpp"
+#include "Trace.hpp"
+#include "Memory.hpp"
+
+
+namespace
+{
+	// Reads the next number, skipping the separators before it.
+	bool parse_coordinate(std::string_view* line, float* value)
+	{
+		const size_t start{line->find_first_not_of(" \t,")};
+		if(start == std::string_view::npos) return false;
+
+		const char* const end{line->data()+line->size()};
+		const std::from_chars_result result{std::from_chars(line->data()+start, end, *value)};
+		if(result.ec != std::errc{}) return false;
+
+		line->remove_prefix(result.ptr-line->data());
+		return true;
+	}
+
+
+	LV::Sampler::Points load_points(const std::string& path)
+	{
+		std::ifstream file{path, std::ios::binary};
+		if(!file) throw std::runtime_error{"Failed to open the points file \""+path+"\"."};
+		const std::string data{std::istreambuf_iterator<char>{file}, {}};
+
+		if(std::filesystem::path{path}.extension() != ".bin") return LV::Sampler::parse_points(data);
+
+		// Latitude and longitude pairs of little-endian floats.
+		constexpr size_t point_size{2*sizeof(float)};
+		if(data.size()%point_size != 0) throw std::runtime_error{
+			"The binary points file must contain pairs of 32-bit floats."};
+
+		LV::Sampler::Points points;
+		const size_t count{data.size()/point_size};
+		points.latitudes.resize(count);
+		points.longitudes.resize(count);
+
+		for(size_t index{}; index < count; ++index)
+		{
+			std::memcpy(&points.latitudes[index], data.data()+index*point_size, sizeof(float));
+			std::memcpy(&points.longitudes[index], data.data()+index*point_size+sizeof(float), sizeof(float));
+		}
+
+		return points;
+	}
+
+
+	void write_csv(const std::string& path, const LV::Sampler::Points& points,
+		const std::vector<float>& elevations)
+	{
+		std::ofstream file{path, std::ios::binary};
+		file<<"latitude,longitude,elevation\n";
+
+		// Points outside of the Frustum have no elevation.
+		std::string text;
+		char number[32];
+		const auto append{[&](float value)
+			{ text.append(number, std::to_chars(number, number+sizeof(number), value).ptr); }};
+
+		for(size_t index{}; index < elevations.size(); ++index)
+		{
+			append(points.latitudes[index]);
+			text += ',';
+			append(points.longitudes[index]);
+			text += ',';
+			if(!std::isnan(elevations[index])) append(elevations[index]);
+			text += '\n';
+
+			if(text.size() >= 1024*1024 || index == elevations.size()-1)
+			{
+				file.write(text.data(), text.size());
+				text.clear();
+			}
+		}
+
+		if(!file) throw std::runtime_error{"Failed to write the samples."};
+	}
+
+
+	void write_binary(const std::string& path, const std::vector<float>& elevations)
+	{
+		std::ofstream file{path, std::ios::binary};
+		file.write(reinterpret_cast<const char*>(elevations.data()), elevations.size()*sizeof(float));
+		if(!file) throw std::runtime_error{"Failed to write the samples."};
+	}
+}
+
+
+LV::Sampler::Options LV::Sampler::parse_options(const std::map<std::string, std::string>& options)
+{
+	Options result;
+
+	for(const auto& [key, value] : options)
+	{
+		if(key == "format")
+		{
+			if(value == "binary") result.binary = true;
+			else if(value != "csv") throw std::runtime_error{
+				"'format' must be either 'csv' or 'binary'."};
+		}
+
+		else throw std::runtime_error{"Unrecognized sample option '"+key+"'."};
+	}
+
+	return result;
+}
+
+
+LV::Sampler::Points LV::Sampler::parse_points(std::string_view text)
+{
+	const LV::Trace::Span span{"Point parsing"};
+	const LV::Memory::Scope memory{"Point parsing"};
+
+	Points points;
+	for(size_t line_number{1}; !text.empty(); ++line_number)
+	{
+		const size_t end{std::min(text.find('\n'), text.size())};
+		std::string_view line{text.substr(0, end)};
+		text.remove_prefix(std::min(end+1, text.size()));
+
+		const size_t start{line.find_first_not_of(" \t\r")};
+		if(start == std::string_view::npos || line[start] == '#') continue;
+
+		float latitude, longitude;
+		if(!parse_coordinate(&line, &latitude) || !parse_coordinate(&line, &longitude) ||
+			line.find_first_not_of(" \t\r,") != std::string_view::npos) throw std::runtime_error{
+			"Line "+std::to_string(line_number)+" is not a latitude and longitude."};
+
+		points.latitudes.emplace_back(latitude);
+		points.longitudes.emplace_back(longitude);
+	}
+
+	return points;
+}
+
+
+void LV::Sampler::sample(const std::string& name, const std::string& points_path,
+	const Options& options)
+{
+	std::cout<<"Loading the Frustum and points...\n";
+	const LV::Frustum::Data data{LV::Frustum::load(name)};
+	const Points points{load_points(points_path)};
+
+	std::vector<float> elevations(points.latitudes.size());
+	const std::chrono::steady_clock::time_point start{std::chrono::steady_clock::now()};
+	LV::Frustum::get_elevations(data, points.latitudes, points.longitudes, elevations);
+	const double seconds{std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count()};
+
+	const std::string path{"Exports/"+name+"-samples."+(options.binary ? "bin" : "csv")};
+	std::filesystem::create_directories(std::filesystem::path{path}.parent_path());
+	if(options.binary) write_binary(path, elevations);
+	else write_csv(path, points, elevations);
+
+	const size_t outside{static_cast<size_t>(std::count_if(elevations.begin(), elevations.end(),
+		[](float elevation){ return std::isnan(elevation); }))};
+
+	std::cout<<"Sampled "<<elevations.size()<<" points in "<<seconds<<" seconds ("<<
+		(seconds > 0. ? elevations.size()/seconds/1e6 : 0.)<<" million per second), of which "<<
+		outside<<" were outside of the Frustum. The elevations were saved to \""<<path<<"\".\n";
+}
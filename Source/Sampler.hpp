@@ -0,0 +1,42 @@
+/*
+	Copyright Myles Trevino
+	Licensed under the Apache License, Version 2.0
+	https://www.apache.org/licenses/LICENSE-2.0
+*/
+
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+
+
+namespace LV::Sampler
+{
+	struct Options
+	{
+		bool binary{}; // Writes 32-bit floats instead of CSV.
+	};
+
+	struct Points
+	{
+		std::vector<float> latitudes;
+		std::vector<float> longitudes;
+	};
+
+
+	// Parses 'key=value' sample options.
+	Options parse_options(const std::map<std::string, std::string>& options);
+
+	// Parses a latitude and longitude per line, separated by a comma or whitespace.
+	// Empty lines and lines starting with '#' are ignored.
+	Points parse_points(std::string_view text);
+
+	// Samples the saved Frustum's elevation at each point of the file, which is either
+	// text as read by parse_points or, if its extension is '.bin', little-endian 32-bit
+	// float latitude and longitude pairs. The elevations in meters are written within
+	// the Exports folder in the order of the points, and are NaN outside of the Frustum.
+	void sample(const std::string& name, const std::string& points_path, const Options& options = {});
+}
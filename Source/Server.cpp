@@ -0,0 +1,303 @@
+/*
+	Copyright Myles Trevino
+	Licensed under the Apache License, Version 2.0
+	https://www.apache.org/licenses/LICENSE-2.0
+*/
+
+
+#include "Server.hpp"
+
+#include <iostream>
+#include <map>
+#include <list>
+#include <mutex>
+#include <future>
+#include <memory>
+#include <thread>
+#include <nlohmann/json.hpp>
+
+#include "Constants.hpp"
+#include "Utilities.hpp"
+#include "Frustum.hpp"
+#include "Exporter.hpp"
+#include "Sampler.hpp"
+#include "Http.hpp"
+#include "Trace.hpp"
+
+
+namespace
+{
+	struct Loaded_frustum
+	{
+		LV::Frustum::Data data;
+		LV::Frustum::Meshes meshes;
+		size_t bytes;
+	};
+
+	using Frustum_future = std::shared_future<std::shared_ptr<const Loaded_frustum>>;
+
+	// An invalid request, as opposed to a failure while handling a valid one.
+	class Request_error : public std::runtime_error
+	{
+	public:
+		using std::runtime_error::runtime_error;
+	};
+
+	struct Cache_entry
+	{
+		Frustum_future frustum;
+		uint64_t id; // Distinguishes the entry from those replacing it once evicted.
+		size_t bytes;
+		std::list<std::string>::iterator recency;
+	};
+
+
+	std::mutex cache_mutex;
+	std::map<std::string, Cache_entry> cache;
+	std::list<std::string> recency; // Most recently used first.
+	size_t cache_bytes;
+	size_t cache_budget;
+	uint64_t next_entry_id;
+
+
+	size_t get_mesh_bytes(const LV::Mesh& mesh)
+	{ return mesh.vertices.size()*sizeof(glm::fvec3)+mesh.indices.size()*sizeof(unsigned); }
+
+
+	size_t get_bytes(const Loaded_frustum& frustum)
+	{
+		size_t bytes{static_cast<size_t>(frustum.data.size.x)*frustum.data.size.y*sizeof(float)};
+
+		for(const LV::Building& building : frustum.data.buildings)
+			bytes += sizeof(LV::Building)+building.outline.size()*sizeof(glm::fvec2);
+
+		return bytes+get_mesh_bytes(frustum.meshes.terrain)+
+			get_mesh_bytes(frustum.meshes.buildings)+get_mesh_bytes(frustum.meshes.base);
+	}
+
+
+	// Evicts the least recently used Frustums until the cache fits its budget.
+	// Frustums still in use by a request stay alive until that request finishes.
+	void evict()
+	{
+		while(cache_bytes > cache_budget && recency.size() > 1)
+		{
+			const std::map<std::string, Cache_entry>::iterator entry{cache.find(recency.back())};
+
+			std::cout<<"Evicting \""<<entry->first<<"\" from the cache.\n";
+			cache_bytes -= entry->second.bytes;
+			cache.erase(entry);
+			recency.pop_back();
+		}
+	}
+
+
+	// Runs the function, reporting its failures as an invalid request.
+	template<typename Function> auto validate_request(const Function& function)
+	{
+		try{ return function(); }
+		catch(std::exception& error){ throw Request_error{error.what()}; }
+	}
+
+
+	std::shared_ptr<const Loaded_frustum> get_frustum(const std::string& name)
+	{
+		validate_request([&]{ LV::Utilities::validate_name(name); });
+		std::promise<std::shared_ptr<const Loaded_frustum>> promise;
+		Frustum_future frustum;
+		uint64_t id{};
+		bool cached{};
+
+		// Look up the Frustum, or reserve its entry so concurrent requests wait for one load.
+		{
+			std::lock_guard<std::mutex> lock{cache_mutex};
+			const std::map<std::string, Cache_entry>::iterator entry{cache.find(name)};
+			cached = (entry != cache.end());
+
+			if(cached)
+			{
+				recency.splice(recency.begin(), recency, entry->second.recency);
+				frustum = entry->second.frustum;
+			}
+			else
+			{
+				recency.emplace_front(name);
+				frustum = promise.get_future().share();
+				id = next_entry_id++;
+				cache[name] = Cache_entry{frustum, id, 0, recency.begin()};
+			}
+		}
+
+		if(cached) return frustum.get();
+
+		// Load the Frustum and generate its meshes.
+		std::shared_ptr<Loaded_frustum> loaded;
+
+		try
+		{
+			loaded = std::make_shared<Loaded_frustum>();
+			LV::Frustum::load(name, &loaded->data, &loaded->meshes);
+			loaded->bytes = get_bytes(*loaded);
+			promise.set_value(loaded);
+		}
+		catch(...)
+		{
+			promise.set_exception(std::current_exception());
+
+			// Do not cache failures, leaving any entry since reserved by another request.
+			std::lock_guard<std::mutex> lock{cache_mutex};
+			const std::map<std::string, Cache_entry>::iterator entry{cache.find(name)};
+
+			if(entry != cache.end() && entry->second.id == id)
+			{
+				recency.erase(entry->second.recency);
+				cache.erase(entry);
+			}
+
+			throw;
+		}
+
+		// Account for the Frustum's memory, unless its entry was evicted while loading.
+		std::lock_guard<std::mutex> lock{cache_mutex};
+		const std::map<std::string, Cache_entry>::iterator entry{cache.find(name)};
+
+		if(entry != cache.end() && entry->second.id == id)
+		{
+			entry->second.bytes = loaded->bytes;
+			cache_bytes += loaded->bytes;
+			evict();
+		}
+
+		return loaded;
+	}
+
+
+	const std::string& get_parameter(const LV::Http::Request& request, const std::string& key)
+	{
+		const std::map<std::string, std::string>::const_iterator
+			parameter{request.parameters.find(key)};
+
+		if(parameter == request.parameters.end())
+			throw Request_error{"Missing the '"+key+"' parameter."};
+
+		return parameter->second;
+	}
+
+
+	nlohmann::json get_metadata(const Loaded_frustum& frustum)
+	{
+		nlohmann::json json;
+		json["name"] = frustum.data.name;
+		json["dataset"] = frustum.data.dataset;
+		json["top"] = frustum.data.bounds.top;
+		json["left"] = frustum.data.bounds.left;
+		json["bottom"] = frustum.data.bounds.bottom;
+		json["right"] = frustum.data.bounds.right;
+		json["width"] = frustum.data.size.x;
+		json["height"] = frustum.data.size.y;
+		json["buildings"] = frustum.data.buildings.size();
+		return json;
+	}
+
+
+	LV::Http::Response handle(const LV::Http::Request& request, LV::Http::Server* server)
+	{
+		const LV::Trace::Span span{"Server request"};
+
+		try
+		{
+			nlohmann::json json;
+
+			if(request.path == "/metadata")
+				json = get_metadata(*get_frustum(get_parameter(request, "name")));
+
+			else if(request.path == "/sample")
+			{
+				const std::shared_ptr<const Loaded_frustum> frustum{
+					get_frustum(get_parameter(request, "name"))};
+
+				// Many points may be posted, one per line. Those outside become null.
+				if(!request.body.empty())
+				{
+					const LV::Sampler::Points points{validate_request(
+						[&]{ return LV::Sampler::parse_points(request.body); })};
+					std::vector<float> elevations(points.latitudes.size());
+					LV::Frustum::get_elevations(frustum->data, points.latitudes,
+						points.longitudes, elevations);
+
+					json["elevations"] = elevations;
+				}
+
+				else
+				{
+					const float latitude{validate_request(
+						[&]{ return std::stof(get_parameter(request, "latitude")); })};
+
+					const float longitude{validate_request(
+						[&]{ return std::stof(get_parameter(request, "longitude")); })};
+
+					json["elevation"] =
+						LV::Frustum::get_elevation(frustum->data, latitude, longitude);
+				}
+			}
+
+			else if(request.path == "/export")
+			{
+				const std::string& format{get_parameter(request, "format")};
+				const std::string& orientation{get_parameter(request, "orientation")};
+				std::map<std::string, std::string> options{request.parameters};
+				for(const char* key : {"name", "format", "orientation"}) options.erase(key);
+
+				const LV::Exporter::Options export_options{validate_request([&]
+				{
+					const LV::Exporter::Options result{LV::Exporter::parse_options(options)};
+					LV::Exporter::validate(format, orientation, result);
+					return result;
+				})};
+
+				const std::shared_ptr<const Loaded_frustum> frustum{
+					get_frustum(get_parameter(request, "name"))};
+
+				json["path"] = LV::Exporter::export_frustum(frustum->data,
+					frustum->meshes, format, orientation, export_options);
+			}
+
+			else if(request.path == "/shutdown")
+			{
+				server->stop();
+				json["status"] = "Shutting down.";
+			}
+
+			else return {404, "{\"error\":\"Unrecognized request.\"}"};
+
+			return {200, json.dump()};
+		}
+		catch(std::exception& error)
+		{
+			nlohmann::json json;
+			json["error"] = error.what();
+			return {dynamic_cast<const Request_error*>(&error) ? 400 : 500, json.dump()};
+		}
+	}
+}
+
+
+void LV::Server::serve(unsigned short port, size_t cache_budget)
+{
+	::cache_budget = cache_budget;
+
+	const unsigned worker_count{std::max(std::thread::hardware_concurrency(), 1u)};
+	LV::Http::Server server{port, worker_count,
+		[&](const LV::Http::Request& request){ return handle(request, &server); }};
+
+	std::cout<<"Serving on http://127.0.0.1:"<<port<<" with "<<worker_count<<
+		" workers. Request '/shutdown' to stop.\n";
+
+	server.serve();
+
+	// Release the cached Frustums.
+	cache.clear();
+	recency.clear();
+	cache_bytes = 0;
+	std::cout<<"Server stopped.\n";
+}
@@ -0,0 +1,18 @@
+/*
+	Copyright Myles Trevino
+	Licensed under the Apache License, Version 2.0
+	https://www.apache.org/licenses/LICENSE-2.0
+*/
+
+
+#pragma once
+
+#include <string>
+
+
+namespace LV::Server
+{
+	// Serves requests on the loopback interface, keeping recently used Frustums
+	// in memory up to the given budget. Blocks until a shutdown request is received.
+	void serve(unsigned short port, size_t cache_budget);
+}
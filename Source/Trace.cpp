@@ -0,0 +1,209 @@
+/*
+	Copyright Myles Trevino
+	Licensed under the Apache License, Version 2.0
+	https://www.apache.org/licenses/LICENSE-2.0
+*/
+
+
+#include "Trace.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <memory>
+#include <vector>
+#include <string_view>
+#include <iomanip>
+#include <algorithm>
+#include <stdexcept>
+
+#include "Constants.hpp"
+#include "Memory.hpp"
+
+
+namespace
+{
+	struct Event
+	{
+		const char* name;
+		int64_t start;
+		int64_t duration;
+	};
+
+
+	// Written only by the thread holding it, and read once tracing has stopped and the
+	// write in progress, if any, has finished.
+	struct Thread_buffer
+	{
+		size_t id;
+		std::vector<Event> events = std::vector<Event>(LV::Constants::trace_buffer_events);
+		std::atomic<uint64_t> count{};
+		std::atomic<bool> writing{};
+	};
+
+
+	std::mutex buffers_mutex;
+	std::vector<std::unique_ptr<Thread_buffer>> buffers;
+	std::vector<Thread_buffer*> free_buffers;
+	int64_t trace_start{};
+
+
+	// Returns the thread's buffer for reuse once the thread exits, since short-lived
+	// threads are created often. The buffer keeps its spans.
+	struct Buffer_lease
+	{
+		Thread_buffer* buffer{};
+
+		~Buffer_lease()
+		{
+			if(!buffer) return;
+			const LV::Memory::Unbudgeted unbudgeted;
+			const std::lock_guard lock{buffers_mutex};
+			free_buffers.emplace_back(buffer);
+		}
+	};
+
+	thread_local Buffer_lease lease;
+
+
+	Thread_buffer* get_buffer()
+	{
+		if(lease.buffer) return lease.buffer;
+		const std::lock_guard lock{buffers_mutex};
+
+		if(!free_buffers.empty())
+		{
+			lease.buffer = free_buffers.back();
+			free_buffers.pop_back();
+		}
+
+		else
+		{
+			lease.buffer = buffers.emplace_back(std::make_unique<Thread_buffer>()).get();
+			lease.buffer->id = buffers.size();
+		}
+
+		return lease.buffer;
+	}
+
+
+	void write_string(std::ofstream* file, std::string_view string)
+	{
+		*file<<'"';
+
+		for(const char character : string)
+		{
+			if(character == '"' || character == '\\') *file<<'\\';
+			*file<<character;
+		}
+
+		*file<<'"';
+	}
+}
+
+
+int64_t LV::Trace::get_time()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+void LV::Trace::record(const char* name, int64_t start)
+{
+	if(!enabled.load(std::memory_order_relaxed)) return;
+
+	const int64_t end{get_time()};
+	Thread_buffer* const buffer{get_buffer()};
+
+	// Mark the write before checking again, so that stop() either waits for it or it
+	// sees that tracing has stopped.
+	buffer->writing = true;
+
+	if(enabled)
+	{
+		const uint64_t index{buffer->count.load(std::memory_order_relaxed)};
+		buffer->events[index%buffer->events.size()] = {name, start, end-start};
+		buffer->count.store(index+1, std::memory_order_relaxed);
+	}
+
+	buffer->writing.store(false, std::memory_order_release);
+}
+
+
+void LV::Trace::reserve_buffer(){ get_buffer(); }
+
+
+void LV::Trace::start()
+{
+	// Clearing the buffers is only safe once stop() has waited for the writers.
+	if(enabled) throw std::runtime_error{"Tracing has already been started."};
+
+	{
+		const std::lock_guard lock{buffers_mutex};
+		for(const std::unique_ptr<Thread_buffer>& buffer : buffers) buffer->count = 0;
+		trace_start = get_time();
+	}
+
+	enabled = true;
+	std::cout<<"Tracing started.\n";
+}
+
+
+std::string LV::Trace::stop()
+{
+	if(!enabled.exchange(false)) throw std::runtime_error{"Tracing has not been started."};
+
+	const std::string directory{LV::Constants::trace_directory_name};
+	std::filesystem::create_directories(directory);
+
+	const std::string path{directory+"/trace-"+std::to_string(
+		std::chrono::system_clock::now().time_since_epoch()/std::chrono::seconds{1})+".json"};
+
+	std::ofstream file{path};
+	if(!file) throw std::runtime_error{"Failed to write the trace."};
+
+	// Wait for the writes in progress.
+	const std::lock_guard lock{buffers_mutex};
+	for(const std::unique_ptr<Thread_buffer>& buffer : buffers)
+		while(buffer->writing) std::this_thread::yield();
+
+	// Write the spans as complete events, with microsecond timestamps.
+	file<<std::fixed<<std::setprecision(3)<<"{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	bool first{true};
+	uint64_t span_count{}, dropped_count{};
+
+	for(const std::unique_ptr<Thread_buffer>& buffer : buffers)
+	{
+		const uint64_t count{buffer->count.load(std::memory_order_relaxed)};
+		const uint64_t capacity{buffer->events.size()};
+		const uint64_t kept{std::min(count, capacity)};
+
+		span_count += kept;
+		dropped_count += count-kept;
+
+		for(uint64_t index{count-kept}; index < count; ++index)
+		{
+			const Event& event{buffer->events[index%capacity]};
+
+			file<<(first ? "\n" : ",\n")<<"{\"name\":";
+			write_string(&file, event.name);
+			file<<",\"ph\":\"X\",\"pid\":1,\"tid\":"<<buffer->id<<",\"ts\":"<<
+				(event.start-trace_start)/1e3<<",\"dur\":"<<event.duration/1e3<<'}';
+
+			first = false;
+		}
+	}
+
+	file<<"\n]}\n";
+	if(!file) throw std::runtime_error{"Failed to write the trace."};
+
+	std::cout<<"Tracing stopped. Wrote "<<span_count<<" spans to \""<<path<<"\"";
+	if(dropped_count > 0) std::cout<<", dropping the "<<dropped_count<<" oldest";
+	std::cout<<".\n";
+
+	return path;
+}
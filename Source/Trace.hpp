@@ -0,0 +1,58 @@
+/*
+	Copyright Myles Trevino
+	Licensed under the Apache License, Version 2.0
+	https://www.apache.org/licenses/LICENSE-2.0
+*/
+
+
+#pragma once
+
+#include <string>
+#include <atomic>
+#include <cstdint>
+
+
+namespace LV::Trace
+{
+	inline std::atomic<bool> enabled{false};
+
+	int64_t get_time(); // Nanoseconds.
+
+	// Appends the span to the calling thread's ring buffer.
+	void record(const char* name, int64_t start);
+
+	// Allocates the calling thread's ring buffer if it has none, so that recording does
+	// not allocate.
+	void reserve_buffer();
+
+
+	// Records the time from its construction to its destruction as a span on the calling
+	// thread while tracing is enabled, and otherwise only checks whether it is. Spans
+	// nest by time, so spans within a scope appear below it. The name must outlive the
+	// trace, for example a string literal.
+	class Span
+	{
+	public:
+		explicit Span(const char* name) : name{name},
+			start{enabled.load(std::memory_order_relaxed) ? get_time() : -1}
+		{ if(start >= 0) reserve_buffer(); }
+
+		~Span(){ if(start >= 0) record(name, start); }
+
+		Span(const Span&) = delete;
+		Span& operator=(const Span&) = delete;
+
+	private:
+		const char* name;
+		int64_t start;
+	};
+
+
+	// Clears the recorded spans and starts recording. Throws if already recording.
+	void start();
+
+	// Stops recording and writes the spans as Chrome trace JSON, which Perfetto and
+	// chrome://tracing open, returning the file's path. Each thread keeps only its most
+	// recent spans.
+	std::string stop();
+}
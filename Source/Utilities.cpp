@@ -7,19 +7,37 @@
 
 #include "Utilities.hpp"
 
+#include <iostream>
 #include <sstream>
+#include <fstream>
+#include <map>
+#include <filesystem>
+#include <regex>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <exception>
 #ifdef _WIN32
 #define NOMINMAX
 #include <Windows.h>
-#elif __APPLE__
+#else
+#include <fcntl.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #endif
 #include <glbinding/gl33core/gl.h>
 #include <globjects/VertexAttributeBinding.h>
 #include <zstd/zstd.h>
+#include <zstd/zdict.h>
 #include <algorithm>
 
 #include "Constants.hpp"
+#include "Trace.hpp"
+#include "Memory.hpp"
 
 
 namespace
@@ -44,6 +62,281 @@ namespace
 	}
 
 
+	struct Compression_settings
+	{
+		int level;
+		bool long_distance_matching;
+	};
+
+
+	Compression_settings get_compression_settings(LV::Utilities::Compression_profile profile)
+	{
+		switch(profile)
+		{
+			case LV::Utilities::Compression_profile::fast:
+				return {LV::Constants::fast_compression_level, false};
+
+			case LV::Utilities::Compression_profile::balanced:
+				return {LV::Constants::balanced_compression_level, true};
+
+			default: return {ZSTD_maxCLevel(), true};
+		}
+	}
+
+
+	void check_compression(size_t result)
+	{ if(ZSTD_isError(result)) throw std::runtime_error{"Failed to compress."}; }
+
+
+	void check_decompression(size_t result)
+	{ if(ZSTD_isError(result)) throw std::runtime_error{"Failed to decompress."}; }
+
+
+	// Prepared dictionaries, loaded from the resources when first used.
+	std::mutex dictionaries_mutex;
+	std::map<std::pair<std::string, int>, std::shared_ptr<ZSTD_CDict>> compression_dictionaries;
+	std::map<unsigned, std::shared_ptr<ZSTD_DDict>> decompression_dictionaries;
+
+
+	std::string get_dictionary_path(const std::string& file_name)
+	{
+		return LV::Constants::resources_directory+"/"+
+			LV::Constants::dictionary_directory_name+"/"+file_name+".dict";
+	}
+
+
+	std::string read_dictionary(const std::string& path)
+	{
+		std::ifstream file{path, std::ios::binary};
+		if(!file) return {};
+
+		return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+	}
+
+
+	// Returns the named dictionary prepared for the level, or null if it has not been trained.
+	std::shared_ptr<ZSTD_CDict> get_compression_dictionary(const std::string& name, int level)
+	{
+		std::lock_guard<std::mutex> lock{dictionaries_mutex};
+		const auto iterator{compression_dictionaries.find({name, level})};
+		if(iterator != compression_dictionaries.end()) return iterator->second;
+
+		std::shared_ptr<ZSTD_CDict> dictionary;
+		const std::string buffer{read_dictionary(get_dictionary_path(name))};
+
+		if(!buffer.empty())
+		{
+			dictionary.reset(ZSTD_createCDict(buffer.data(), buffer.size(), level), ZSTD_freeCDict);
+			if(!dictionary) throw std::runtime_error{"Failed to prepare the \""+name+"\" dictionary."};
+		}
+
+		compression_dictionaries[{name, level}] = dictionary;
+		return dictionary;
+	}
+
+
+	std::shared_ptr<ZSTD_DDict> get_decompression_dictionary(unsigned id)
+	{
+		std::lock_guard<std::mutex> lock{dictionaries_mutex};
+		const auto iterator{decompression_dictionaries.find(id)};
+		if(iterator != decompression_dictionaries.end()) return iterator->second;
+
+		const std::string buffer{read_dictionary(get_dictionary_path(std::to_string(id)))};
+		if(buffer.empty()) throw std::runtime_error{"The compression dictionary "+
+			std::to_string(id)+" is missing from the resources."};
+
+		const std::shared_ptr<ZSTD_DDict> dictionary{
+			ZSTD_createDDict(buffer.data(), buffer.size()), ZSTD_freeDDict};
+
+		if(!dictionary) throw std::runtime_error{"Failed to prepare the dictionary "+
+			std::to_string(id)+"."};
+
+		decompression_dictionaries[id] = dictionary;
+		return dictionary;
+	}
+
+
+	// Prepares the context for the dictionary the frame was compressed with, if any.
+	std::shared_ptr<ZSTD_DDict> use_frame_dictionary(ZSTD_DCtx* context,
+		const void* frame, size_t size)
+	{
+		const unsigned id{ZSTD_getDictID_fromFrame(frame, size)};
+		if(id == 0) return {};
+
+		std::shared_ptr<ZSTD_DDict> dictionary{get_decompression_dictionary(id)};
+		check_decompression(ZSTD_DCtx_refDDict(context, dictionary.get()));
+		return dictionary;
+	}
+
+
+	// Decompresses the input into the destination after the given number of bytes,
+	// growing the destination only when it is full. Returns zero once a frame ends.
+	size_t decompress_chunk(ZSTD_DCtx* context, ZSTD_inBuffer* input,
+		std::string* destination, size_t* used)
+	{
+		size_t result{};
+		bool output_full{};
+
+		// Flush until the input is consumed and zstd holds no more output.
+		while(input->pos < input->size || output_full)
+		{
+			if(*used == destination->size()) destination->resize(std::max(
+				destination->size()+destination->size()/2, ZSTD_DStreamOutSize()));
+
+			ZSTD_outBuffer output{destination->data()+*used, destination->size()-*used, 0};
+			result = ZSTD_decompressStream(context, &output, input);
+			check_decompression(result);
+
+			*used += output.pos;
+			output_full = (result != 0 && output.pos == output.size);
+		}
+
+		return result;
+	}
+
+
+	// Sizes the destination from the frame header when it records the content size.
+	void reserve_decompressed(const void* source, size_t size, std::string* destination)
+	{
+		const unsigned long long content_size{ZSTD_getFrameContentSize(source, size)};
+
+		if(content_size != ZSTD_CONTENTSIZE_UNKNOWN && content_size != ZSTD_CONTENTSIZE_ERROR)
+			destination->resize(content_size);
+	}
+
+
+	// The indices of a parallel_for call still to run, shared by the pool's threads.
+	struct Loop
+	{
+		const std::function<void(size_t index)>* function;
+		size_t count;
+		LV::Memory::Stage* stage;
+		LV::Utilities::Output* output;
+
+		std::atomic<size_t> next_index{};
+		std::atomic<size_t> running{}; // Threads which may be running an index.
+		std::mutex mutex;
+		std::condition_variable finished;
+		std::exception_ptr exception;
+	};
+
+
+	// Runs the loop's next index, returning false once every index has been claimed.
+	bool run_next(Loop* loop)
+	{
+		++loop->running;
+		const size_t index{loop->next_index++};
+
+		if(index < loop->count)
+		{
+			try{ (*loop->function)(index); }
+			catch(...)
+			{
+				std::lock_guard<std::mutex> lock{loop->mutex};
+				if(!loop->exception) loop->exception = std::current_exception();
+				loop->next_index = loop->count;
+			}
+		}
+
+		if(--loop->running == 0)
+		{
+			std::lock_guard<std::mutex> lock{loop->mutex};
+			loop->finished.notify_all();
+		}
+
+		return index < loop->count;
+	}
+
+
+	// Threads shared by every parallel_for call, so that concurrent calls, as from batch
+	// jobs or server requests, do not each start a thread per core.
+	class Thread_pool
+	{
+	public:
+		~Thread_pool()
+		{
+			{
+				std::lock_guard<std::mutex> lock{mutex};
+				stopping = true;
+			}
+
+			condition.notify_all();
+			for(std::thread& thread : threads) thread.join();
+		}
+
+		// Starts the threads on first use. Returns false if there are none to help.
+		bool start()
+		{
+			std::call_once(started, [this]
+			{
+				// Keep the threads started so far if starting another fails.
+				const unsigned count{std::max(std::thread::hardware_concurrency(), 1u)-1};
+				try{ for(unsigned thread{}; thread < count; ++thread) threads.emplace_back([this]{ work(); }); }
+				catch(...){}
+			});
+
+			return !threads.empty();
+		}
+
+		void add(const std::shared_ptr<Loop>& loop)
+		{
+			{
+				std::lock_guard<std::mutex> lock{mutex};
+				loops.emplace_back(loop);
+			}
+
+			condition.notify_all();
+		}
+
+		void remove(const std::shared_ptr<Loop>& loop)
+		{
+			std::lock_guard<std::mutex> lock{mutex};
+			const auto iterator{std::find(loops.begin(), loops.end(), loop)};
+			if(iterator != loops.end()) loops.erase(iterator);
+		}
+
+	private:
+		std::once_flag started;
+		std::vector<std::thread> threads;
+		std::mutex mutex;
+		std::condition_variable condition;
+		std::deque<std::shared_ptr<Loop>> loops; // With indices still to claim.
+		bool stopping{};
+
+		void work();
+	};
+
+	Thread_pool thread_pool;
+	thread_local bool nested{}; // Within a parallel_for call, or one of the pool's threads.
+	thread_local LV::Utilities::Output* current_output{};
+
+
+	void Thread_pool::work()
+	{
+		nested = true;
+
+		while(true)
+		{
+			std::shared_ptr<Loop> loop;
+
+			{
+				std::unique_lock<std::mutex> lock{mutex};
+				condition.wait(lock, [this]{ return stopping || !loops.empty(); });
+				if(loops.empty()) return;
+				loop = loops.front();
+			}
+
+			{
+				const LV::Memory::Scope memory{loop->stage};
+				const LV::Utilities::Output_scope output{loop->output};
+				while(run_next(loop.get()));
+			}
+
+			remove(loop);
+		}
+	}
+
+
 	#ifdef _WIN32
 	void set_icon(HINSTANCE module_handle, HWND console_handle, WPARAM type, int size)
 	{
@@ -57,6 +350,50 @@ namespace
 }
 
 
+LV::Mapped_file::Mapped_file(const std::string& path)
+{
+	#ifdef _WIN32
+	const HANDLE file{CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+		nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr)};
+
+	if(file == INVALID_HANDLE_VALUE) throw std::runtime_error{"Failed to open \""+path+"\"."};
+
+	LARGE_INTEGER file_size;
+	GetFileSizeEx(file, &file_size);
+	size = static_cast<size_t>(file_size.QuadPart);
+	mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+
+	if(mapping) data = static_cast<const uint8_t*>(
+		MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+
+	#else
+	const int file{open(path.c_str(), O_RDONLY)};
+	if(file < 0) throw std::runtime_error{"Failed to open \""+path+"\"."};
+
+	struct stat status;
+	if(fstat(file, &status) == 0) size = static_cast<size_t>(status.st_size);
+
+	void* mapping{(size > 0) ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0) : MAP_FAILED};
+	close(file);
+	if(mapping != MAP_FAILED) data = static_cast<const uint8_t*>(mapping);
+	#endif
+
+	if(!data) throw std::runtime_error{"Failed to map \""+path+"\"."};
+}
+
+
+LV::Mapped_file::~Mapped_file()
+{
+	#ifdef _WIN32
+	if(data) UnmapViewOfFile(data);
+	if(mapping) CloseHandle(mapping);
+	#else
+	if(data) munmap(const_cast<uint8_t*>(data), size);
+	#endif
+}
+
+
 void LV::Utilities::platform_initialization(const std::string& path)
 {
 	#ifdef _WIN32
@@ -134,51 +471,241 @@ void LV::Utilities::destroy_vao(VAO* vao)
 }
 
 
-std::vector<uint8_t> LV::Utilities::compress(const std::string& source)
+LV::Utilities::Compression_profile LV::Utilities::parse_compression_profile(
+	const std::string& name)
+{
+	if(name == "fast") return Compression_profile::fast;
+	if(name == "balanced") return Compression_profile::balanced;
+	if(name == "archive") return Compression_profile::archive;
+
+	throw std::runtime_error{"'profile' must be 'fast', 'balanced', or 'archive'."};
+}
+
+
+std::vector<uint8_t> LV::Utilities::compress(const std::string& source,
+	Compression_profile profile, const std::string& dictionary)
 {
-	// Allocate the destination buffer.
-	const size_t buffer_size{ZSTD_compressBound(source.size())};
-	uint8_t* buffer{new uint8_t[buffer_size]};
+	const LV::Trace::Span span{"Compression"};
+
+	const std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)>
+		context{ZSTD_createCCtx(), ZSTD_freeCCtx};
+
+	if(!context) throw std::runtime_error{"Failed to compress."};
+
+	// Configure the profile.
+	const Compression_settings settings{get_compression_settings(profile)};
+	check_compression(ZSTD_CCtx_setParameter(context.get(),
+		ZSTD_c_compressionLevel, settings.level));
+
+	if(settings.long_distance_matching)
+	{
+		check_compression(ZSTD_CCtx_setParameter(context.get(),
+			ZSTD_c_enableLongDistanceMatching, 1));
+
+		check_compression(ZSTD_CCtx_setParameter(context.get(),
+			ZSTD_c_windowLog, LV::Constants::long_distance_window_log));
+	}
+
+	// Use the prepared dictionary if it has been trained.
+	std::shared_ptr<ZSTD_CDict> prepared_dictionary;
+
+	if(!dictionary.empty())
+	{
+		prepared_dictionary = get_compression_dictionary(dictionary, settings.level);
+
+		if(prepared_dictionary) check_compression(
+			ZSTD_CCtx_refCDict(context.get(), prepared_dictionary.get()));
+	}
+
+	// Fails if zstd was built without multithreading, which leaves it single-threaded.
+	// Small sources are not worth starting the worker threads for.
+	if(source.size() >= LV::Constants::multithreaded_compression_size)
+		ZSTD_CCtx_setParameter(context.get(), ZSTD_c_nbWorkers,
+			static_cast<int>(std::thread::hardware_concurrency()));
+
+	// Store the content size in the frame so that it can be decompressed in one pass.
+	check_compression(ZSTD_CCtx_setPledgedSrcSize(context.get(), source.size()));
 
 	// Compress.
-	const size_t compressed_size{ZSTD_compress(buffer, buffer_size,
-		source.c_str(), source.size(), ZSTD_maxCLevel())};
+	std::vector<uint8_t> result;
+	std::vector<uint8_t> chunk(ZSTD_CStreamOutSize());
+	ZSTD_inBuffer input{source.data(), source.size(), 0};
+	size_t remaining;
+
+	do
+	{
+		ZSTD_outBuffer output{chunk.data(), chunk.size(), 0};
+		remaining = ZSTD_compressStream2(context.get(), &output, &input, ZSTD_e_end);
+		check_compression(remaining);
+
+		result.insert(result.end(), chunk.begin(), chunk.begin()+output.pos);
+	}
+	while(remaining);
+
+	return result;
+}
+
+
+std::string LV::Utilities::decompress(std::span<const uint8_t> source)
+{
+	const LV::Trace::Span span{"Decompression"};
+
+	const std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)>
+		context{ZSTD_createDCtx(), ZSTD_freeDCtx};
+
+	if(!context) throw std::runtime_error{"Failed to decompress."};
 
-	if(ZSTD_isError(compressed_size)) throw std::runtime_error{"Failed to compress."};
+	std::string result;
+	size_t used{};
+	reserve_decompressed(source.data(), source.size(), &result);
 
-	// Return the result.
-	const std::vector<uint8_t> result{buffer, buffer+compressed_size};
-	delete[] buffer;
+	const std::shared_ptr<ZSTD_DDict> dictionary{
+		use_frame_dictionary(context.get(), source.data(), source.size())};
 
+	ZSTD_inBuffer input{source.data(), source.size(), 0};
+	if(decompress_chunk(context.get(), &input, &result, &used) != 0)
+		throw std::runtime_error{"Failed to decompress. The data is truncated."};
+
+	result.resize(used);
 	return result;
 }
 
 
-std::string LV::Utilities::decompress(const std::vector<uint8_t>& source)
+std::string LV::Utilities::decompress_file(const std::string& path)
 {
-	// Allocate the destination buffer.
-	const unsigned long long buffer_size{
-		ZSTD_getFrameContentSize(source.data(), source.size())};
+	const LV::Trace::Span span{"File decompression"};
 
-	if(ZSTD_isError(buffer_size)) throw std::runtime_error{"Failed to decompress."};
+	std::ifstream file{path, std::ios::binary};
+	if(!file) throw std::runtime_error{"Failed to open \""+path+"\"."};
 
-	uint8_t* buffer{new uint8_t[buffer_size]};
+	const std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)>
+		context{ZSTD_createDCtx(), ZSTD_freeDCtx};
 
-	// Decompress.
-	const size_t decompressed_size{ZSTD_decompress(buffer,
-		buffer_size, source.data(), source.size())};
+	if(!context) throw std::runtime_error{"Failed to decompress."};
 
-	if(ZSTD_isError(decompressed_size))
-		throw std::runtime_error{"Failed to decompress."};
+	std::string result;
+	size_t used{};
+	size_t last_result{};
+	std::vector<char> chunk(ZSTD_DStreamInSize());
+	std::shared_ptr<ZSTD_DDict> dictionary;
+	bool first_chunk{true};
 
-	// Return the result.
-	const std::string result{buffer, buffer+decompressed_size};
-	delete[] buffer;
+	// Decompress the file one chunk at a time.
+	while(file.read(chunk.data(), chunk.size()) || file.gcount() > 0)
+	{
+		const size_t chunk_size{static_cast<size_t>(file.gcount())};
+
+		// Read the frame header from the first chunk.
+		if(first_chunk)
+		{
+			reserve_decompressed(chunk.data(), chunk_size, &result);
+			dictionary = use_frame_dictionary(context.get(), chunk.data(), chunk_size);
+			first_chunk = false;
+		}
+
+		ZSTD_inBuffer input{chunk.data(), chunk_size, 0};
+		last_result = decompress_chunk(context.get(), &input, &result, &used);
+	}
 
+	if(last_result != 0) throw std::runtime_error{
+		"Failed to decompress \""+path+"\". The file is truncated."};
+
+	result.resize(used);
 	return result;
 }
 
 
+void LV::Utilities::train_dictionary(const std::string& name,
+	const std::vector<std::string>& samples)
+{
+	// Concatenate the samples.
+	std::string buffer;
+	std::vector<size_t> sample_sizes;
+
+	for(const std::string& sample : samples)
+	{
+		buffer += sample;
+		sample_sizes.emplace_back(sample.size());
+	}
+
+	// Train.
+	std::string dictionary(LV::Constants::dictionary_size, '\0');
+	const size_t dictionary_size{ZDICT_trainFromBuffer(dictionary.data(), dictionary.size(),
+		buffer.data(), sample_sizes.data(), static_cast<unsigned>(sample_sizes.size()))};
+
+	if(ZDICT_isError(dictionary_size)) throw std::runtime_error{"Failed to train the \""+
+		name+"\" dictionary: "+ZDICT_getErrorName(dictionary_size)};
+
+	dictionary.resize(dictionary_size);
+	const unsigned id{ZSTD_getDictID_fromDict(dictionary.data(), dictionary.size())};
+
+	// Save it as the current dictionary for compression and by ID for decompression.
+	std::filesystem::create_directories(LV::Constants::resources_directory+"/"+
+		LV::Constants::dictionary_directory_name);
+
+	for(const std::string& file_name : {name, std::to_string(id)})
+	{
+		std::ofstream file{get_dictionary_path(file_name), std::ios::binary};
+		if(!file) throw std::runtime_error{"Failed to save the \""+name+"\" dictionary."};
+		file.write(dictionary.data(), dictionary.size());
+	}
+
+	// Prepare the new dictionary the next time it is used.
+	std::lock_guard<std::mutex> lock{dictionaries_mutex};
+	std::erase_if(compression_dictionaries, [&](const auto& entry){ return entry.first.first == name; });
+}
+
+
+void LV::Utilities::parallel_for(size_t count,
+	const std::function<void(size_t index)>& function)
+{
+	// Nested calls run on the calling thread, since every thread is already busy.
+	if(nested || count < 2 || !thread_pool.start())
+	{
+		for(size_t index{}; index < count; ++index) function(index);
+		return;
+	}
+
+	const std::shared_ptr<Loop> loop{std::make_shared<Loop>()};
+	loop->function = &function;
+	loop->count = count;
+	loop->stage = LV::Memory::get_stage();
+	loop->output = current_output;
+	thread_pool.add(loop);
+
+	// Run on the calling thread as well, then wait for the indices the pool claimed.
+	nested = true;
+	while(run_next(loop.get()));
+	nested = false;
+
+	thread_pool.remove(loop);
+	std::unique_lock<std::mutex> lock{loop->mutex};
+	loop->finished.wait(lock, [&]{ return loop->running == 0; });
+	if(loop->exception) std::rethrow_exception(loop->exception);
+}
+
+
+LV::Utilities::Output_scope::Output_scope(Output* output) : previous{current_output}
+{ current_output = output; }
+
+LV::Utilities::Output_scope::~Output_scope(){ current_output = previous; }
+LV::Utilities::Output* LV::Utilities::get_output(){ return current_output; }
+
+
+void LV::Utilities::print(const std::string& text)
+{
+	Output* const output{current_output};
+	if(!output)
+	{
+		std::cout<<text;
+		return;
+	}
+
+	const std::lock_guard<std::mutex> lock{output->mutex};
+	output->text += text;
+}
+
+
 void LV::Utilities::ignore_until(std::istream* stream, char delimiter)
 { stream->ignore(std::numeric_limits<std::streamsize>::max(), delimiter); }
 
@@ -207,3 +734,11 @@ std::string LV::Utilities::to_uppercase(std::string string)
 	std::transform(string.begin(), string.end(), string.begin(), toupper);
 	return string;
 }
+
+
+void LV::Utilities::validate_name(const std::string& name)
+{
+	if(!std::regex_match(name, std::regex{"^[a-zA-Z0-9-]+$"}))
+		throw std::runtime_error{"Invalid Frustum name. The name must "
+			"consist only of alphanumeric characters and dashes."};
+}
@@ -9,6 +9,9 @@
 
 #include <string>
 #include <vector>
+#include <span>
+#include <functional>
+#include <mutex>
 #include <globjects/globjects.h>
 #include <globjects/base/File.h>
 #include <glm/glm.hpp>
@@ -31,6 +34,22 @@ namespace LV
 		std::unique_ptr<globjects::Buffer> vbo;
 		std::unique_ptr<globjects::Buffer> ibo;
 	};
+
+	// A read-only memory mapping of a file.
+	struct Mapped_file
+	{
+		const uint8_t* data{};
+		size_t size{};
+
+		#ifdef _WIN32
+		void* mapping{};
+		#endif
+
+		explicit Mapped_file(const std::string& path);
+		~Mapped_file();
+		Mapped_file(const Mapped_file&) = delete;
+		Mapped_file& operator=(const Mapped_file&) = delete;
+	};
 }
 
 
@@ -51,9 +70,59 @@ namespace LV::Utilities
 
 
 	// Compression.
-	std::vector<uint8_t> compress(const std::string& source);
+	enum class Compression_profile{fast, balanced, archive};
+
+	Compression_profile parse_compression_profile(const std::string& name);
+
+	// Uses the named trained dictionary if it exists. Its ID is stored in the frame.
+	std::vector<uint8_t> compress(const std::string& source,
+		Compression_profile profile = Compression_profile::balanced,
+		const std::string& dictionary = {});
+
+	std::string decompress(std::span<const uint8_t> source);
+
+	// Decompresses the file in chunks directly into the result, so that only
+	// the decompressed data is held in memory.
+	std::string decompress_file(const std::string& path);
+
+	// Trains the named dictionary from the samples and saves it within the
+	// resources. Earlier dictionaries are kept so that older files still load.
+	void train_dictionary(const std::string& name, const std::vector<std::string>& samples);
 
-	std::string decompress(const std::vector<uint8_t>& source);
+	// Threading.
+	// Calls the function for each index on the calling thread and a pool of threads
+	// shared by all calls, one per hardware thread. The first exception thrown is
+	// rethrown once every index has finished. Nested calls, including those from
+	// within the pool, run on the calling thread.
+	void parallel_for(size_t count, const std::function<void(size_t index)>& function);
+
+	// Output.
+	// Progress text held back to be printed at once, such as a batch job's.
+	struct Output
+	{
+		std::mutex mutex;
+		std::string text;
+	};
+
+	// Sends the calling thread's progress text to the output until destroyed. Threads
+	// started for the same work pass it along, as parallel_for does.
+	class Output_scope
+	{
+	public:
+		explicit Output_scope(Output* output);
+		~Output_scope();
+		Output_scope(const Output_scope&) = delete;
+		Output_scope& operator=(const Output_scope&) = delete;
+
+	private:
+		Output* previous;
+	};
+
+	Output* get_output(); // The calling thread's, or null for the standard output.
+
+	// Writes the text whole to the calling thread's output or the standard output, so
+	// that lines from concurrent threads do not interleave.
+	void print(const std::string& text);
 
 	// Streams.
 	void ignore_until(std::istream* stream, char delimiter);
@@ -65,4 +134,6 @@ namespace LV::Utilities
 	std::vector<std::string> split(const std::string& string);
 
 	std::string to_uppercase(std::string string);
+
+	void validate_name(const std::string& name);
 }
@@ -17,6 +17,8 @@
 #include "Constants.hpp"
 #include "Utilities.hpp"
 #include "Frustum.hpp"
+#include "Trace.hpp"
+#include "Memory.hpp"
 
 
 namespace
@@ -202,12 +204,16 @@ namespace
 
 void LV::Viewer::view(const std::string& name)
 {
+	const LV::Memory::Scope memory{"Viewer"};
+
 	// Load the Frustum.
-	LV::Frustum::load(name);
-	frustum_size = LV::Frustum::get_size();
-	terrain_mesh = LV::Frustum::get_terrain_mesh();
-	buildings_mesh = LV::Frustum::get_buildings_mesh();
-	base_mesh = LV::Frustum::get_base_mesh();
+	LV::Frustum::Data data;
+	LV::Frustum::Meshes meshes;
+	LV::Frustum::load(name, &data, &meshes);
+	frustum_size = data.size;
+	terrain_mesh = std::move(meshes.terrain);
+	buildings_mesh = std::move(meshes.buildings);
+	base_mesh = std::move(meshes.base);
 
 	// Disable wireframe by default if necessary.
 	if((terrain_mesh.indices.size()+buildings_mesh.indices.size())/3
@@ -248,6 +254,8 @@ void LV::Viewer::view(const std::string& name)
 	std::cout<<"Rendering...\n";
 	while(Window::is_open())
 	{
+		const LV::Trace::Span span{"Frame"};
+
 		// Update.
 		Window::update();
 		if(Window::is_minimized()) continue;
@@ -0,0 +1,408 @@
+/*
+	Copyright Myles Trevino
+	Licensed under the Apache License, Version 2.0
+	https://www.apache.org/licenses/LICENSE-2.0
+*/
+
+
+#include "Visibility.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+
+#include "Utilities.hpp"
+#include "Trace.hpp"
+#include "Memory.hpp"
+
+
+namespace
+{
+	// Nudges positions on a block's edge into the block the ray is heading into.
+	constexpr double edge_nudge{1e-7}; // Cells.
+
+
+	bool contains(const std::vector<glm::fvec2>& outline, const glm::fvec2& point)
+	{
+		bool inside{};
+		for(size_t index{}, previous{outline.size()-1}; index < outline.size(); previous = index++)
+		{
+			const glm::fvec2& a{outline[index]};
+			const glm::fvec2& b{outline[previous]};
+
+			if((a.y > point.y) != (b.y > point.y) &&
+				point.x < (b.x-a.x)*(point.y-a.y)/(b.y-a.y)+a.x) inside = !inside;
+		}
+
+		return inside;
+	}
+
+
+	// Raises the points within each building's outline to its roof, or the point nearest
+	// its center if it is smaller than a cell.
+	void rasterize_buildings(const LV::Frustum::Data& data, std::vector<std::vector<float>>* heights)
+	{
+		for(const LV::Building& building : data.buildings)
+		{
+			// Match the buildings mesh, which stands each on the terrain at its first point.
+			const glm::ivec2 location{building.outline[0]};
+			if(location.x >= data.size.x || location.y >= data.size.y ||
+				location.x < 0 || location.y < 0) continue;
+
+			const float roof{data.terrain[location.y][location.x]+building.height};
+
+			glm::fvec2 minimum{building.outline[0]}, maximum{building.outline[0]}, center{};
+			for(const glm::fvec2& point : building.outline)
+			{
+				minimum = glm::min(minimum, point);
+				maximum = glm::max(maximum, point);
+				center += point/static_cast<float>(building.outline.size());
+			}
+
+			const glm::ivec2 start{glm::max(glm::ivec2{glm::ceil(minimum)}, glm::ivec2{0})};
+			const glm::ivec2 end{glm::min(glm::ivec2{glm::floor(maximum)}, data.size-1)};
+			bool covered{};
+
+			for(int z{start.y}; z <= end.y; ++z) for(int x{start.x}; x <= end.x; ++x)
+				if(contains(building.outline, glm::fvec2{x, z}))
+				{
+					(*heights)[z][x] = std::max((*heights)[z][x], roof);
+					covered = true;
+				}
+
+			if(covered) continue;
+
+			const glm::ivec2 nearest{glm::clamp(glm::ivec2{glm::round(center)},
+				glm::ivec2{0}, data.size-1)};
+
+			(*heights)[nearest.y][nearest.x] = std::max((*heights)[nearest.y][nearest.x], roof);
+		}
+	}
+
+
+	// Returns whether the segment passes below the cell's two triangles between the
+	// fractions, and the fraction of the first intersection.
+	bool intersect_cell(const LV::Visibility::Max_mip& max_mip, const glm::ivec2& cell,
+		const glm::dvec3& start, const glm::dvec3& direction, double entry, double exit,
+		double* fraction)
+	{
+		// The height above the surface is linear within each triangle, so it need only be
+		// checked where the segment enters and leaves, and crosses the diagonal.
+		double samples[3]{entry, exit, exit};
+		const double across{direction.x-direction.z};
+
+		if(across != 0.)
+		{
+			const double diagonal{((cell.x-start.x)-(cell.y-start.z))/across};
+			if(diagonal > entry && diagonal < exit)
+			{
+				samples[1] = diagonal;
+				samples[2] = exit;
+			}
+		}
+
+		double previous_fraction{}, previous_clearance{};
+		for(int index{}; index < 3; ++index)
+		{
+			const glm::dvec3 point{start+direction*samples[index]};
+			const double clearance{point.y-LV::Visibility::get_height(max_mip, {point.x, point.z})};
+
+			// Touching the surface does not count, so that observers and targets without a
+			// height above it still see each other over flat ground.
+			if(clearance < 0.)
+			{
+				if(fraction) *fraction = (index == 0) ? samples[0] : previous_fraction+
+					(samples[index]-previous_fraction)*previous_clearance/(previous_clearance-clearance);
+
+				return true;
+			}
+
+			previous_fraction = samples[index];
+			previous_clearance = clearance;
+		}
+
+		return false;
+	}
+
+
+	void write_pgm(const std::string& path, const std::vector<std::vector<uint16_t>>& counts,
+		size_t observer_count)
+	{
+		std::ofstream file{path, std::ios::binary};
+		file<<"P5\n# "<<LV::Constants::program_name<<" viewshed of "<<observer_count<<
+			" observers\n"<<counts[0].size()<<' '<<counts.size()<<"\n255\n";
+
+		std::vector<uint8_t> row(counts[0].size());
+		for(const std::vector<uint16_t>& count_row : counts)
+		{
+			for(size_t x{}; x < row.size(); ++x) row[x] =
+				static_cast<uint8_t>((count_row[x]*255+observer_count/2)/observer_count);
+
+			file.write(reinterpret_cast<const char*>(row.data()), row.size());
+		}
+
+		if(!file) throw std::runtime_error{"Failed to write the viewshed."};
+	}
+}
+
+
+LV::Visibility::Options LV::Visibility::parse_options(
+	const std::map<std::string, std::string>& options)
+{
+	Options result;
+
+	for(const auto& [key, value] : options)
+	{
+		if(key == "height" || key == "target" || key == "radius")
+		{
+			const float meters{std::stof(value)};
+			if(!(meters >= 0.f)) throw std::runtime_error{"'"+key+"' must not be negative."};
+
+			if(key == "height") result.observer_height = meters;
+			else if(key == "target") result.target_height = meters;
+			else result.radius = meters;
+		}
+
+		else if(key == "buildings")
+		{
+			if(value == "false") result.buildings = false;
+			else if(value != "true") throw std::runtime_error{
+				"'buildings' must be either 'true' or 'false'."};
+		}
+
+		else throw std::runtime_error{"Unrecognized viewshed option '"+key+"'."};
+	}
+
+	return result;
+}
+
+
+LV::Visibility::Max_mip LV::Visibility::build(const LV::Frustum::Data& data, bool buildings)
+{
+	const LV::Trace::Span span{"Max-mip construction"};
+	const LV::Memory::Scope memory{"Max-mip construction"};
+
+	if(data.size.x < 2 || data.size.y < 2) throw std::runtime_error{
+		"The terrain is too small to cast rays over."};
+
+	Max_mip max_mip;
+	max_mip.heights = data.terrain;
+	if(buildings) rasterize_buildings(data, &max_mip.heights);
+
+	// Each cell's maximum is that of its corners.
+	max_mip.sizes.emplace_back(data.size-1);
+	max_mip.levels.emplace_back(static_cast<size_t>(data.size.x-1)*(data.size.y-1));
+
+	LV::Utilities::parallel_for(data.size.y-1, [&](size_t z)
+	{
+		const std::vector<float>& top{max_mip.heights[z]};
+		const std::vector<float>& bottom{max_mip.heights[z+1]};
+		float* const level{max_mip.levels[0].data()+z*(data.size.x-1)};
+
+		for(int x{}; x < data.size.x-1; ++x)
+			level[x] = std::max({top[x], top[x+1], bottom[x], bottom[x+1]});
+	});
+
+	// Each following level's is that of the up to four blocks below it.
+	while(max_mip.sizes.back() != glm::ivec2{1, 1})
+	{
+		const glm::ivec2 below_size{max_mip.sizes.back()};
+		const glm::ivec2 size{(below_size+1)/2};
+		std::vector<float> level(static_cast<size_t>(size.x)*size.y);
+		const std::vector<float>& below{max_mip.levels.back()};
+
+		LV::Utilities::parallel_for(size.y, [&](size_t z)
+		{
+			const int first_row{2*static_cast<int>(z)};
+			const int end_row{std::min(first_row+2, below_size.y)};
+
+			for(int x{}; x < size.x; ++x)
+			{
+				float maximum{std::numeric_limits<float>::lowest()};
+
+				for(int below_z{first_row}; below_z < end_row; ++below_z)
+					for(int below_x{2*x}; below_x < std::min(2*x+2, below_size.x); ++below_x)
+						maximum = std::max(maximum, below[static_cast<size_t>(below_z)*below_size.x+below_x]);
+
+				level[z*size.x+x] = maximum;
+			}
+		});
+
+		max_mip.sizes.emplace_back(size);
+		max_mip.levels.emplace_back(std::move(level));
+	}
+
+	return max_mip;
+}
+
+
+double LV::Visibility::get_height(const Max_mip& max_mip, const glm::dvec2& position)
+{
+	const glm::ivec2 cell{glm::clamp(glm::ivec2{glm::floor(position)},
+		glm::ivec2{0}, max_mip.sizes[0]-1)};
+
+	const glm::dvec2 weight{glm::clamp(position-glm::dvec2{cell}, 0., 1.)};
+	const double top_left{max_mip.heights[cell.y][cell.x]};
+	const double top_right{max_mip.heights[cell.y][cell.x+1]};
+	const double bottom_left{max_mip.heights[cell.y+1][cell.x]};
+	const double bottom_right{max_mip.heights[cell.y+1][cell.x+1]};
+
+	// The cells are split from the top left to the bottom right corner.
+	if(weight.x >= weight.y) return top_left+weight.x*(top_right-top_left)+
+		weight.y*(bottom_right-top_right);
+
+	return top_left+weight.y*(bottom_left-top_left)+weight.x*(bottom_right-bottom_left);
+}
+
+
+bool LV::Visibility::intersect(const Max_mip& max_mip, const glm::dvec3& start,
+	const glm::dvec3& end, double* fraction)
+{
+	const glm::dvec3 direction{end-start};
+	const glm::dvec2 horizontal_start{start.x, start.z};
+	const glm::dvec2 horizontal_direction{direction.x, direction.z};
+	const glm::dvec2 extent{max_mip.sizes[0]};
+
+	// Clip the segment to the grid.
+	double entry{}, exit{1.};
+	for(int axis{}; axis < 2; ++axis)
+	{
+		if(horizontal_direction[axis] == 0.)
+		{
+			if(horizontal_start[axis] < 0. || horizontal_start[axis] > extent[axis]) return false;
+			continue;
+		}
+
+		double near{-horizontal_start[axis]/horizontal_direction[axis]};
+		double far{(extent[axis]-horizontal_start[axis])/horizontal_direction[axis]};
+		if(near > far) std::swap(near, far);
+		entry = std::max(entry, near);
+		exit = std::min(exit, far);
+	}
+
+	if(entry > exit) return false;
+
+	// Descend into the blocks which the segment may pass below, and skip the others.
+	const int top_level{static_cast<int>(max_mip.levels.size())-1};
+	const glm::dvec2 nudge{(horizontal_direction.x > 0.)-(horizontal_direction.x < 0.),
+		(horizontal_direction.y > 0.)-(horizontal_direction.y < 0.)};
+	int level{top_level};
+	double position{entry};
+
+	while(position <= exit)
+	{
+		const double block_size{static_cast<double>(1 << level)};
+		const glm::ivec2 size{max_mip.sizes[level]};
+		const glm::ivec2 block{glm::clamp(glm::ivec2{glm::floor((horizontal_start+
+			horizontal_direction*position+nudge*edge_nudge)/block_size)}, glm::ivec2{0}, size-1)};
+
+		// Find where the segment leaves the block.
+		double block_exit{exit};
+		for(int axis{}; axis < 2; ++axis)
+		{
+			if(horizontal_direction[axis] == 0.) continue;
+			const double edge{(block[axis]+(horizontal_direction[axis] > 0. ? 1 : 0))*block_size};
+			block_exit = std::min(block_exit, (edge-horizontal_start[axis])/horizontal_direction[axis]);
+		}
+
+		block_exit = std::max(block_exit, position);
+
+		// The segment's height is linear, so its lowest within the block is at an end.
+		const double lowest{start.y+direction.y*(direction.y < 0. ? block_exit : position)};
+
+		if(lowest > max_mip.levels[level][static_cast<size_t>(block.y)*size.x+block.x] ||
+			(level == 0 && !intersect_cell(max_mip, block, start, direction,
+			position, block_exit, fraction)))
+		{
+			if(block_exit >= exit) break;
+			position = (block_exit > position) ? block_exit : std::nextafter(position, 2.);
+			level = std::min(level+1, top_level);
+		}
+
+		else if(level == 0) return true;
+		else --level;
+	}
+
+	return false;
+}
+
+
+std::vector<std::vector<uint16_t>> LV::Visibility::compute_viewshed(const Max_mip& max_mip,
+	const std::vector<glm::dvec2>& observers, double observer_height, double target_height,
+	double radius)
+{
+	const LV::Trace::Span span{"Viewshed"};
+	const LV::Memory::Scope memory{"Viewshed"};
+
+	std::vector<glm::dvec3> eyes;
+	for(const glm::dvec2& observer : observers) eyes.emplace_back(observer.x,
+		get_height(max_mip, observer)+observer_height, observer.y);
+
+	const glm::ivec2 size{max_mip.sizes[0]+1};
+	std::vector<std::vector<uint16_t>> counts(size.y, std::vector<uint16_t>(size.x));
+
+	LV::Utilities::parallel_for(size.y, [&](size_t z)
+	{
+		for(int x{}; x < size.x; ++x) for(const glm::dvec3& eye : eyes)
+		{
+			const glm::dvec3 target{x, max_mip.heights[z][x]+target_height, z};
+			const double distance{glm::distance(glm::dvec2{eye.x, eye.z}, glm::dvec2{target.x, target.z})};
+			if(radius > 0. && distance > radius) continue;
+
+			// Stop half a cell short, so that the target's own surface does not hide it.
+			if(distance <= .5 || !intersect(max_mip, eye, eye+(target-eye)*(1.-.5/distance)))
+				++counts[z][x];
+		}
+	});
+
+	return counts;
+}
+
+
+void LV::Visibility::viewshed(const std::string& name,
+	const std::vector<glm::fvec2>& coordinates, const Options& options)
+{
+	if(coordinates.empty()) throw std::runtime_error{"No observers were given."};
+	if(coordinates.size() > std::numeric_limits<uint16_t>::max())
+		throw std::runtime_error{"Too many observers were given."};
+
+	std::cout<<"Loading the Frustum...\n";
+	const LV::Frustum::Data data{LV::Frustum::load(name)};
+
+	std::vector<glm::dvec2> observers;
+	for(const glm::fvec2& coordinate : coordinates)
+		observers.emplace_back(LV::Frustum::get_position(data, coordinate.x, coordinate.y));
+
+	const std::chrono::steady_clock::time_point start{std::chrono::steady_clock::now()};
+	const Max_mip max_mip{build(data, options.buildings)};
+	const std::chrono::steady_clock::time_point built{std::chrono::steady_clock::now()};
+
+	// Convert the distances from meters to Frustum units.
+	const double units_per_meter{data.cell_size/LV::Constants::meters_per_frustum_base_unit};
+	const std::vector<std::vector<uint16_t>> counts{compute_viewshed(max_mip, observers,
+		options.observer_height*units_per_meter, options.target_height*units_per_meter,
+		options.radius*units_per_meter)};
+
+	const std::chrono::steady_clock::time_point computed{std::chrono::steady_clock::now()};
+
+	const std::string path{"Exports/"+name+"-viewshed.pgm"};
+	std::filesystem::create_directories(std::filesystem::path{path}.parent_path());
+	write_pgm(path, counts, observers.size());
+
+	uint64_t visible{};
+	for(const std::vector<uint16_t>& row : counts)
+		visible += std::count_if(row.begin(), row.end(), [](uint16_t count){ return count > 0; });
+
+	const auto seconds{[](std::chrono::steady_clock::duration duration)
+		{ return std::chrono::duration<double>(duration).count(); }};
+
+	std::cout<<"Built the max-mip in "<<seconds(built-start)<<" seconds and cast "<<
+		counts.size()*counts[0].size()*observers.size()<<" rays in "<<seconds(computed-built)<<
+		" seconds.\n"<<100.*visible/(counts.size()*counts[0].size())<<
+		"% of the points are visible. The viewshed was saved to \""<<path<<"\".\n";
+}
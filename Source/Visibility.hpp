@@ -0,0 +1,64 @@
+/*
+	Copyright Myles Trevino
+	Licensed under the Apache License, Version 2.0
+	https://www.apache.org/licenses/LICENSE-2.0
+*/
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <glm/glm.hpp>
+
+#include "Frustum.hpp"
+#include "Constants.hpp"
+
+
+namespace LV::Visibility
+{
+	// The maximum height of each terrain cell, and of successively larger square blocks
+	// of cells, so that rays skip the blocks they pass above.
+	struct Max_mip
+	{
+		std::vector<std::vector<float>> heights; // Of the points, by row as the terrain.
+		std::vector<glm::ivec2> sizes; // Cells across and down of each level.
+		std::vector<std::vector<float>> levels; // By row, from the single cells up.
+	};
+
+	struct Options
+	{
+		float observer_height{LV::Constants::default_observer_height}; // Meters above the surface.
+		float target_height{}; // Meters above the surface.
+		float radius{}; // Meters, or zero for no limit.
+		bool buildings{true}; // Raises the points under each building to its roof.
+	};
+
+
+	// Parses 'key=value' viewshed options.
+	Options parse_options(const std::map<std::string, std::string>& options);
+
+	Max_mip build(const LV::Frustum::Data& data, bool buildings);
+
+	// Returns the height of the surface between the points as the terrain mesh triangulates it.
+	double get_height(const Max_mip& max_mip, const glm::dvec2& position);
+
+	// Returns whether the segment passes below the surface, and the fraction along it
+	// of the first intersection. Touching the surface does not count. Points are the
+	// column, height, and row in the Frustum's units, as within the uncentered meshes.
+	bool intersect(const Max_mip& max_mip, const glm::dvec3& start,
+		const glm::dvec3& end, double* fraction = nullptr);
+
+	// Returns the number of the observers seeing each point, by row. Positions are the
+	// column and row, and the heights and radius are in the Frustum's units.
+	std::vector<std::vector<uint16_t>> compute_viewshed(const Max_mip& max_mip,
+		const std::vector<glm::dvec2>& observers, double observer_height,
+		double target_height, double radius);
+
+	// Computes the viewshed of the observers at the latitudes and longitudes over the
+	// saved Frustum, and writes it within the Exports folder as a PGM image, brighter
+	// where more of the observers see the point.
+	void viewshed(const std::string& name, const std::vector<glm::fvec2>& coordinates,
+		const Options& options = {});
+}